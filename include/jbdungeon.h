@@ -31,6 +31,7 @@
 
 #include "jbmaze.h"
 #include "jbmazemask.h"
+#include "jbmazepath.h"
 
 #define REROLL_ONCE           ( 0x10000000 )
 #define REROLL_ANY            ( 0x20000000 )  
@@ -69,12 +70,23 @@ class JBDungeonDatum {
  * Contains the various parameters, settings, and attributes of the
  * dungeon to be created.  This object is used solely as a parameter to
  * the JBDungeon constructor.
+ *
+ * The options hold a reference to their mask (see JBMazeMask::retain()),
+ * which they release when they are destroyed: setMask() (or setting mask
+ * directly) hands them the caller's reference, and copying the options
+ * shares the mask rather than copying it.  The dungeon made from them
+ * shares it, too.
  * --------------------------------------------------------------------- */
 class JBDungeonOptions {
   public:
     JBDungeonOptions();
+    JBDungeonOptions( const JBDungeonOptions& options );
     ~JBDungeonOptions();
 
+    JBDungeonOptions& operator=( const JBDungeonOptions& options );
+
+    void setMask( JBMazeMask* newMask );
+
     JBMazePt size;           /* dimensions of the dungeon, in the absense of a mask */
     JBMazePt start;          /* the starting point of the dungeon (for mazes) */
     JBMazePt end;            /* the ending point of the dungeon (for mazes) */
@@ -97,6 +109,12 @@ class JBDungeonOptions {
 
     int secretDoors;         /* percentage of doors to make "secret" doors */
     int concealedDoors;      /* percentage of doors to make "concealed" doors */
+
+    int compatibility;       /* JBMaze::c_COMPAT_XXXX flags for the maze */
+    int algorithm;           /* JBMaze::c_XXXX algorithm used to generate the maze */
+
+    const char* storage;     /* a file to map the dungeon from (see JBMazeStorage), or NULL;
+                                a file that cannot be mapped is ignored */
 };
 
 
@@ -165,6 +183,13 @@ class JBDungeon {
     static const int c_PASSAGE;  /* point is in a passage */
     static const int c_ROOM;     /* point is in a room */
 
+    /* the sub-streams (see JBRandom::split()) of each phase of generation */
+
+    static const int c_STREAM_MAZE;         /* the maze itself */
+    static const int c_STREAM_ROOMS;        /* placing the rooms */
+    static const int c_STREAM_WALLS;        /* placing the doors */
+    static const int c_STREAM_DESCRIPTION;  /* JBDungeonDescription */
+
   public:
 
     /* ----------------------------------------------------------------- *
@@ -216,14 +241,30 @@ class JBDungeon {
      *
      * Retrieves the number of steps in the solution of the maze.
      * ----------------------------------------------------------------- */
-    int getSolutionLength() { return m_solutionLength; }
+    int getSolutionLength() { return (int)m_solution.getLength(); }
 
     /* ----------------------------------------------------------------- *
-     * const JBMazePt& getSolutionStep( int i )
+     * JBMazePt getSolutionStep( int i )
      *
-     * Retrieves the solution point at the given index.
+     * Retrieves the solution point at the given index.  The solution is
+     * kept packed (see JBMazePath), so the point is unpacked (and scaled
+     * to the dungeon) when it is asked for, and asking for the points in
+     * order costs the least.
      * ----------------------------------------------------------------- */
-    const JBMazePt& getSolutionStep( int i ) { return m_solution[ i ]; }
+    JBMazePt getSolutionStep( int i ) {
+      JBMazePt pt = m_solution.getStep( i );
+      pt.x = pt.x * 2 + 1;
+      pt.y = pt.y * 2 + 1;
+      return pt;
+    }
+
+    /* ----------------------------------------------------------------- *
+     * const JBMazeMetrics& getMetrics()
+     *
+     * Retrieves the shape of the maze the dungeon was made from (see
+     * JBMaze::measure()), measured in cells of the maze.
+     * ----------------------------------------------------------------- */
+    const JBMazeMetrics& getMetrics() { return m_metrics; }
 
     /* ----------------------------------------------------------------- *
      * int getWallBetween( const JBMazePt& p1, const JBMazePt& p2 )
@@ -261,6 +302,15 @@ class JBDungeon {
      * ----------------------------------------------------------------- */
     char* getDataPath() { return m_dataPath; }
 
+    /* ----------------------------------------------------------------- *
+     * JBRandom& getRandom()
+     *
+     * Retrieves the root random stream of the dungeon, seeded from the
+     * options' seed.  Each phase splits a sub-stream of its own from it
+     * (see the c_STREAM_XXXX constants, above).
+     * ----------------------------------------------------------------- */
+    JBRandom& getRandom() { return m_random; }
+
   private:
 
     /* ----------------------------------------------------------------- *
@@ -310,12 +360,23 @@ class JBDungeon {
      * ----------------------------------------------------------------- */
     void m_addWall( const JBMazePt& p1, const JBMazePt& p2, int type );
 
+    /* ----------------------------------------------------------------- *
+     * long m_cell( int x, int y, int z )
+     *
+     * Converts a point in the dungeon to an offset into m_dungeon.  As in
+     * JBMaze, x varies fastest, then y, then z.
+     * ----------------------------------------------------------------- */
+    long m_cell( int x, int y, int z ) {
+      return ( (long)z * m_y + y ) * m_x + x;
+    }
+
   private:
 
-    int***    m_dungeon;         /* the three dimensional array of dungeon points */
+    int*      m_dungeon;         /* the dungeon points (see m_cell()) */
+    JBMazeStorage* m_storage;    /* the block holding m_dungeon */
 
-    JBMazePt* m_solution;        /* the list of points in the solution of the maze */
-    int       m_solutionLength;  /* the number of steps in the solution */
+    JBMazePath m_solution;       /* the solution of the maze, in maze cells */
+    JBMazeMetrics m_metrics;     /* the shape of the maze */
 
     int       m_x;               /* the x-dimension of the dungeon */
     int       m_y;               /* the y-dimension of the dungeon */
@@ -324,9 +385,23 @@ class JBDungeon {
     JBDungeonRoom* m_rooms;      /* the list of rooms in the dungeon */
     JBDungeonWall* m_walls;      /* the list of walls in the dungeon */
 
-    JBMazeMask*    m_mask;       /* the mask to use for creating the dungeon */
+    JBMazeMask*    m_mask;       /* the mask to use for creating the dungeon (shared) */
+    int            m_compatibility; /* JBMaze::c_COMPAT_XXXX flags */
 
     char*    m_dataPath;         /* the path that the generator looks in to find data */
+
+    JBRandom m_random;           /* the root random stream */
+    JBRandom m_phase;            /* the sub-stream of the current phase */
 };
 
+
+/* --------------------------------------------------------------------- *
+ * int rollDice( JBRandom& random, int count, int sides )
+ *
+ * Rolls count dice with the given number of sides, using the given
+ * stream.  A legacy stream (see JBRandom::c_LEGACY) calls the dnd-util
+ * rollDice(), so that older seeds still describe the same dungeon.
+ * --------------------------------------------------------------------- */
+int rollDice( JBRandom& random, int count, int sides );
+
 #endif /* __JBDUNGEON_H__ */
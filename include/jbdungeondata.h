@@ -160,6 +160,9 @@ class JBDungeonDescription {
      * ------------------------------------------------------------------ */
     void m_describeRoom( JBDungeon* dungeon, JBDungeonRoom* room, int level );
 
+  private:
+
+    JBRandom m_random;    /* the dungeon's c_STREAM_DESCRIPTION sub-stream */
 };
 
 #endif /* __JBDUNGEONDATA_H__ */
@@ -29,6 +29,15 @@
 #define __JBMAZE_H__
 
 #include "jbmazemask.h"
+#include "jbmazestorage.h"
+#include "jbrandom.h"
+
+class JBMazeGenerator;
+class JBMazePath;
+class JBMazePlanes;
+class JBMazeSnapshot;
+template< int D > class JBMazeCore;
+struct JBMazeWalk;
 
 /* ---------------------------------------------------------------------- *
  * JBMazePt
@@ -51,6 +60,44 @@ class JBMazePt {
 };
 
 
+/* ---------------------------------------------------------------------- *
+ * JBMazeDeadendStats
+ *
+ * Statistics about the passages that the last call to
+ * JBMaze::clearDeadends() carved.
+ * ---------------------------------------------------------------------- */
+struct JBMazeDeadendStats {
+  long deadends;      /* deadends that clearDeadends() found */
+  long cleared;       /* deadends that were connected to another passage */
+  long failed;        /* deadends chosen that could not be connected */
+  long carved;        /* cells carved, over all the connecting passages */
+  long longest;       /* cells carved by the longest connecting passage */
+  long probes;        /* directions tried (random walk) or cells searched */
+};
+
+
+/* ---------------------------------------------------------------------- *
+ * JBMazeMetrics
+ *
+ * The shape of a maze, as JBMaze::measure() finds it.  Corridors,
+ * deadends, and junctions are counted by the number of exits a cell has
+ * (two, one, and three or more); a straight corridor cell is one whose two
+ * exits are opposite.
+ * ---------------------------------------------------------------------- */
+struct JBMazeMetrics {
+  long cells;         /* cells in the mask, over every level */
+  long passages;      /* cells with any exit */
+  long deadends;      /* cells with one exit */
+  long corridors;     /* cells with two exits */
+  long straight;      /* corridor cells that go straight through */
+  long junctions;     /* cells with three or more exits */
+  long longest;       /* cells in the longest straight run of passage */
+  long solutionLength;  /* cells on the solution, or 0 if not solved */
+  double coverage;    /* passages / cells */
+  double river;       /* straight / corridors: how long the corridors run */
+};
+
+
 class JBMaze {
   public:
 
@@ -61,6 +108,73 @@ class JBMaze {
     static const int c_UP;
     static const int c_DOWN;
 
+    /* ------------------------------------------------------------------ *
+     * Compatibility flags (see setCompatibility(), below).  Each one
+     * restores the behavior of an older version of JBMaze, so that a
+     * given seed reproduces the maze it used to.
+     *
+     *   c_COMPAT_RESTART: when generate() is boxed in, pick random points
+     *     until one is found that has been visited, rather than choosing
+     *     from the cells that still have unvisited neighbors.
+     *   c_COMPAT_SOLVE: callers (like JBDungeon) solve the maze right
+     *     after generating it, before sparsify() and clearDeadends(), as
+     *     solve() once required; sparsify() spares the cell below (or
+     *     above) the beginning point on the end point's level, rather than
+     *     the beginning point itself.
+     *   c_COMPAT_DEADENDS: clearDeadends() extends each deadend by a
+     *     random walk, rather than by the shortest route to the nearest
+     *     passage.
+     *   c_COMPAT_RANDOM: draw random numbers from the C library's rand()
+     *     (see JBRandom::c_LEGACY), seeded when the flags are set.
+     *   c_COMPAT_DIRECTIONS: choose each random direction by drawing
+     *     directions until one will do, rather than by choosing among the
+     *     ones that will with a single draw (see JBRandom::choose()).
+     *   c_COMPAT_START: pick the point generate() starts from by drawing
+     *     points until one lies in the mask, rather than (once the first
+     *     has missed) by drawing one of the mask's valid points.
+     *   c_COMPAT_ALL: all of the above.
+     * ------------------------------------------------------------------ */
+    static const int c_COMPAT_RESTART;
+    static const int c_COMPAT_SOLVE;
+    static const int c_COMPAT_DEADENDS;
+    static const int c_COMPAT_RANDOM;
+    static const int c_COMPAT_DIRECTIONS;
+    static const int c_COMPAT_START;
+    static const int c_COMPAT_ALL;
+
+    /* ------------------------------------------------------------------ *
+     * Maze generation algorithms (see setAlgorithm(), below, and
+     * JBMazeGenerator).
+     * ------------------------------------------------------------------ */
+    static const int c_HUNTANDKILL;
+    static const int c_BACKTRACKER;
+    static const int c_GROWINGTREE;
+    static const int c_KRUSKAL;
+    static const int c_WILSON;
+    static const int c_TILED;
+    static const int c_LAYERED;
+    static const int c_STREAM;
+
+    /* ------------------------------------------------------------------ *
+     * Solving methods (see solve(), below).  All of them find a shortest
+     * path; they differ in how much of the maze they look at to find it.
+     *
+     *   c_SOLVE_BFS: breadth-first search from the start.
+     *   c_SOLVE_BIDIRECTIONAL: breadth-first search from both ends at
+     *     once, meeting in the middle.
+     * ------------------------------------------------------------------ */
+    static const int c_SOLVE_BFS;
+    static const int c_SOLVE_BIDIRECTIONAL;
+
+    /* ------------------------------------------------------------------ *
+     * Jobs that step() may carry out a piece at a time (see
+     * beginGenerate(), below).
+     * ------------------------------------------------------------------ */
+    static const int c_JOB_NONE;
+    static const int c_JOB_GENERATE;
+    static const int c_JOB_SPARSIFY;
+    static const int c_JOB_DEADENDS;
+
   public:
 
     /* ------------------------------------------------------------------ *
@@ -110,11 +224,58 @@ class JBMaze {
     int  getExitsAt( int x, int y, int z );
 
     /* ------------------------------------------------------------------ *
-     * Solve the maze, and return the solution as an array of points.  This
-     * will fail and return NO solution if the maze has previously had any
-     * number of it's deadends removed (see clearDeadends(), below).
+     * Returns the number of cells in the maze (x * y * z), and the number
+     * of bytes used to store them.
+     * ------------------------------------------------------------------ */
+    long getCellCount() { return (long)m_x * m_y * m_z; }
+    long getMemoryUsage();
+
+    /* ------------------------------------------------------------------ *
+     * Returns the cells themselves: one byte of exits per cell, with x
+     * varying fastest, then y, then z.
+     * ------------------------------------------------------------------ */
+    const unsigned char* getCells() { return m_maze; }
+
+    /* ------------------------------------------------------------------ *
+     * Solve the maze, and return the solution as an array of points (which
+     * the caller must free()).  The solution is the shortest path from the
+     * start to the end, even if clearDeadends() has added loops to the
+     * maze.  If there is no path, the solution is empty.  The method is
+     * one of the c_SOLVE_XXXX constants (above).
+     * ------------------------------------------------------------------ */
+    void solve( JBMazePt** path, int* pathLen, int method = c_SOLVE_BFS );
+
+    /* ------------------------------------------------------------------ *
+     * As above, but finds the shortest path between any two points.  The
+     * first call allocates five bytes per cell of scratch space, which is
+     * kept (until the maze is destroyed) so that later calls cost only as
+     * much as the part of the maze they search.
      * ------------------------------------------------------------------ */
-    void solve( JBMazePt** path, int* pathLen );
+    void solve( const JBMazePt& from, const JBMazePt& to,
+                JBMazePt** path, int* pathLen, int method = c_SOLVE_BFS );
+
+    /* ------------------------------------------------------------------ *
+     * As the two above, but the solution is packed into the given
+     * JBMazePath (see jbmazepath.h), which takes about a thirtieth of the
+     * memory of an array of points.
+     * ------------------------------------------------------------------ */
+    void solve( JBMazePath* path, int method = c_SOLVE_BFS );
+    void solve( const JBMazePt& from, const JBMazePt& to,
+                JBMazePath* path, int method = c_SOLVE_BFS );
+
+    /* ------------------------------------------------------------------ *
+     * Returns the number of cells the last call to solve() expanded.
+     * ------------------------------------------------------------------ */
+    long getNodesExpanded() { return m_nodesExpanded; }
+
+    /* ------------------------------------------------------------------ *
+     * Measures the maze (see JBMazeMetrics, above) in a single pass over
+     * its cells, and then, if solve is non-zero, finds the length of its
+     * solution with the bidirectional search.  The pass takes a small
+     * fraction of the time generate() does, so it may be run on every
+     * maze made.
+     * ------------------------------------------------------------------ */
+    void measure( JBMazeMetrics* metrics, int solve = 1 );
 
     /* ------------------------------------------------------------------ *
      * Sparsify the maze by the given amount.  The amount represents the
@@ -123,6 +284,10 @@ class JBMaze {
      * number should be to accomplish the same relative amount of
      * "sparsification".  Also, a maze will sparsify much better if
      * clearDeadends() has not yet been called.
+     *
+     * Both this and clearDeadends() find the deadends in a bitplane copy
+     * of the maze (six bits per cell), allocated by the first call, unless
+     * the maze is mapped (see setStorage()).
      * ------------------------------------------------------------------ */
     void sparsify( int amount );
 
@@ -130,10 +295,21 @@ class JBMaze {
      * Clears the given percentage of deadends from the maze by causing
      * the deadends to extend until they hit another passage.  As this
      * causes cycles in the maze, it can result in multiple possible solutions
-     * to the maze.  Thus, solve() must be called BEFORE clearDeadends()
-     * is called.
+     * to the maze, and solve() will then find the shortest of them.
+     *
+     * Each deadend is extended along the shortest route (through empty
+     * cells within the mask) to the nearest passage, searching no further
+     * than the connector radius (in steps, ignoring walls) from the deadend.
+     * A radius of 0 (the default) searches as far as it must.  Like solve(),
+     * the first call allocates five bytes of scratch space per cell.
      * ------------------------------------------------------------------ */
     void clearDeadends( int percentage );
+    void setConnectorRadius( int radius ) { m_connectorRadius = radius; }
+
+    /* ------------------------------------------------------------------ *
+     * Returns statistics about the last call to clearDeadends().
+     * ------------------------------------------------------------------ */
+    const JBMazeDeadendStats& getDeadendStats() { return m_deadendStats; }
 
     /* ------------------------------------------------------------------ *
      * Generates the maze.  This must be called BEFORE solve(), sparsify(),
@@ -141,9 +317,60 @@ class JBMaze {
      * ------------------------------------------------------------------ */
     void generate();
 
+    /* ------------------------------------------------------------------ *
+     * generate(), sparsify(), and clearDeadends(), a piece at a time, for
+     * a caller that must bound how long each call takes (a server sharing
+     * one thread among many mazes, or a display showing the maze as it is
+     * carved).  Each begin method starts a job, and step() then does at
+     * most budget units of it, returning how many it did; the job is over
+     * when getJob() returns c_JOB_NONE.  A unit is a passage carved
+     * (generate), a cell erased (sparsify), or a deadend looked at
+     * (clearDeadends, which carves each connecting passage all at once).
+     * A job run to the end leaves exactly the maze that the method itself
+     * would have.
+     *
+     * The maze must not be changed in between steps; setting its mask,
+     * generator, or storage abandons the job in progress, and beginning a
+     * job finishes it.  Of the generators, only
+     * hunt-and-kill and the backtracker stop part way; the others carve
+     * the whole maze on the first step (see JBMazeGenerator::step()), as
+     * does clearDeadends() under c_COMPAT_DEADENDS.
+     * ------------------------------------------------------------------ */
+    void beginGenerate();
+    void beginSparsify( int amount );
+    void beginClearDeadends( int percentage );
+    long step( long budget );
+    int  getJob() { return m_job; }
+
+    /* ------------------------------------------------------------------ *
+     * The progress of the current job, in units of work (see above): how
+     * many are left, and how many there were in all.  Erasing a deadend
+     * may leave another behind it, so the total of a sparsify job grows
+     * as it runs.
+     * ------------------------------------------------------------------ */
+    long getRemaining();
+    long getTotal();
+
+    /* ------------------------------------------------------------------ *
+     * Selects the algorithm generate() uses, one of the c_XXXX algorithm
+     * constants (above).  The default is c_HUNTANDKILL.  getAlgorithm()
+     * returns -1 if a custom generator has been set.
+     * ------------------------------------------------------------------ */
+    void setAlgorithm( int algorithm );
+    int  getAlgorithm() { return m_algorithm; }
+
+    /* ------------------------------------------------------------------ *
+     * Sets the generator that generate() uses.  The maze takes ownership
+     * of the generator, and deletes it when it is no longer needed.  Pass
+     * 0 to return to the built-in hunt-and-kill algorithm.
+     * ------------------------------------------------------------------ */
+    void setGenerator( JBMazeGenerator* generator );
+    JBMazeGenerator* getGenerator() { return m_generator; }
+
     /* ------------------------------------------------------------------ *
      * Sets the mask to be used when generating the maze.  As such, it
-     * must be called BEFORE generate to have any effect.
+     * must be called BEFORE generate to have any effect.  The maze takes
+     * over the caller's reference to the mask (see JBMazeMask::retain()).
      * ------------------------------------------------------------------ */
     void setMask( JBMazeMask* mask );
 
@@ -152,33 +379,182 @@ class JBMaze {
      * ------------------------------------------------------------------ */
     JBMazeMask* getMask() { return m_mask; }
 
+    /* ------------------------------------------------------------------ *
+     * Sets (or retrieves) the compatibility flags of the maze, a bitwise
+     * combination of the JBMaze::c_COMPAT_XXXX constants (above).  The
+     * default is 0, which selects the fastest behavior.  Setting the
+     * flags restarts the maze's random stream from its seed, so they must
+     * be set BEFORE generate().
+     * ------------------------------------------------------------------ */
+    void setCompatibility( int flags );
+    int  getCompatibility() { return m_compatibility; }
+
+    /* ------------------------------------------------------------------ *
+     * Sets (or retrieves) the random stream of the maze, which is seeded
+     * from the maze's seed when the maze is created.  generate() and
+     * clearDeadends() each split a sub-stream of their own from it (see
+     * JBRandom::split()).  A caller that owns a stream of its own (like
+     * JBDungeon) may give the maze one of its sub-streams instead.
+     * ------------------------------------------------------------------ */
+    void setRandom( const JBRandom& random ) { m_random = random; }
+    JBRandom& getRandom() { return m_random; }
+
+    /* ------------------------------------------------------------------ *
+     * Single-level mazes are generated (and their deadends cleared) by
+     * kernels compiled for two dimensions (see JBMazeCore), which choose
+     * among four directions rather than six, and so give a different maze
+     * for the same seed.  Setting this forces the generic kernels instead
+     * (as a legacy random stream always does; see c_COMPAT_RANDOM).
+     * ------------------------------------------------------------------ */
+    void setGeneric( int generic ) { m_generic = generic; }
+    int  getGeneric() { return m_generic; }
+
+    /* ------------------------------------------------------------------ *
+     * Backs the maze with the given file (see JBMazeStorage), rather than
+     * with memory, so that it may be larger than physical memory.  The
+     * file holds the cells as getCells() returns them, and is kept when
+     * the maze is destroyed, unless it is temporary.  The scratch space of
+     * generate() and solve() is then kept in temporary files beside it.
+     * Like setMask(), this empties the maze, so it must be called BEFORE
+     * generate().  Pass NULL to return to memory.
+     *
+     * Only c_STREAM walks the maze in an order that keeps the pages it
+     * holds bounded; any other algorithm works, but touches pages in no
+     * particular order.  See the README for the limits of each phase.
+     * ------------------------------------------------------------------ */
+    void setStorage( const char* path, int temporary = 0 );
+    JBMazeStorage* getStorage() { return m_storage; }
+
+    /* ------------------------------------------------------------------ *
+     * Sets the page-cache hint (one of the JBMazeStorage::c_XXXX advice
+     * constants) for the cells of a mapped maze, outside of the phases
+     * that walk them in order.  The default is JBMazeStorage::c_NORMAL.
+     * ------------------------------------------------------------------ */
+    void setAdvice( int advice );
+    int  getAdvice() { return m_advice; }
+
   private:
+
+    friend class JBMazeGenerator;
+    friend class JBMazeSnapshot;
+    template< int D > friend class JBMazeCore;
   
     /* ------------------------------------------------------------------ *
-     * Used internally to verify that a given point has been visited during
-     * "sparsification".
+     * A value that is not a direction, used internally to mark cells.
      * ------------------------------------------------------------------ */
     static const int c_MARK;
 
-    struct JBMAZE_SOLUTION {
-      int x;
-      int y;
-      int z;
-      int directions;
-      JBMAZE_SOLUTION* previous;
+    /* ------------------------------------------------------------------ *
+     * The alignment (in bytes) of the block holding the maze cells.
+     * ------------------------------------------------------------------ */
+    static const int c_ALIGNMENT;
+
+    /* ------------------------------------------------------------------ *
+     * The sub-streams (see JBRandom::split()) of each random phase.
+     * ------------------------------------------------------------------ */
+    static const int c_STREAM_GENERATE;
+    static const int c_STREAM_DEADENDS;
+
+    /* ------------------------------------------------------------------ *
+     * Every direction, and the initial capacity (a power of two) of the
+     * queues used by solve().
+     * ------------------------------------------------------------------ */
+    static const int  c_ALLDIRS;
+    static const long c_QUEUE_SIZE;
+
+    /* ------------------------------------------------------------------ *
+     * A ring buffer of cells.
+     * ------------------------------------------------------------------ */
+    struct JBMAZE_QUEUE {
+      long* cells;
+      long  capacity;
+      long  head;
+      long  count;
     };
 
     /* ------------------------------------------------------------------ *
-     * Used internally by solve() to keep track of the current solution
-     * state.
+     * Used internally to move around the maze: whether a point lies within
+     * the maze, the change in m_index() that moves one cell in the given
+     * direction, the direction that leads back, moving a point, and the
+     * point at a given index.
+     * ------------------------------------------------------------------ */
+    int  m_contains( const JBMazePt& pt );
+    long m_offset( int direction );
+    int  m_opposite( int direction );
+    void m_move( int direction, JBMazePt* pt );
+    void m_point( long cell, JBMazePt* pt );
+
+    /* ------------------------------------------------------------------ *
+     * Used internally by solve().  Each search leaves, for every cell it
+     * reaches, the direction back toward where it started in m_solveFrom,
+     * which m_traceLength() and m_trace() follow from a cell to the stop
+     * cell (writing each point, then stepping through path by step), and
+     * m_tracePath() does the same for a JBMazePath, from the given index.
+     * m_solve() runs the search the method names; the path then runs back
+     * from 'meet' to 'start', and on from 'other' (if it is not -1) to
+     * 'end'.
+     * ------------------------------------------------------------------ */
+    int  m_solve( const JBMazePt& from, const JBMazePt& to, int method,
+                  long* start, long* meet, long* other, long* end );
+    int  m_solveBFS( long start, long end );
+    int  m_solveBidirectional( long start, long end, long* meet, long* other );
+    int  m_traceLength( long cell, long stop );
+    void m_trace( long cell, long stop, JBMazePt* path, int step );
+    void m_tracePath( long cell, long stop, JBMazePath* path, long index, int step );
+
+    void m_allocateSolver();
+    void m_deallocateSolver();
+    unsigned int m_nextSolveGeneration();
+    void m_enqueue( JBMAZE_QUEUE* queue, long cell );
+    long m_dequeue( JBMAZE_QUEUE* queue );
+
+    /* ------------------------------------------------------------------ *
+     * Returns non-zero if the given exits are those of a deadend (exactly
+     * one way out).
+     * ------------------------------------------------------------------ */
+    int  m_isDeadend( int exits );
+
+    /* ------------------------------------------------------------------ *
+     * Adds every deadend of the maze to the queue, in order, except the
+     * two cells in keep (either of which may be -1).  The deadends are
+     * found in a bitplane mirror of the maze (see JBMazePlanes), which is
+     * allocated by the first call, or by scanning the cells of a mapped
+     * maze (or a branch of a snapshot) in order.
      * ------------------------------------------------------------------ */
-    JBMAZE_SOLUTION* m_push( int x, int y, int z, JBMAZE_SOLUTION* stack );
-    JBMAZE_SOLUTION* m_pop( JBMAZE_SOLUTION* stack );
+    void m_findDeadends( JBMAZE_QUEUE* queue, const long* keep );
 
     /* ------------------------------------------------------------------ *
-     * Used internally by sparsify() to clear all marks of visitation.
+     * Used internally by clearDeadends().  m_walkDeadends() is the original
+     * random-walk algorithm (see c_COMPAT_DEADENDS), and m_walkDirections()
+     * returns the directions it may take from the given point.
      * ------------------------------------------------------------------ */
-    void m_clearMarks();
+    void m_walkDeadends( int percentage );
+    int  m_walkDirections( int x, int y, int z );
+    void m_recordConnector( long length );
+
+    /* ------------------------------------------------------------------ *
+     * Used internally by step(), for each job, and to run the current job
+     * to the end (m_finishJob()) or abandon it (m_endJob()).
+     * ------------------------------------------------------------------ */
+    long m_stepGenerate( long budget );
+    long m_stepSparsify( long budget );
+    long m_stepDeadends( long budget );
+    void m_finishJob();
+    void m_endJob();
+
+    /* ------------------------------------------------------------------ *
+     * Returns non-zero if the two-dimensional kernels (see setGeneric(),
+     * above) are to be used.
+     * ------------------------------------------------------------------ */
+    int  m_planar();
+
+    /* ------------------------------------------------------------------ *
+     * Used internally by generate() to allocate the frontier (see
+     * JBMazeCore): the visited cells that still have at least one
+     * unvisited neighbor within the mask.
+     * ------------------------------------------------------------------ */
+    void m_allocateFrontier();
+    void m_deallocateFrontier();
 
     /* ------------------------------------------------------------------ *
      * Used internally for allocation and reallocation of the maze.
@@ -186,6 +562,22 @@ class JBMaze {
     void m_allocateMaze();
     void m_deallocateMaze();
 
+    /* ------------------------------------------------------------------ *
+     * Allocates a zeroed block of scratch space, kept in a temporary file
+     * named for the maze's own (plus the given suffix) if the maze is
+     * mapped, and in memory otherwise.
+     * ------------------------------------------------------------------ */
+    JBMazeStorage* m_allocateScratch( const char* suffix, long size );
+
+    /* ------------------------------------------------------------------ *
+     * Converts a point in the maze to an offset into m_maze.  Cells are
+     * stored with x varying fastest, then y, then z, so each row of a
+     * level is contiguous.
+     * ------------------------------------------------------------------ */
+    long m_index( int x, int y, int z ) {
+      return ( (long)z * m_y + y ) * m_x + x;
+    }
+
   private:
 
     int    m_x;               /* x-dimension */
@@ -195,14 +587,58 @@ class JBMaze {
     JBMazePt m_start;         /* starting point */
     JBMazePt m_end;           /* ending point */
 
-    int*** m_maze;            /* the maze itself (three-dimensional) */
+    unsigned char* m_maze;    /* the maze itself (one byte per cell) */
+    JBMazeStorage* m_storage; /* the block holding m_maze */
+    char*  m_storagePath;     /* the file backing m_storage, if any */
+    int    m_storageTemporary; /* non-zero to remove the file with the maze */
+    int    m_advice;          /* the page-cache hint for m_maze */
 
     int    m_randomness;      /* (0-100) how often the passages bend */
     long   m_seed;            /* the random seed value */
 
-    int    m_deadendsClosed;  /* (bool) has clearDeadends() been called? */
+    int    m_compatibility;   /* c_COMPAT_XXXX flags */
+
+    JBRandom m_random;        /* the root random stream */
+    JBRandom m_phase;         /* the sub-stream of the current phase */
+
+    JBMazeStorage* m_frontierStorage; /* holds m_frontier and m_frontierPos */
+    long*  m_frontier;        /* frontier cells (only during generate()) */
+    long*  m_frontierPos;     /* each cell's index in m_frontier, or -1 */
+    long   m_frontierCount;   /* the number of cells in m_frontier */
 
     JBMazeMask* m_mask;       /* the mask to use for generating the maze */
+
+    int    m_generic;         /* non-zero to force the generic kernels */
+
+    int    m_algorithm;       /* the c_XXXX algorithm constant */
+    JBMazeGenerator* m_generator; /* the generator (0 for hunt-and-kill) */
+
+    /* scratch space for solve(), allocated by the first call */
+
+    JBMazeStorage* m_solveStorage;    /* holds m_solveStamp and m_solveFrom */
+    unsigned int*  m_solveStamp;      /* the search that last reached each cell */
+    unsigned char* m_solveFrom;       /* the way back from each reached cell */
+    unsigned int   m_solveGeneration; /* the stamp of the current search */
+    JBMAZE_QUEUE   m_solveQueue[ 2 ]; /* one per side of the search */
+    long           m_solveOffsets[ 0x21 ]; /* m_offset(), by direction */
+    unsigned char  m_solveBack[ 0x21 ];    /* m_opposite(), by direction */
+    long           m_nodesExpanded;   /* cells expanded by the last solve() */
+
+    JBMazePlanes*  m_planes;          /* the bitplanes of m_findDeadends() */
+
+    int    m_connectorRadius;  /* the furthest clearDeadends() searches */
+    JBMazeDeadendStats m_deadendStats; /* from the last clearDeadends() */
+
+    /* the current job (see step()), kept between steps */
+
+    int    m_job;             /* the c_JOB_XXXX constant */
+    JBMazeWalk* m_walk;       /* hunt-and-kill's place in generate() */
+    JBMAZE_QUEUE m_jobQueue;  /* the deadends sparsify() and clearDeadends() have left */
+    long   m_jobKeep[ 2 ];    /* the cells sparsify() leaves alone */
+    int    m_jobAmount;       /* sparsify()'s rounds, or clearDeadends()'s percentage */
+    int    m_jobRound;        /* sparsify()'s current round */
+    long   m_jobRoundLeft;    /* the cells left in it */
+    long   m_jobTotal;        /* units of work, in all */
 };
 
 #endif /* __JBMAZE_H__ */
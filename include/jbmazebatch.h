@@ -0,0 +1,127 @@
+/* ---------------------------------------------------------------------- *
+ * This file is in the public domain, and may be used, modified, and
+ * distributed without restriction.
+ * ---------------------------------------------------------------------- *
+ * JBMazeBatch
+ *
+ * Author: Jamis Buck <jamis@jamisbuck.org>
+ * Homepage: http://github.com/jamis/dnd-dungeon
+ *
+ * JBMazeBatch generates a batch of small, rectangular, single-level mazes
+ * at once, for when the cost of creating a JBMaze for each one would be
+ * more than the cost of carving it (thumbnails, for instance).  Every
+ * maze of the batch is carved by the backtracker, each from a random
+ * stream of its own, and the mazes are stored in lanes: the exits of a
+ * given cell of every maze lie next to each other, so one pass over the
+ * lanes carves one step of every maze.
+ *
+ * With no mask, the backtracker takes exactly the same number of steps
+ * (one forward and one back for every cell) on every maze of a given
+ * size, so the lanes never wait for each other, and a step never has to
+ * branch on which way a maze went.  The mazes themselves do not depend on
+ * how many lanes there are, but they are not the mazes JBMaze would carve
+ * from the same seeds.
+ * ---------------------------------------------------------------------- */
+
+#ifndef __JBMAZEBATCH_H__
+#define __JBMAZEBATCH_H__
+
+#include <stdint.h>
+
+#include "jbmaze.h"
+
+
+class JBMazeBatch {
+  public:
+
+    /* ------------------------------------------------------------------ *
+     * The most lanes a batch may have, and the most cells each maze may
+     * have.
+     * ------------------------------------------------------------------ */
+    static const int c_MAX_LANES;
+    static const int c_MAX_CELLS;
+
+  public:
+
+    /* ------------------------------------------------------------------ *
+     * JBMazeBatch( int x, int y, int lanes, int randomness )
+     *
+     * Prepares a batch of the given number of mazes (1 to c_MAX_LANES) of
+     * the given dimensions.  As with JBMaze, the randomness (0-100) is how
+     * often a passage bends.  The space for the mazes is allocated once,
+     * here, and reused by every call to generate().
+     * ------------------------------------------------------------------ */
+    JBMazeBatch( int x, int y, int lanes = 8, int randomness = 100 );
+    ~JBMazeBatch();
+
+    int  getX() { return m_x; }
+    int  getY() { return m_y; }
+    int  getLanes() { return m_lanes; }
+    int  getRandomness() { return m_randomness; }
+    long getCellCount() { return (long)m_x * m_y; }
+
+    /* ------------------------------------------------------------------ *
+     * Generates every maze of the batch, the maze in lane i from a stream
+     * seeded with seeds[ i ] (or, in the second form, with seed + i).
+     * ------------------------------------------------------------------ */
+    void generate( const long* seeds );
+    void generate( long seed );
+
+    /* ------------------------------------------------------------------ *
+     * Returns the exits at the given point of the maze in the given lane,
+     * just as JBMaze::getExitsAt() does.
+     * ------------------------------------------------------------------ */
+    int  getExitsAt( int lane, int x, int y ) {
+      if( ( lane < 0 ) || ( lane >= m_lanes ) ) {
+        return 0;
+      }
+      if( ( x < 0 ) || ( y < 0 ) || ( x >= m_x ) || ( y >= m_y ) ) {
+        return 0;
+      }
+      return m_cells[ ( (long)y * m_x + x ) * m_lanes + lane ];
+    }
+
+    /* ------------------------------------------------------------------ *
+     * Returns the cells of every maze: one byte of exits per cell and
+     * lane, with the lane varying fastest, then x, then y.
+     * ------------------------------------------------------------------ */
+    const unsigned char* getCells() { return m_cells; }
+
+  private:
+
+    /* ------------------------------------------------------------------ *
+     * Carves one step of the maze in every lane: either a passage from the
+     * top of its stack to a neighbor it has not visited, or, if there is
+     * none, back to the cell before.
+     * ------------------------------------------------------------------ */
+    void m_step();
+
+    static uint64_t m_rotate( uint64_t x, int k ) {
+      return ( x << k ) | ( x >> ( 64 - k ) );
+    }
+
+    int   m_x;
+    int   m_y;
+    int   m_lanes;
+    int   m_randomness;
+
+    unsigned char* m_block;        /* the cells, with a guard row on each side */
+    unsigned char* m_cells;        /* the cells of every lane (see getCells()) */
+    unsigned char* m_bounds;       /* the directions that stay in the maze, by cell */
+    int   m_offsets[ 0x09 ];       /* the change in cell, by direction */
+    long  m_steps[ 0x09 ];         /* the same, in bytes of m_cells */
+    int   m_limits[ 0x09 ];        /* the longest straight stretch, by direction */
+    unsigned char m_choices[ 0x10 ][ 4 ]; /* the directions in each set of exits */
+    unsigned char m_counts[ 0x10 ];       /* and how many there are */
+
+    /* the state of each lane */
+
+    uint64_t* m_state;             /* its xoshiro256** stream, word by word */
+    uint64_t* m_draws;             /* the number it drew for this step */
+    int*  m_stacks;                /* its stack of cells (m_x * m_y per lane) */
+    int*  m_depth;                 /* the height of its stack */
+    int*  m_last;                  /* the direction of its last step */
+    int*  m_stretch;               /* how long it has gone straight */
+};
+
+#endif /* __JBMAZEBATCH_H__ */
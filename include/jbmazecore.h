@@ -0,0 +1,136 @@
+/* ---------------------------------------------------------------------- *
+ * This file is in the public domain, and may be used, modified, and
+ * distributed without restriction.
+ * ---------------------------------------------------------------------- *
+ * JBMazeCore
+ *
+ * Author: Jamis Buck <jamis@jamisbuck.org>
+ * Homepage: http://github.com/jamis/dnd-dungeon
+ *
+ * JBMazeCore holds the inner loops of JBMaze -- hunt-and-kill generation
+ * (with its frontier), and the search that connects a deadend to the
+ * nearest passage -- compiled once for each number of dimensions:
+ *
+ *   JBMazeCore<2>: single-level mazes.  There is no z axis at all, and
+ *     random directions are chosen from the four compass points.
+ *   JBMazeCore<3>: the generic kernels, for mazes of any number of
+ *     levels, choosing from all six directions.
+ *
+ * Each step of generate() finds every direction that leads to an unvisited
+ * cell at once, and picks one of them with a single random number (see
+ * JBRandom::choose()), unless JBMaze::c_COMPAT_DIRECTIONS asks for the
+ * original loop, which draws directions until it finds one that will do.
+ *
+ * Directions are numbered 0-5 (north, south, west, east, up, down), so
+ * that the exit bit of direction i is (1 << i), and the direction that
+ * leads back is (i ^ 1).  Only the offsets of the neighboring cells (which
+ * depend on the size of the maze) are computed when a kernel is called.
+ *
+ * JBMaze chooses the kernels itself (see JBMaze::setGeneric()).
+ *
+ * Generation may also stop after any number of passages and pick up again
+ * later (see JBMaze::step()); everything it needs to carry on is kept in
+ * a JBMazeWalk between the calls.
+ * ---------------------------------------------------------------------- */
+
+#ifndef __JBMAZECORE_H__
+#define __JBMAZECORE_H__
+
+#include "jbmaze.h"
+
+
+/* ---------------------------------------------------------------------- *
+ * JBMazeWalk
+ *
+ * The state of a hunt-and-kill generation, between one step and the next.
+ * Directions are numbered as for JBMazeCore (0-5).
+ * ---------------------------------------------------------------------- */
+struct JBMazeWalk {
+  long offsets[ 6 ];        /* the change in cell index, by direction */
+  int  limits[ 6 ];         /* the longest straight stretch, by direction */
+  long total;               /* passages to carve, in all */
+  long remaining;           /* passages still to carve */
+  long cell;                /* the current cell */
+  int  x;                   /* and its coordinates */
+  int  y;
+  int  z;
+  int  directions;          /* directions ruled out from the current cell */
+  int  allDirections;       /* every direction */
+  int  lastDirection;       /* the direction of the last passage, or -1 */
+  int  straightStretch;     /* how long the passage has gone straight */
+  int  useFrontier;         /* non-zero to restart from the frontier */
+  long scan;                /* the next cell to look at for a region of
+                               the mask that has not been visited */
+  int  rejection;           /* non-zero to draw directions one at a time */
+};
+
+
+template< int D >
+class JBMazeCore {
+  public:
+
+    /* ------------------------------------------------------------------ *
+     * The number of directions a passage may take.
+     * ------------------------------------------------------------------ */
+    enum { c_DIRECTIONS = ( D == 2 ? 4 : 6 ) };
+
+    /* ------------------------------------------------------------------ *
+     * Generates the maze by the hunt-and-kill algorithm (see
+     * JBMaze::generate()), drawing from the maze's current random phase.
+     * ------------------------------------------------------------------ */
+    static void generate( JBMaze* maze );
+
+    /* ------------------------------------------------------------------ *
+     * The same, in pieces: begin() prepares the walk (drawing the first
+     * cell), step() carves at most budget passages and returns how many it
+     * carved, and end() releases what begin() allocated.  The walk is
+     * over when its remaining count reaches 0.
+     * ------------------------------------------------------------------ */
+    static void begin( JBMaze* maze, JBMazeWalk* walk );
+    static long step( JBMaze* maze, JBMazeWalk* walk, long budget );
+    static void end( JBMaze* maze, JBMazeWalk* walk );
+
+    /* ------------------------------------------------------------------ *
+     * Carves the shortest route from the given deadend to the nearest
+     * passage, and returns the number of cells carved (0 if there is no
+     * such route).  The maze's solver must already be allocated.
+     * ------------------------------------------------------------------ */
+    static long connectDeadend( JBMaze* maze, long cell );
+
+  private:
+
+    /* ------------------------------------------------------------------ *
+     * Moves the given point one cell in direction i, and returns non-zero
+     * if the point is still within the maze.
+     * ------------------------------------------------------------------ */
+    static int  m_step( JBMaze* maze, int i, int* x, int* y, int* z );
+
+    /* ------------------------------------------------------------------ *
+     * Fills in the change in cell index for each direction.
+     * ------------------------------------------------------------------ */
+    static void m_offsets( JBMaze* maze, long* offsets );
+
+    /* ------------------------------------------------------------------ *
+     * Returns the point at the given cell index.
+     * ------------------------------------------------------------------ */
+    static void m_point( JBMaze* maze, long cell, int* x, int* y, int* z );
+
+    /* ------------------------------------------------------------------ *
+     * Returns the directions (as exit bits) from the given cell that lead
+     * to an unvisited cell within the mask.
+     * ------------------------------------------------------------------ */
+    static int  m_open( JBMaze* maze, const long* offsets,
+                        long cell, int x, int y, int z );
+
+    /* ------------------------------------------------------------------ *
+     * Track the frontier of generate(): the visited cells that still have
+     * at least one unvisited neighbor within the mask.  m_visit() must be
+     * called each time a cell is visited.
+     * ------------------------------------------------------------------ */
+    static void m_frontierUpdate( JBMaze* maze, const long* offsets,
+                                  long cell, int x, int y, int z );
+    static void m_visit( JBMaze* maze, const long* offsets,
+                         long cell, int x, int y, int z );
+};
+
+#endif /* __JBMAZECORE_H__ */
@@ -0,0 +1,392 @@
+/* ---------------------------------------------------------------------- *
+ * This file is in the public domain, and may be used, modified, and
+ * distributed without restriction.
+ * ---------------------------------------------------------------------- *
+ * JBMazeGenerator
+ *
+ * Author: Jamis Buck <jamis@jamisbuck.org>
+ * Homepage: http://github.com/jamis/dnd-dungeon
+ *
+ * JBMazeGenerator is an abstract class that standardizes how the passages
+ * of a JBMaze are carved.  JBMaze uses its own hunt-and-kill algorithm
+ * unless it is given a generator (see JBMaze::setAlgorithm() and
+ * JBMaze::setGenerator()).  This file also includes the generators that
+ * are bundled with JBMaze:
+ *
+ *   - JBBacktrackerGenerator
+ *       recursive backtracking, using an explicit stack.  Long, winding
+ *       passages with few branches.
+ *   - JBGrowingTreeGenerator
+ *       growing-tree, choosing either the newest or a random cell from the
+ *       active list.  Behaves like the backtracker or like Prim's algorithm
+ *       depending on the mix.
+ *   - JBKruskalGenerator
+ *       randomized Kruskal's algorithm over a union-find forest.  Many
+ *       short dead-ends.
+ *   - JBWilsonGenerator
+ *       Wilson's algorithm (loop-erased random walks), which produces an
+ *       unbiased sample of all possible mazes.
+ *   - JBTiledGenerator
+ *       splits the maze into square tiles, carves each one (with the
+ *       backtracker) on a pool of threads, and then joins the tiles with
+ *       randomized Kruskal's algorithm.  For very large mazes.
+ *   - JBLayeredGenerator
+ *       carves each level of the maze (with the backtracker) on a pool of
+ *       threads, and then joins the levels with a chosen number of
+ *       stairways.  For mazes with many levels.
+ *   - JBStreamGenerator
+ *       carves each level a row at a time with Eller's algorithm (see
+ *       JBMazeStream), in the order the rows are stored, and joins the
+ *       levels with one stairway in each region of the mask.  For mazes
+ *       larger than memory (see JBMaze::setStorage()).
+ *
+ * Every generator respects the maze's mask, and uses the maze's randomness
+ * as the chance that a passage bends (rather than continuing straight) at
+ * each step, just as the hunt-and-kill algorithm does.  Unlike hunt-and-
+ * kill, they carve a maze in every region of the mask, even those that are
+ * not connected to each other.
+ * ---------------------------------------------------------------------- */
+
+#ifndef __JBMAZEGENERATOR_H__
+#define __JBMAZEGENERATOR_H__
+
+#include <pthread.h>
+
+#include "jbmaze.h"
+
+class JBMazeGenerator {
+  public:
+
+    JBMazeGenerator() { m_peakMemory = 0; m_total = m_remaining = 0; }
+    virtual ~JBMazeGenerator() { }
+
+    /* ------------------------------------------------------------------ *
+     * void generate( JBMaze* maze )
+     *
+     * Carves the passages of the given (empty) maze.
+     * ------------------------------------------------------------------ */
+    virtual void generate( JBMaze* maze ) = 0;
+
+    /* ------------------------------------------------------------------ *
+     * void begin( JBMaze* maze )
+     * long step( JBMaze* maze, long budget )
+     *
+     * Carve the passages of the given (empty) maze a piece at a time (see
+     * JBMaze::step()).  begin() prepares the maze, and each call to step()
+     * then carves at most budget passages and returns how many it carved.
+     * The maze is done when getRemaining() returns 0.  By default, the
+     * whole maze is carved (by generate()) on the first step; a generator
+     * that can stop part way overrides both.
+     * ------------------------------------------------------------------ */
+    virtual void begin( JBMaze* maze );
+    virtual long step( JBMaze* maze, long budget );
+
+    /* ------------------------------------------------------------------ *
+     * The passages that begin() expected to carve, and those that are
+     * left (as of the last step()).
+     * ------------------------------------------------------------------ */
+    long getTotal() { return m_total; }
+    long getRemaining() { return m_remaining; }
+
+    /* ------------------------------------------------------------------ *
+     * const char* getName()
+     *
+     * Returns the name of the algorithm (see create(), below).
+     * ------------------------------------------------------------------ */
+    virtual const char* getName() = 0;
+
+    /* ------------------------------------------------------------------ *
+     * long getPeakMemory()
+     *
+     * Returns the largest number of bytes the last call to generate()
+     * allocated on top of the maze itself.
+     * ------------------------------------------------------------------ */
+    long getPeakMemory() { return m_peakMemory; }
+
+    /* ------------------------------------------------------------------ *
+     * static JBMazeGenerator* create( int algorithm )
+     *
+     * Creates a new generator for the given JBMaze::c_XXXX algorithm
+     * constant.  Returns 0 for JBMaze::c_HUNTANDKILL (which is built in to
+     * JBMaze) or for an unknown algorithm.
+     * ------------------------------------------------------------------ */
+    static JBMazeGenerator* create( int algorithm );
+
+    /* ------------------------------------------------------------------ *
+     * static int findAlgorithm( const char* name )
+     *
+     * Returns the JBMaze::c_XXXX algorithm constant with the given name
+     * ("huntandkill", "backtracker", "growingtree", "kruskal", "wilson",
+     * "tiled", "layered", or "stream"), or -1 if there is no such
+     * algorithm.
+     * ------------------------------------------------------------------ */
+    static int findAlgorithm( const char* name );
+
+  protected:
+
+    /* ------------------------------------------------------------------ *
+     * Direct access to the cells of the maze, for subclasses.  Cells are
+     * laid out as described by JBMaze::m_index().
+     * ------------------------------------------------------------------ */
+    static unsigned char* m_getCells( JBMaze* maze ) { return maze->m_maze; }
+
+    /* ------------------------------------------------------------------ *
+     * The random stream that generate() has set aside for the generator
+     * (see JBMaze::getRandom()).
+     * ------------------------------------------------------------------ */
+    static JBRandom& m_getRandom( JBMaze* maze ) { return maze->m_phase; }
+
+    /* ------------------------------------------------------------------ *
+     * Returns the directions (a bitwise combination of JBMaze::c_XXXX
+     * directions) that lead from the given point to a point that lies
+     * within both the maze and its mask.  If unvisitedOnly is non-zero,
+     * directions leading to a cell that already has an exit are left out.
+     * ------------------------------------------------------------------ */
+    static int m_openDirections( JBMaze* maze, int x, int y, int z, int unvisitedOnly );
+
+    /* ------------------------------------------------------------------ *
+     * Chooses one of the given candidate directions.  With a chance of
+     * (100 - randomness)%, the last direction is reused if it is still a
+     * candidate and the current straight stretch is less than half the
+     * relevant dimension of the maze.  Otherwise a candidate is chosen at
+     * random, and the stretch is reset.  The second form draws from the
+     * given stream rather than the maze's.
+     * ------------------------------------------------------------------ */
+    static int m_chooseDirection( JBMaze* maze, int candidates, int lastDirection, int* stretch );
+    static int m_chooseDirection( JBMaze* maze, JBRandom& random, int candidates,
+                                  int lastDirection, int* stretch );
+
+    /* ------------------------------------------------------------------ *
+     * Helpers for moving around the maze.
+     * ------------------------------------------------------------------ */
+    static int  m_opposite( int direction );
+    static long m_offset( JBMaze* maze, int direction );
+    static void m_move( int direction, int* x, int* y, int* z );
+    static void m_point( JBMaze* maze, long cell, int* x, int* y, int* z );
+
+    /* ------------------------------------------------------------------ *
+     * Connects the cell to its neighbor in the given direction.
+     * ------------------------------------------------------------------ */
+    static void m_carve( JBMaze* maze, long cell, int direction );
+
+    /* ------------------------------------------------------------------ *
+     * Returns the number of passages a perfect maze within the mask has:
+     * one fewer than the cells within the mask.
+     * ------------------------------------------------------------------ */
+    static long m_passageCount( JBMaze* maze );
+
+    /* ------------------------------------------------------------------ *
+     * Finds the regions of the mask (its points that are joined to one
+     * another, within one level of the maze) and returns how many there
+     * are.  region[] (one per cell of a level) is left holding the region
+     * of each cell, or -1; the cells of region i are listed together in
+     * order[], from order[first[i]] up to order[first[i+1]].  first[]
+     * must have room for one more than the cells of a level.
+     * ------------------------------------------------------------------ */
+    static long m_findRegions( JBMaze* maze, long* region, long* order, long* first );
+
+    /* ------------------------------------------------------------------ *
+     * m_runTasks() calls m_runTask() once for each task from 0 to count-1,
+     * on the given number of threads (the calling thread among them), and
+     * returns when they are all done.  worker (0 to threads-1) is the
+     * thread running the task.  m_threadCount() returns how many threads
+     * to run count tasks on, when the caller asks for the given number (0
+     * being one per processor).
+     * ------------------------------------------------------------------ */
+    static int m_threadCount( long count, int threads );
+    void m_runTasks( long count, int threads );
+    virtual void m_runTask( long task, int worker ) { }
+
+    long m_peakMemory;      /* bytes allocated by the last generate() */
+    long m_total;           /* passages to carve (see begin()) */
+    long m_remaining;       /* passages left to carve */
+
+  private:
+
+    struct JBMAZE_WORKER {
+      JBMazeGenerator* generator;
+      int              worker;
+    };
+
+    static void* m_work( void* worker );
+
+    long            m_taskCount;
+    long            m_nextTask;
+    pthread_mutex_t m_taskLock;       /* guards m_nextTask */
+};
+
+
+class JBBacktrackerGenerator : public JBMazeGenerator {
+  public:
+    JBBacktrackerGenerator() { m_stack = 0; }
+    virtual ~JBBacktrackerGenerator() { delete[] m_stack; }
+
+    virtual void generate( JBMaze* maze );
+    virtual const char* getName() { return "backtracker"; }
+
+    /* the backtracker may stop after any passage */
+
+    virtual void begin( JBMaze* maze );
+    virtual long step( JBMaze* maze, long budget );
+
+  private:
+
+    long* m_stack;          /* the cells of the current passage */
+    long  m_depth;          /* the height of m_stack */
+    long  m_next;           /* where to look next for a new root */
+    int   m_lastDirection;  /* the direction of the last passage */
+    int   m_stretch;        /* how long the passage has gone straight */
+};
+
+
+class JBGrowingTreeGenerator : public JBMazeGenerator {
+  public:
+
+    /* ------------------------------------------------------------------ *
+     * JBGrowingTreeGenerator( int newest )
+     *
+     * newest is the percentage of the time that the most recently added
+     * cell is grown (100 is the same as the backtracker); the rest of the
+     * time, a random active cell is grown (0 is Prim's algorithm).
+     * ------------------------------------------------------------------ */
+    JBGrowingTreeGenerator( int newest = 50 ) { m_newest = newest; }
+
+    virtual void generate( JBMaze* maze );
+    virtual const char* getName() { return "growingtree"; }
+
+  private:
+    int m_newest;
+};
+
+
+class JBKruskalGenerator : public JBMazeGenerator {
+  public:
+    virtual void generate( JBMaze* maze );
+    virtual const char* getName() { return "kruskal"; }
+
+  private:
+    long m_find( long* parent, long cell );
+};
+
+
+class JBWilsonGenerator : public JBMazeGenerator {
+  public:
+    virtual void generate( JBMaze* maze );
+    virtual const char* getName() { return "wilson"; }
+};
+
+
+class JBTiledGenerator : public JBMazeGenerator {
+  public:
+
+    /* ------------------------------------------------------------------ *
+     * JBTiledGenerator( int tileSize, int threads )
+     *
+     * tileSize is the width and height of each tile, in cells (each tile
+     * spans every level of the maze).  threads is the number of threads
+     * to carve the tiles with, or 0 for one per processor.  A given seed
+     * and tile size give the same maze no matter how many threads there
+     * are, except that a maze drawing from rand() (see
+     * JBMaze::c_COMPAT_RANDOM) is always carved on one thread.
+     * ------------------------------------------------------------------ */
+    JBTiledGenerator( int tileSize = 64, int threads = 0 );
+
+    virtual void generate( JBMaze* maze );
+    virtual const char* getName() { return "tiled"; }
+
+    int  getTileSize() { return m_tileSize; }
+    int  getThreads() { return m_threads; }
+
+  protected:
+
+    virtual void m_runTask( long tile, int worker );
+
+  private:
+
+    static const unsigned int c_UNCARVED;   /* m_component of an uncarved cell */
+
+    int  m_tileDirections( long cell, int x, int y, int z,
+                           int left, int top, int right, int bottom );
+    long m_find( long* parent, long component );
+
+    int m_tileSize;
+    int m_threads;
+
+    /* shared with the threads during generate() */
+
+    JBMaze*        m_maze;
+    JBRandom       m_random;          /* each tile splits its own stream */
+    unsigned int*  m_component;       /* each cell's component in its tile */
+    unsigned int*  m_componentCount;  /* the components in each tile */
+    long*          m_stacks;          /* one backtracking stack per thread */
+    long           m_tilesX;
+};
+
+
+class JBLayeredGenerator : public JBMazeGenerator {
+  public:
+
+    /* ------------------------------------------------------------------ *
+     * JBLayeredGenerator( int links, int threads )
+     *
+     * links is the number of stairways (c_DOWN exits) carved from each
+     * level to the one below it, in each region of the mask.  With one,
+     * the levels form a spanning tree and the maze is perfect; each extra
+     * stairway adds a loop.  threads is the number of threads to carve
+     * the levels with, or 0 for one per processor.  As with
+     * JBTiledGenerator, the maze does not depend on the number of threads.
+     * ------------------------------------------------------------------ */
+    JBLayeredGenerator( int links = 1, int threads = 0 );
+    virtual ~JBLayeredGenerator();
+
+    virtual void generate( JBMaze* maze );
+    virtual const char* getName() { return "layered"; }
+
+    int  getLinks() { return m_links; }
+    int  getThreads() { return m_threads; }
+
+    /* ------------------------------------------------------------------ *
+     * Returns the seconds the last call to generate() spent carving level
+     * z, and the number of stairways it carved from level z to level z+1.
+     * ------------------------------------------------------------------ */
+    double getLevelTime( int z );
+    long   getLevelLinks( int z );
+
+  protected:
+
+    virtual void m_runTask( long level, int worker );
+
+  private:
+
+    int  m_levelDirections( long cell, int x, int y );
+    void m_link();
+
+    int m_links;
+    int m_threads;
+
+    JBMaze*   m_maze;
+    JBRandom  m_random;               /* each level splits its own stream */
+    long*     m_stacks;               /* one backtracking stack per thread */
+
+    int       m_levels;
+    double*   m_levelTimes;           /* by level, from the last generate() */
+    long*     m_levelLinks;
+};
+
+
+class JBStreamGenerator : public JBMazeGenerator {
+  public:
+
+    /* ------------------------------------------------------------------ *
+     * The number of bytes of cells written before they are released (see
+     * JBMazeStorage::release()), when the maze is mapped.
+     * ------------------------------------------------------------------ */
+    static const long c_BAND_SIZE;
+
+  public:
+
+    virtual void generate( JBMaze* maze );
+    virtual const char* getName() { return "stream"; }
+};
+
+#endif /* __JBMAZEGENERATOR_H__ */
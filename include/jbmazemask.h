@@ -10,12 +10,45 @@
  * JBMazeMask represents a two-dimensional mask that may be applied to a
  * maze object (see JBMaze).  The mask then determines what areas of the
  * map are valid for generating the maze.
+ *
+ * The mask is kept a row at a time, one bit per point, in 64-bit words
+ * (each row starts a new word), so that the callers that go along rows
+ * -- counting valid points, or testing a rectangle for a room -- may do
+ * so 64 points at a time.
+ *
+ * The first query that needs it also builds an index of the runs of
+ * valid points (in row order, a run going on from the end of one row to
+ * the start of the next), with the number of valid points before each, so
+ * that a mask that is mostly empty, or mostly full, may be counted and
+ * sampled in time that depends on its runs rather than its area.  Setting
+ * a point discards the index.
+ *
+ * A mask is reference counted, so that the mazes, dungeons, snapshots and
+ * streams that use the same mask may share one copy of it rather than
+ * each making its own: whoever creates a mask holds the first reference,
+ * retain() adds one, and release() gives one up (deleting the mask with
+ * the last).  Whatever is given a mask (JBMaze::setMask(), for instance)
+ * takes over the caller's reference, so a mask that is only handed on
+ * costs nothing, and one that the caller wants to go on using is retained
+ * first.  A mask must not be changed once it is shared; load() shares the
+ * masks it reads from files, by path, across the whole process.
  * ---------------------------------------------------------------------- */
 
 #ifndef __JBMAZEMASK_H__
 #define __JBMAZEMASK_H__
 
+#include <stdint.h>
+#include <stdio.h>
+
 class JBMazeMask {
+  public:
+
+    /* ------------------------------------------------------------------ *
+     * The most files load() keeps loaded (the least recently loaded is
+     * let go first).
+     * ------------------------------------------------------------------ */
+    static const int c_MAX_LOADED;
+
   public:
 
     /* ------------------------------------------------------------------ *
@@ -27,31 +60,83 @@ class JBMazeMask {
     JBMazeMask( int width, int height );
 
     /* ------------------------------------------------------------------ *
-     * JBMazeMask( char* filename )
+     * JBMazeMask( const char* filename, int threshold = 128 )
      *
      * Creates a new JBMazeMask object from the data in the indicated
-     * file.  The first line of the file must be the width and the height
+     * file, which may be text, a PBM image, or a PNG image (told apart by
+     * how the file begins).
+     *
+     * In text, the first line of the file must be the width and the height
      * of the mask (comma delimited).  Subsequent lines represent the rows
      * in the mask, where each character in the line must be a '0' or a '1'
      * and represents whether the mask at that point is 'on' (1) or 'off 
      * (0).
+     *
+     * In a PBM (plain or raw), a black point (1) is 'on', as in text.  In
+     * a PNG, a point is 'on' if it is darker than the threshold (0-255)
+     * and not transparent, or, in a palette image, if its index is not 0.
+     *
+     * Each row is decoded straight into the mask, so no more than a row
+     * of the image is ever held apart from it.  A file that cannot be
+     * read gives an empty (0 by 0) mask.
      * ------------------------------------------------------------------ */
-    JBMazeMask( char* filename );
+    JBMazeMask( const char* filename, int threshold = 128 );
 
     /* ------------------------------------------------------------------ *
      * JBMazeMask( JBMazeMask& master )
      *
      * Copy constructor -- creates a new JBMazeMask that is an exact
-     * duplicate of the indicated mask object.
+     * duplicate of the indicated mask object (and that, unlike it, may be
+     * changed).
      * ------------------------------------------------------------------ */
     JBMazeMask( JBMazeMask& master );
 
     /* ------------------------------------------------------------------ *
-     * ~JBMazeMask()
+     * static JBMazeMask* load( const char* filename, int threshold = 128 )
      *
-     * Destroys the mask object and deallocates any resources it used.
+     * Returns a reference to the mask in the indicated file (read as the
+     * constructor, above, reads it), which the caller must release().
+     * The mask is shared with every other caller that loads the same file
+     * with the same threshold, for as long as the file has not been
+     * changed since (by its modification time and size), so that loading
+     * it again costs neither the time to read it nor the memory to hold
+     * it.  A file that cannot be read gives an empty mask of its own.
+     * Safe to call from any thread.
      * ------------------------------------------------------------------ */
-    virtual ~JBMazeMask();
+    static JBMazeMask* load( const char* filename, int threshold = 128 );
+
+    /* ------------------------------------------------------------------ *
+     * static void unloadAll()
+     *
+     * Lets go of every mask load() has kept.  Masks still referenced
+     * elsewhere live on until they are released.
+     * ------------------------------------------------------------------ */
+    static void unloadAll();
+
+    /* ------------------------------------------------------------------ *
+     * JBMazeMask* retain()
+     * void release()
+     *
+     * Adds a reference to the mask (and returns the mask), or gives one
+     * up, deleting the mask if it was the last.  Safe to call from any
+     * thread.
+     * ------------------------------------------------------------------ */
+    JBMazeMask* retain() {
+      __sync_add_and_fetch( &m_references, 1 );
+      return this;
+    }
+    void release() {
+      if( __sync_sub_and_fetch( &m_references, 1 ) == 0 ) {
+        delete this;
+      }
+    }
+
+    /* ------------------------------------------------------------------ *
+     * int isShared()
+     *
+     * Returns non-zero if anyone else holds a reference to the mask.
+     * ------------------------------------------------------------------ */
+    int isShared() { return ( m_references > 1 ); }
 
     /* ------------------------------------------------------------------ *
      * int getWidth()
@@ -74,14 +159,147 @@ class JBMazeMask {
      * that the mask is "valid" at that point (ie, the maze may be drawn
      * there).  A 0 means that the maze must consider this point a wall.
      * ------------------------------------------------------------------ */
-    int getMaskAt( int x, int y ) { return m_mask[ x ][ y ]; }
+    int getMaskAt( int x, int y ) {
+      return (int)( ( m_bits[ (long)y * m_stride + ( x >> 6 ) ] >> ( x & 63 ) ) & 1 );
+    }
+
+    /* ------------------------------------------------------------------ *
+     * void setMaskAt( int x, int y, int valid )
+     *
+     * Makes the mask valid (non-zero) or not (0) at the indicated point.
+     * Points outside the mask are ignored, as is a mask that is shared.
+     * ------------------------------------------------------------------ */
+    void setMaskAt( int x, int y, int valid );
+
+    /* ------------------------------------------------------------------ *
+     * long countRow( int y, int x0, int x1 )
+     *
+     * Returns the number of valid points in row y, from x0 up to (but not
+     * including) x1.  The part of the span outside the mask counts as
+     * invalid.
+     * ------------------------------------------------------------------ */
+    long countRow( int y, int x0, int x1 );
+
+    /* ------------------------------------------------------------------ *
+     * long countValid()
+     * long countValid( int width, int height )
+     *
+     * Returns the number of valid points in the mask, or in the given
+     * number of columns and rows of it (from the top left), as a maze of
+     * that size would see it.
+     * ------------------------------------------------------------------ */
+    long countValid() { return countValid( m_width, m_height ); }
+    long countValid( int width, int height );
+
+    /* ------------------------------------------------------------------ *
+     * int isValid( int x, int y, int width, int height )
+     *
+     * Returns 1 if the mask is valid at every point of the given
+     * rectangle, and 0 if it is not (or if any of it lies outside the
+     * mask).
+     * ------------------------------------------------------------------ */
+    int isValid( int x, int y, int width, int height );
+
+    /* ------------------------------------------------------------------ *
+     * int findNext( int* x, int* y )
+     *
+     * Moves (x,y) to the first valid point at or after it, going along
+     * each row and then down to the next, and returns 1; or returns 0 (and
+     * leaves the point alone) if there is none.
+     * ------------------------------------------------------------------ */
+    int findNext( int* x, int* y );
+
+    /* ------------------------------------------------------------------ *
+     * long getRunCount()
+     *
+     * Returns the number of runs of valid points in the mask.
+     * ------------------------------------------------------------------ */
+    long getRunCount();
+
+    /* ------------------------------------------------------------------ *
+     * int getValidPoint( long i, int* x, int* y )
+     *
+     * Sets (x,y) to the i'th valid point of the mask (from 0, in row
+     * order), and returns 1; or returns 0 if there are not that many.
+     * Given a random i below countValid(), the point is a random valid
+     * point, each as likely as any other.
+     * ------------------------------------------------------------------ */
+    int getValidPoint( long i, int* x, int* y );
+
+    /* ------------------------------------------------------------------ *
+     * long getMemoryUsage()
+     *
+     * Returns the number of bytes the mask's points (and its index of
+     * runs, if it has been built) take.
+     * ------------------------------------------------------------------ */
+    long getMemoryUsage() {
+      return (long)m_height * m_stride * sizeof( uint64_t ) +
+             ( m_runsValid ? ( 2 * m_runCount + 1 ) * sizeof( long ) : 0 );
+    }
+
+  protected:
+
+    /* ------------------------------------------------------------------ *
+     * ~JBMazeMask()
+     *
+     * Destroys the mask object and deallocates any resources it used.
+     * Use release(), rather than delete.
+     * ------------------------------------------------------------------ */
+    virtual ~JBMazeMask();
 
   private:
 
+    friend class JBMazeMaskGenerator;
+
+    void m_allocate( int width, int height, int valid );
+    void m_deallocate();
+
+    /* ------------------------------------------------------------------ *
+     * Builds the index of runs, if it has not been, and returns the run
+     * holding (or the first run after) the point at the given offset (y
+     * times the width, plus x), or m_runCount if there is none.
+     * ------------------------------------------------------------------ */
+    void m_buildRuns();
+    void m_discardRuns();
+    long m_findRun( long offset );
+
+    /* ------------------------------------------------------------------ *
+     * The loaders, each reading the rest of a file whose beginning has
+     * already been read (and recognized), and returning 0 if it could not
+     * be read.
+     * ------------------------------------------------------------------ */
+    int  m_readText( FILE* file );
+    int  m_readPBM( FILE* file, int raw );
+    int  m_readPNG( FILE* file, int threshold );
+
+    /* ------------------------------------------------------------------ *
+     * Sets row y of the mask from one byte per point (0 or 1),
+     * or from eight points per byte, the first in the high bit (as PBM and
+     * PNG pack them), inverted if invert is non-zero.
+     * ------------------------------------------------------------------ */
+    void m_setRow( int y, const unsigned char* points );
+    void m_setRowBits( int y, const unsigned char* bits, int invert );
+
+    /* ------------------------------------------------------------------ *
+     * Returns the bits of the given word (of m_stride, in a row) that
+     * fall between x0 and x1, as a mask of the word.
+     * ------------------------------------------------------------------ */
+    static uint64_t m_span( int word, int x0, int x1 );
+
+    int    m_references;    /* see retain() and release() */
+
     int    m_width;
     int    m_height;
+    int    m_stride;        /* words per row */
+
+    uint64_t* m_bits;       /* the points, row by row; bit x%64 of word x/64 */
+
+    /* the index of runs (see above) */
 
-    char** m_mask;
+    int    m_runsValid;     /* whether the index has been built (set last) */
+    long   m_runCount;
+    long*  m_runStart;      /* the offset (y*width+x) of the first point of each */
+    long*  m_runBefore;     /* the valid points before each (and, last, in all) */
 };
 
 #endif /* __JBMAZEMASK_H__ */
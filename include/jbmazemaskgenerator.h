@@ -0,0 +1,144 @@
+/* ---------------------------------------------------------------------- *
+ * This file is in the public domain, and may be used, modified, and
+ * distributed without restriction.
+ * ---------------------------------------------------------------------- *
+ * JBMazeMaskGenerator
+ *
+ * Author: Jamis Buck <jamis@jamisbuck.org>
+ * Homepage: http://github.com/jamis/dnd-dungeon
+ *
+ * JBMazeMaskGenerator makes a JBMazeMask from a seed, rather than from a
+ * file, so that a maze may take an organic shape without anyone having to
+ * draw it.  A mask is made in four steps:
+ *
+ *   1. value noise: a random value at each point of a lattice, blended
+ *      smoothly between them, at several octaves (each with lattice cells
+ *      half the size, and half the weight, of the one before);
+ *   2. radial falloff: a penalty that grows with the square of the
+ *      distance from the middle of the mask, so that the shape stays
+ *      clear of the edges;
+ *   3. a threshold: the points whose value is above it are valid;
+ *   4. smoothing: passes of a cellular automaton that makes each point
+ *      valid if, and only if, five or more of the nine points around it
+ *      (itself included) are, which rounds off the ragged edges and fills
+ *      in (or clears out) specks.
+ *
+ * The presets (see the constants, below) choose all of these; the setters
+ * change one of them afterward.
+ *
+ * The noise is evaluated a row at a time, and a lattice cell at a time
+ * within each row, so that the inner loops run over contiguous floats
+ * with nothing but constants besides (which the compiler turns into SIMD
+ * code); the lattice itself is hashed only once per lattice point, not
+ * once per point of the mask.  The smoothing works on the mask's packed
+ * words, 64 points at a time, counting the neighbors with bitwise adders.
+ * ---------------------------------------------------------------------- */
+
+#ifndef __JBMAZEMASKGENERATOR_H__
+#define __JBMAZEMASKGENERATOR_H__
+
+#include <stdint.h>
+
+#include "jbmazemask.h"
+
+
+class JBMazeMaskGenerator {
+  public:
+
+    /* ------------------------------------------------------------------ *
+     * The presets.
+     *
+     *   c_NOISE: plain noise, with no falloff -- an irregular maze with
+     *     holes all through it.
+     *   c_BLOBS: a few broad, rounded shapes near the middle.
+     *   c_ISLAND: a single shape with a ragged coast.
+     *   c_CAVERNS: white noise smoothed into winding caverns, in the
+     *     manner of the classic cave-generating automaton.
+     * ------------------------------------------------------------------ */
+    static const int c_NOISE;
+    static const int c_BLOBS;
+    static const int c_ISLAND;
+    static const int c_CAVERNS;
+
+    /* ------------------------------------------------------------------ *
+     * The most octaves of noise a mask may have.
+     * ------------------------------------------------------------------ */
+    static const int c_MAX_OCTAVES;
+
+  public:
+
+    /* ------------------------------------------------------------------ *
+     * JBMazeMaskGenerator( int preset = c_BLOBS )
+     *
+     * Creates a generator with the settings of the given preset.
+     * ------------------------------------------------------------------ */
+    JBMazeMaskGenerator( int preset = c_BLOBS );
+
+    /* ------------------------------------------------------------------ *
+     * void setPreset( int preset )
+     *
+     * Replaces every setting with those of the given preset.
+     * ------------------------------------------------------------------ */
+    void setPreset( int preset );
+
+    /* ------------------------------------------------------------------ *
+     * The settings.
+     *
+     *   features: the number of lattice cells of the first octave across
+     *     the narrower side of the mask (so the number of broad features).
+     *   octaves: the number of octaves of noise (1 to c_MAX_OCTAVES);
+     *     fewer are used if the lattice cells would be smaller than a
+     *     point.
+     *   threshold: the value (0 to 1) a point must be above to be valid.
+     *   falloff: the penalty at the edge of the mask (0 for none).
+     *   smoothing: the number of passes of the automaton.
+     * ------------------------------------------------------------------ */
+    void setFeatures( int features ) { m_features = ( features < 1 ? 1 : features ); }
+    void setOctaves( int octaves );
+    void setThreshold( float threshold ) { m_threshold = threshold; }
+    void setFalloff( float falloff ) { m_falloff = falloff; }
+    void setSmoothing( int passes ) { m_smoothing = ( passes < 0 ? 0 : passes ); }
+
+    /* ------------------------------------------------------------------ *
+     * JBMazeMask* generate( int width, int height, long seed )
+     *
+     * Returns a new mask (which the caller must release()) of the given
+     * size, made from the given seed.  The same settings and seed always
+     * give the same mask.  A mask that would have no valid points at all is
+     * given one, in the middle, so that a maze may always be made in it.
+     * ------------------------------------------------------------------ */
+    JBMazeMask* generate( int width, int height, long seed );
+
+    /* ------------------------------------------------------------------ *
+     * static int findPreset( const char* name )
+     *
+     * Returns the preset constant with the given name ("noise", "blobs",
+     * "island", or "caverns"), or -1 if there is no such preset.
+     * ------------------------------------------------------------------ */
+    static int findPreset( const char* name );
+
+    /* ------------------------------------------------------------------ *
+     * static JBMazeMask* create( const char* spec, int width, int height,
+     *                            long seed )
+     *
+     * Returns a new mask made from a preset given as "name" or
+     * "name,seed" (the seed, if not given, is the one passed in), or 0 if
+     * there is no such preset.
+     * ------------------------------------------------------------------ */
+    static JBMazeMask* create( const char* spec, int width, int height, long seed );
+
+  private:
+
+    /* ------------------------------------------------------------------ *
+     * Runs one pass of the automaton over the mask.
+     * ------------------------------------------------------------------ */
+    static void m_smooth( JBMazeMask* mask );
+
+    int   m_features;
+    int   m_octaves;
+    float m_threshold;
+    float m_falloff;
+    int   m_smoothing;
+};
+
+#endif /* __JBMAZEMASKGENERATOR_H__ */
@@ -0,0 +1,126 @@
+/* ---------------------------------------------------------------------- *
+ * This file is in the public domain, and may be used, modified, and
+ * distributed without restriction.
+ * ---------------------------------------------------------------------- *
+ * JBMazePath
+ *
+ * Author: Jamis Buck <jamis@jamisbuck.org>
+ * Homepage: http://github.com/jamis/dnd-dungeon
+ *
+ * JBMazePath holds a path through a maze (a solution, usually) as its
+ * first point and the direction of each step after it.  A direction is
+ * one of six, so it fits in three bits, and twenty-one of them are packed
+ * into each 64-bit word: a path of a million points takes about 380KB,
+ * where an array of JBMazePt would take 12MB.
+ *
+ * The point at a given step is found by walking from the nearest of the
+ * points the path keeps every c_CHECKPOINT steps, or from the point last
+ * asked for, if that is nearer; so asking for the points in order costs
+ * one step apiece.  A JBMazePathIterator walks the path from end to end
+ * without any of that.
+ * ---------------------------------------------------------------------- */
+
+#ifndef __JBMAZEPATH_H__
+#define __JBMAZEPATH_H__
+
+#include <stdint.h>
+
+#include "jbmaze.h"
+
+
+class JBMazePath {
+  public:
+
+    /* ------------------------------------------------------------------ *
+     * The number of directions packed into each word, and the number of
+     * steps between the points the path keeps.
+     * ------------------------------------------------------------------ */
+    static const int c_CODES_PER_WORD;
+    static const int c_CHECKPOINT;
+
+  public:
+
+    JBMazePath();
+    ~JBMazePath();
+
+    /* ------------------------------------------------------------------ *
+     * Empties the path, and makes room for one that starts at the given
+     * point and is the given number of points long.  The directions are
+     * then given by setDirection(), in any order.
+     * ------------------------------------------------------------------ */
+    void clear();
+    void reset( const JBMazePt& start, long length );
+
+    /* ------------------------------------------------------------------ *
+     * Sets or returns the direction (one of JBMaze::c_NORTH through
+     * JBMaze::c_DOWN) of the step from point i to point i+1.
+     * ------------------------------------------------------------------ */
+    void setDirection( long i, int direction );
+    int  getDirection( long i ) {
+      return 1 << m_code( i );
+    }
+
+    /* ------------------------------------------------------------------ *
+     * Returns the number of points in the path, and the point at the
+     * given index (0 to getLength()-1).
+     * ------------------------------------------------------------------ */
+    long getLength() { return m_length; }
+    const JBMazePt& getStart() { return m_start; }
+    JBMazePt getStep( long i );
+
+    /* ------------------------------------------------------------------ *
+     * Returns the number of bytes the path takes.
+     * ------------------------------------------------------------------ */
+    long getMemoryUsage();
+
+  private:
+
+    friend class JBMazePathIterator;
+
+    int  m_code( long i ) {
+      return (int)( ( m_words[ i / c_CODES_PER_WORD ] >> ( 3 * ( i % c_CODES_PER_WORD ) ) ) & 0x7 );
+    }
+
+    static void m_move( int code, JBMazePt* pt );
+
+    void m_deallocate();
+    void m_buildCheckpoints();
+
+    JBMazePt  m_start;
+    long      m_length;         /* points, including the start */
+    uint64_t* m_words;          /* the directions, c_CODES_PER_WORD apiece */
+    JBMazePt* m_checkpoints;    /* the point at every c_CHECKPOINT steps */
+    int       m_checkpointsValid;
+
+    long      m_cursor;         /* the index of the point last returned */
+    JBMazePt  m_cursorPt;       /* and the point itself */
+};
+
+
+class JBMazePathIterator {
+  public:
+
+    /* ------------------------------------------------------------------ *
+     * JBMazePathIterator( JBMazePath* path )
+     *
+     * Starts at the first point of the path.  next() moves to the next
+     * point, until isDone(); the path must not change in the meantime.
+     * ------------------------------------------------------------------ */
+    JBMazePathIterator( JBMazePath* path );
+
+    int  isDone() { return ( m_index >= m_path->m_length ); }
+    long getIndex() { return m_index; }
+    const JBMazePt& getPoint() { return m_pt; }
+    int  getDirection() { return 1 << ( m_word & 0x7 ); }
+
+    void next();
+
+  private:
+
+    JBMazePath* m_path;
+    long      m_index;
+    JBMazePt  m_pt;
+    uint64_t  m_word;           /* the directions left in the current word */
+};
+
+#endif /* __JBMAZEPATH_H__ */
@@ -0,0 +1,105 @@
+/* ---------------------------------------------------------------------- *
+ * This file is in the public domain, and may be used, modified, and
+ * distributed without restriction.
+ * ---------------------------------------------------------------------- *
+ * JBMazePlanes
+ *
+ * Author: Jamis Buck <jamis@jamisbuck.org>
+ * Homepage: http://github.com/jamis/dnd-dungeon
+ *
+ * JBMazePlanes holds the exits of a maze as bitplanes: one bitset per
+ * direction, with a row of 64-bit words for each row of the maze (x
+ * varying fastest, then y, then z, exactly as JBMaze stores its cells).
+ * Bit b of word w of a row is set in plane i if the cell at x = 64*w + b
+ * has an exit in direction i (that is, the exit bit 1 << i).
+ *
+ * The planes are a mirror of the packed cells, rebuilt by mirror(), and
+ * let whole-maze questions -- like which cells are deadends -- be answered
+ * 64 cells at a time, without a branch per cell.
+ * ---------------------------------------------------------------------- */
+
+#ifndef __JBMAZEPLANES_H__
+#define __JBMAZEPLANES_H__
+
+#include <stdint.h>
+
+
+class JBMazePlanes {
+  public:
+
+    /* ------------------------------------------------------------------ *
+     * The number of planes (one per direction).
+     * ------------------------------------------------------------------ */
+    enum { c_PLANES = 6 };
+
+  public:
+
+    JBMazePlanes( int x, int y, int z );
+    ~JBMazePlanes();
+
+    /* ------------------------------------------------------------------ *
+     * Rebuilds the planes from the given packed cells (one byte of exits
+     * per cell, as JBMaze::getCells() returns them).
+     * ------------------------------------------------------------------ */
+    void mirror( const unsigned char* cells );
+
+    /* ------------------------------------------------------------------ *
+     * The number of rows (y * z), and of words in each row.
+     * ------------------------------------------------------------------ */
+    long getRowCount() { return m_rows; }
+    int  getWordsPerRow() { return m_wordsPerRow; }
+
+    /* ------------------------------------------------------------------ *
+     * Returns the given word of the given row of plane i.
+     * ------------------------------------------------------------------ */
+    uint64_t getWord( int i, long row, int word ) {
+      return m_words[ ( i * m_rows + row ) * m_wordsPerRow + word ];
+    }
+
+    /* ------------------------------------------------------------------ *
+     * Returns the deadends (cells with exactly one exit) among the 64
+     * cells of the given word of the given row, as a bitset.
+     * ------------------------------------------------------------------ */
+    uint64_t getDeadends( long row, int word ) {
+      const uint64_t* plane;
+      uint64_t one;
+      uint64_t two;
+      uint64_t bits;
+      long     stride;
+      int      i;
+
+      /* a cell has seen one exit if any plane so far has it set, and two
+       * if a plane has it set after it had already seen one */
+
+      stride = m_rows * m_wordsPerRow;
+      plane = m_words + row * m_wordsPerRow + word;
+      one = two = 0;
+
+      for( i = 0; i < c_PLANES; i++, plane += stride ) {
+        bits = *plane;
+        two |= one & bits;
+        one |= bits;
+      }
+
+      return one & ~two;
+    }
+
+    /* ------------------------------------------------------------------ *
+     * Returns the number of deadends in the whole maze.
+     * ------------------------------------------------------------------ */
+    long countDeadends();
+
+    /* ------------------------------------------------------------------ *
+     * Returns the number of bytes the planes occupy.
+     * ------------------------------------------------------------------ */
+    long getMemoryUsage() { return c_PLANES * m_rows * m_wordsPerRow * (long)sizeof( uint64_t ); }
+
+  private:
+
+    int       m_x;             /* x-dimension of the maze */
+    long      m_rows;          /* y * z */
+    int       m_wordsPerRow;   /* words per row of each plane */
+    uint64_t* m_words;         /* the planes, one after another */
+};
+
+#endif /* __JBMAZEPLANES_H__ */
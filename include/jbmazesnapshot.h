@@ -0,0 +1,89 @@
+/* ---------------------------------------------------------------------- *
+ * This file is in the public domain, and may be used, modified, and
+ * distributed without restriction.
+ * ---------------------------------------------------------------------- *
+ * JBMazeSnapshot
+ *
+ * Author: Jamis Buck <jamis@jamisbuck.org>
+ * Homepage: http://github.com/jamis/dnd-dungeon
+ *
+ * JBMazeSnapshot freezes a maze (usually just after generate()), so that
+ * any number of variants of it -- sparsified or not, with more deadends
+ * cleared or fewer -- may be branched from it without generating it
+ * again.  The cells are copied once, into a file in memory, and each
+ * branch maps that file copy-on-write (see JBMazeStorage): a branch holds
+ * only the pages (4KB of cells apiece) that it has written to, and shares
+ * the rest with the snapshot and every other branch.
+ *
+ * A branch is an ordinary JBMaze, with the dimensions, start and end,
+ * seed, random stream, and flags of the maze the snapshot was taken of,
+ * so whatever it does next gives exactly what the original maze would
+ * have (unless it draws from the C library's rand() -- see
+ * JBMaze::c_COMPAT_RANDOM -- which no snapshot can hold).  It shares the
+ * mask of the maze the snapshot was taken of (see JBMazeMask::retain()),
+ * as the snapshot itself does, so a branch may outlive the snapshot.
+ *
+ * Only the pages a branch writes cost it memory.  sparsify() and
+ * clearDeadends() write to deadends all over the maze, so a branch that
+ * runs them ends up with most pages of its own anyway (and clearDeadends()
+ * needs its scratch space, too); what is saved is generating the maze
+ * again.
+ * ---------------------------------------------------------------------- */
+
+#ifndef __JBMAZESNAPSHOT_H__
+#define __JBMAZESNAPSHOT_H__
+
+#include "jbmaze.h"
+
+
+class JBMazeSnapshot {
+  public:
+
+    /* ------------------------------------------------------------------ *
+     * JBMazeSnapshot( JBMaze* maze )
+     *
+     * Takes a snapshot of the maze as it is now.  The maze itself is not
+     * changed, and may go on (or be destroyed) independently.
+     * ------------------------------------------------------------------ */
+    JBMazeSnapshot( JBMaze* maze );
+    ~JBMazeSnapshot();
+
+    /* ------------------------------------------------------------------ *
+     * Returns a new maze (which the caller must delete) that starts out
+     * exactly as the maze was when the snapshot was taken.  If the cells
+     * could not be shared, the branch gets a copy of its own.
+     * ------------------------------------------------------------------ */
+    JBMaze* branch();
+
+    /* ------------------------------------------------------------------ *
+     * Returns the number of bytes of cells the snapshot holds (and its
+     * branches share), and whether they are shared at all.
+     * ------------------------------------------------------------------ */
+    long getSize() { return m_size; }
+    int  isShared() { return ( m_fd >= 0 ); }
+
+  private:
+
+    int    m_fd;              /* the file holding the cells, or -1 */
+    unsigned char* m_cells;   /* the cells themselves, if m_fd is -1 */
+    long   m_size;            /* bytes of cells */
+
+    /* the maze, as it was */
+
+    int    m_x;
+    int    m_y;
+    int    m_z;
+    JBMazePt m_start;
+    JBMazePt m_end;
+    long   m_seed;
+    int    m_randomness;
+    int    m_compatibility;
+    int    m_generic;
+    int    m_connectorRadius;
+    int    m_advice;
+    int    m_algorithm;
+    JBRandom m_random;
+    JBMazeMask* m_mask;
+};
+
+#endif /* __JBMAZESNAPSHOT_H__ */
@@ -0,0 +1,126 @@
+/* ---------------------------------------------------------------------- *
+ * This file is in the public domain, and may be used, modified, and
+ * distributed without restriction.
+ * ---------------------------------------------------------------------- *
+ * JBMazeStorage
+ *
+ * Author: Jamis Buck <jamis@jamisbuck.org>
+ * Homepage: http://github.com/jamis/dnd-dungeon
+ *
+ * JBMazeStorage is a zeroed block of memory for a grid of cells.  Without
+ * a path, it is ordinary memory, aligned to a cache line (or, if it is at
+ * least c_ANONYMOUS_SIZE bytes, to a page, so that its pages are only
+ * allocated as they are touched).  With a path,
+ * the block is mapped from that file (which is created, or truncated and
+ * then grown to the size of the block), so that the grid may be larger
+ * than physical memory: the kernel pages cells in from the file as they
+ * are touched, and writes them back when it needs the memory.
+ *
+ * A block may also be a private, copy-on-write view of a shared file (see
+ * share()): it starts out as the file's own pages, and a page of its own
+ * is made only the first time a cell in that page is written.  This lets
+ * many grids branch from one (see JBMazeSnapshot) for the memory of the
+ * pages each of them changes.
+ *
+ * A mapped grid is only as fast as its access pattern.  Code that walks
+ * the grid in order should say so with advise() (see the c_XXXX advice,
+ * below), and release() the parts it is done with, so that the pages it
+ * holds stay bounded no matter how large the grid is.  Both do nothing
+ * to a block that is not mapped.
+ * ---------------------------------------------------------------------- */
+
+#ifndef __JBMAZESTORAGE_H__
+#define __JBMAZESTORAGE_H__
+
+
+class JBMazeStorage {
+  public:
+
+    /* ------------------------------------------------------------------ *
+     * Hints for advise() (see madvise(2)):
+     *
+     *   c_NORMAL: no particular order.
+     *   c_SEQUENTIAL: the range will be read in order, so read ahead
+     *     aggressively and drop pages soon after they are used.
+     *   c_RANDOM: the range will be read in no order, so do not read
+     *     ahead.
+     *   c_WILLNEED: the range will be needed soon, so start reading it.
+     * ------------------------------------------------------------------ */
+    static const int c_NORMAL;
+    static const int c_SEQUENTIAL;
+    static const int c_RANDOM;
+    static const int c_WILLNEED;
+
+    static const int  c_ALIGNMENT;       /* of a small block that is not mapped */
+    static const long c_ANONYMOUS_SIZE;  /* the smallest block mapped anonymously */
+
+  public:
+
+    /* ------------------------------------------------------------------ *
+     * JBMazeStorage( const char* path, long size, int temporary )
+     *
+     * Allocates a zeroed block of the given size, mapped from the given
+     * file (if path is not NULL).  A temporary file is removed as soon as
+     * it is mapped, so it never outlives the block.  If the block cannot
+     * be allocated, getBlock() returns NULL.
+     * ------------------------------------------------------------------ */
+    JBMazeStorage( const char* path, long size, int temporary = 0 );
+
+    ~JBMazeStorage();
+
+    void* getBlock() { return m_block; }
+    long  getSize() { return m_size; }
+    int   isMapped() { return m_mapped; }
+    int   isPrivate() { return m_private; }
+
+    /* ------------------------------------------------------------------ *
+     * static JBMazeStorage* view( int fd, long size )
+     *
+     * Maps the first size bytes of the file open on fd (usually one made
+     * by share()) as a private, copy-on-write block.  Writes to the block
+     * never reach the file, and the file must not change while the block
+     * is mapped.  Returns NULL if the block cannot be mapped.
+     * ------------------------------------------------------------------ */
+    static JBMazeStorage* view( int fd, long size );
+
+    /* ------------------------------------------------------------------ *
+     * Returns a file descriptor (which the caller must close()) of a file
+     * in memory that holds a copy of the given bytes, to be mapped by the
+     * constructor above, or -1 if no such file could be made.
+     * ------------------------------------------------------------------ */
+    static int share( const void* data, long size );
+
+    /* ------------------------------------------------------------------ *
+     * Tells the kernel how the given range of the block (a byte offset
+     * and length; a negative length means the rest of the block) will be
+     * used next.
+     * ------------------------------------------------------------------ */
+    void advise( int advice, long offset = 0, long length = -1 );
+
+    /* ------------------------------------------------------------------ *
+     * Starts writing the given range back to the file, and lets go of its
+     * pages.  The contents are kept: touching the range again reads it
+     * back in.
+     * ------------------------------------------------------------------ */
+    void release( long offset = 0, long length = -1 );
+
+    /* ------------------------------------------------------------------ *
+     * Writes the whole block back to its file, and waits until it is
+     * done.
+     * ------------------------------------------------------------------ */
+    void flush();
+
+  private:
+
+    JBMazeStorage();
+
+    int  m_range( long* offset, long* length );
+
+    void* m_block;
+    long  m_size;
+    int   m_mapped;       /* mapped from a file */
+    int   m_anonymous;    /* mapped from no file (see c_ANONYMOUS_SIZE) */
+    int   m_private;      /* a copy-on-write view of a shared file */
+};
+
+#endif /* __JBMAZESTORAGE_H__ */
@@ -0,0 +1,273 @@
+/* ---------------------------------------------------------------------- *
+ * This file is in the public domain, and may be used, modified, and
+ * distributed without restriction.
+ * ---------------------------------------------------------------------- *
+ * JBMazeStream
+ *
+ * Author: Jamis Buck <jamis@jamisbuck.org>
+ * Homepage: http://github.com/jamis/dnd-dungeon
+ *
+ * JBMazeStream generates a two-dimensional maze one row at a time, using
+ * Eller's algorithm, and hands each row to a sink (see JBMazeRowSink) as
+ * soon as it is finished.  Only the current row is ever held in memory,
+ * so the height of the maze is limited only by the patience of the sink.
+ * The algorithm is as follows:
+ *
+ *   (1) put every cell of the row that is not already in a set into a
+ *       set of its own.
+ *   (2) randomly join adjacent cells that are in different sets, merging
+ *       the sets.
+ *   (3) for every set, randomly choose at least one cell to connect to
+ *       the cell below it, which then belongs to the same set.
+ *   (4) emit the row, move down, and repeat from (1).  On the last row,
+ *       join every pair of adjacent cells that are in different sets.
+ *
+ * With a mask, (3) is followed by the joins that keep each region of the
+ * mask in one piece (see setMask()).
+ *
+ * Rows are given to the sink in the same form as JBMaze::getExitsAt(),
+ * one byte per cell.
+ * ---------------------------------------------------------------------- */
+
+#ifndef __JBMAZESTREAM_H__
+#define __JBMAZESTREAM_H__
+
+#include <stdio.h>
+
+#include "jbmaze.h"
+#include "jbmazemask.h"
+
+
+/* ---------------------------------------------------------------------- *
+ * JBMazeRowSink
+ *
+ * An abstract class that receives the rows of a JBMazeStream, in order
+ * from top to bottom.
+ * ---------------------------------------------------------------------- */
+class JBMazeRowSink {
+  public:
+
+    virtual ~JBMazeRowSink() { }
+
+    /* ------------------------------------------------------------------ *
+     * Called once before the first row, and once after the last.
+     * ------------------------------------------------------------------ */
+    virtual void begin( int width, long height ) { }
+    virtual void end() { }
+
+    /* ------------------------------------------------------------------ *
+     * Called with the exits of each cell of row y (see JBMaze::c_XXXX).
+     * The array is only valid until the call returns.
+     * ------------------------------------------------------------------ */
+    virtual void row( long y, const unsigned char* exits, int width ) = 0;
+};
+
+
+/* ---------------------------------------------------------------------- *
+ * JBMazeCallbackSink
+ *
+ * Passes each row to a function, along with a caller-supplied pointer.
+ * ---------------------------------------------------------------------- */
+typedef void (*JBMazeRowCallback)( long y, const unsigned char* exits, int width, void* userData );
+
+class JBMazeCallbackSink : public JBMazeRowSink {
+  public:
+
+    JBMazeCallbackSink( JBMazeRowCallback callback, void* userData ) {
+      m_callback = callback;
+      m_userData = userData;
+    }
+
+    virtual void row( long y, const unsigned char* exits, int width ) {
+      m_callback( y, exits, width, m_userData );
+    }
+
+  private:
+
+    JBMazeRowCallback m_callback;
+    void*             m_userData;
+};
+
+
+/* ---------------------------------------------------------------------- *
+ * JBMazeFileSink
+ *
+ * Writes the rows to a file, one byte per cell with no header, so the
+ * result can be read back with a single fread() per row.
+ * ---------------------------------------------------------------------- */
+class JBMazeFileSink : public JBMazeRowSink {
+  public:
+
+    JBMazeFileSink( FILE* file ) { m_file = file; }
+
+    virtual void row( long y, const unsigned char* exits, int width ) {
+      fwrite( exits, 1, width, m_file );
+    }
+
+    virtual void end() { fflush( m_file ); }
+
+  private:
+
+    FILE* m_file;
+};
+
+
+/* ---------------------------------------------------------------------- *
+ * JBMazePNGSink
+ *
+ * Draws the rows as a PNG image, encoding each row of pixels as soon as
+ * it is drawn.  The image looks like the one drawn by the console tool:
+ * each cell is pathWidth + wallWidth + 1 pixels square, and the maze is
+ * surrounded by a border of the background color.  Colors are given as
+ * 0xRRGGBB.
+ *
+ * A PNG may be no more than 2^31-1 pixels wide or tall.  If the image
+ * would be larger, or libpng fails while writing it, the sink prints an
+ * error, ignores the rest of the rows, and reports that it failed.
+ * ---------------------------------------------------------------------- */
+class JBMazePNGSink : public JBMazeRowSink {
+  public:
+
+    JBMazePNGSink( FILE* file, int pathWidth, int wallWidth, int border,
+                   long wallColor, long bgColor );
+    virtual ~JBMazePNGSink();
+
+    virtual void begin( int width, long height );
+    virtual void row( long y, const unsigned char* exits, int width );
+    virtual void end();
+
+    /* ------------------------------------------------------------------ *
+     * Returns non-zero if the image of a maze of the given size is small
+     * enough to be written, so that a caller may check before generating
+     * it.
+     * ------------------------------------------------------------------ */
+    int fits( int width, long height );
+
+    /* ------------------------------------------------------------------ *
+     * Returns non-zero if the image could not be written.
+     * ------------------------------------------------------------------ */
+    int hasFailed() { return m_failed; }
+
+  private:
+
+    void m_fill( int from, int to, long color );
+    void m_writeRows( int count );
+
+    FILE*          m_file;
+    void*          m_png;          /* png_structp */
+    void*          m_info;         /* png_infop */
+    unsigned char* m_pixels;       /* one row of RGB pixels */
+
+    int            m_imageWidth;
+    int            m_gridSize;
+    int            m_wallWidth;
+    int            m_border;
+    long           m_wallColor;
+    long           m_bgColor;
+    int            m_failed;
+};
+
+
+/* ---------------------------------------------------------------------- *
+ * JBMazeStream
+ * ---------------------------------------------------------------------- */
+class JBMazeStream {
+  public:
+
+    /* ------------------------------------------------------------------ *
+     * JBMazeStream( int width, long height, long seed, int randomness )
+     *
+     * Prepares a stream for a maze of the given dimensions.  As with
+     * JBMaze, the randomness (0-100) is how often passages bend: the
+     * lower it is, the longer the horizontal runs.
+     * ------------------------------------------------------------------ */
+    JBMazeStream( int width, long height, long seed = 0, int randomness = 100 );
+    ~JBMazeStream();
+
+    int  getWidth() { return m_width; }
+    long getHeight() { return m_height; }
+
+    /* ------------------------------------------------------------------ *
+     * Sets the mask to use, which also sets the width of the maze.  The
+     * stream takes over the caller's reference to the mask (see
+     * JBMazeMask::retain()).  Row y of the maze uses row
+     * (y % height) of the mask, so a short mask may be used to pattern a
+     * very tall maze.  Each region of the mask (the valid cells that are
+     * connected to each other, within the height of the maze) gets a
+     * single maze of its own.
+     *
+     * Eller's algorithm alone cannot promise that: two sets that do not
+     * join in a row may go down into parts of the region that never meet
+     * again.  So, before the first row, the stream works out (from the
+     * bottom up) which cells of each row are connected through the rows
+     * below it, and a set is made to join its neighbor, or to go down, in
+     * any row where it would otherwise be cut off from the rest of its
+     * region.  That takes an int for each run of valid cells in each row,
+     * up to the point where the rows begin to repeat (in a mask shorter
+     * than the maze, which is usually within a few heights of the mask).
+     * ------------------------------------------------------------------ */
+    void setMask( JBMazeMask* mask );
+    JBMazeMask* getMask() { return m_mask; }
+
+    /* ------------------------------------------------------------------ *
+     * Generates the maze, giving each row to the sink in turn.
+     * ------------------------------------------------------------------ */
+    void generate( JBMazeRowSink* sink );
+
+    /* ------------------------------------------------------------------ *
+     * Returns the number of bytes the last generate() held, apart from
+     * the mask.
+     * ------------------------------------------------------------------ */
+    long getMemoryUsage() { return m_memoryUsage; }
+
+  private:
+
+    int  m_find( int set );
+    int  m_newSet();
+
+    /* ------------------------------------------------------------------ *
+     * Labels the runs of valid cells of each row (after the first) by the
+     * region of the rows from there down that each belongs to, and
+     * returns the labels of row y (one for each run, in order; runs with
+     * the same label are connected below).
+     * ------------------------------------------------------------------ */
+    void m_findRegions();
+    void m_freeRegions();
+    const int* m_regionsOf( long y );
+    int  m_runsOf( long y, int* runs );
+
+    int  m_width;
+    long m_height;
+    long m_seed;
+    int  m_randomness;
+
+    JBRandom m_random;           /* restarted from m_seed by generate() */
+
+    JBMazeMask* m_mask;
+
+    /* per-row state; every array holds m_width entries */
+
+    unsigned char* m_exits;      /* the row being built */
+    int*  m_sets;                /* the set of each cell (-1 for none) */
+    int*  m_parent;              /* union-find parent of each set */
+    int*  m_free;                /* set ids that are not in use */
+    int   m_freeCount;
+    int*  m_candidates;          /* cells in each set that can go down */
+    unsigned char* m_down;       /* has the set gone down yet? */
+    unsigned char* m_used;       /* is the set id in use? */
+    int*  m_joined;              /* union-find over sets and the regions
+                                    below (2 * m_width entries) */
+
+    /* the labels of the regions below each row (see m_findRegions()) */
+
+    int*  m_labels;              /* every row's labels, bottom row first */
+    long  m_labelCount;
+    long  m_labelCapacity;
+    long* m_labelRows;           /* where each row's labels start, by
+                                    m_height - 1 - y */
+    long  m_labelBase;           /* rows above this repeat the ones below */
+
+    long  m_memoryUsage;
+};
+
+#endif /* __JBMAZESTREAM_H__ */
@@ -0,0 +1,148 @@
+/* ---------------------------------------------------------------------- *
+ * This file is in the public domain, and may be used, modified, and
+ * distributed without restriction.
+ * ---------------------------------------------------------------------- *
+ * JBRandom
+ *
+ * Author: Jamis Buck <jamis@jamisbuck.org>
+ * Homepage: http://github.com/jamis/dnd-dungeon
+ *
+ * JBRandom is a stream of random numbers that belongs to whoever owns it,
+ * rather than to the whole process (as rand() does).  Two mazes that each
+ * have their own stream may be generated at the same time, and a given
+ * seed gives the same maze on every platform.
+ *
+ * The numbers come from xoshiro256**, seeded by splitmix64.  Each phase of
+ * a generator (generating, clearing deadends, placing rooms, etc.) splits
+ * a sub-stream of its own from the root stream, by number, so that how
+ * many numbers one phase uses never changes the numbers another is given.
+ *
+ * A legacy stream (see c_LEGACY, below) simply calls rand(), so that the
+ * seeds of older versions still produce the same mazes.
+ * ---------------------------------------------------------------------- */
+
+#ifndef __JBRANDOM_H__
+#define __JBRANDOM_H__
+
+#include <stdlib.h>
+#include <stdint.h>
+
+
+class JBRandom {
+  public:
+
+    /* ------------------------------------------------------------------ *
+     * The sources a stream may draw from.
+     *
+     *   c_XOSHIRO: xoshiro256**, owned by the stream (the default).
+     *   c_LEGACY: the C library's rand().  Seeding a legacy stream calls
+     *     srand() (if the seed is positive), and its sub-streams all share
+     *     the one global sequence, exactly as older versions did.
+     * ------------------------------------------------------------------ */
+    static const int c_XOSHIRO;
+    static const int c_LEGACY;
+
+  public:
+
+    JBRandom( long seed = 0 ) { this->seed( seed ); }
+
+    /* ------------------------------------------------------------------ *
+     * Restarts the stream from the given seed, drawing from the given
+     * source (one of the constants above).
+     * ------------------------------------------------------------------ */
+    void seed( long seed, int source = c_XOSHIRO );
+
+    long getSeed() { return m_seed; }
+    int  getSource() { return m_source; }
+
+    /* ------------------------------------------------------------------ *
+     * Returns a new stream, numbered by the caller, that depends only on
+     * the seed of this one and the number, and not on how many numbers
+     * have been drawn from either.
+     * ------------------------------------------------------------------ */
+    JBRandom split( int stream );
+
+    /* ------------------------------------------------------------------ *
+     * Returns a number from 0 to n-1 (n must be at least 1).  A legacy
+     * stream returns rand() % n, as older versions did, and so cannot
+     * reach past RAND_MAX.
+     * ------------------------------------------------------------------ */
+    long next( long n ) {
+      uint64_t m;
+      uint32_t t;
+
+      if( m_source == c_LEGACY ) {
+        return rand() % n;
+      }
+
+      if( n > 0x7FFFFFFFL ) {
+        return m_nextWide( n );
+      }
+
+      /* Lemire's multiply-and-shift, which is rejected (rarely) only as
+       * often as is needed to keep the result unbiased */
+
+      m = ( m_next() >> 32 ) * (uint64_t)n;
+      if( (uint32_t)m < (uint32_t)n ) {
+        t = (uint32_t)( -(uint32_t)n ) % (uint32_t)n;
+        while( (uint32_t)m < t ) {
+          m = ( m_next() >> 32 ) * (uint64_t)n;
+        }
+      }
+
+      return (long)( m >> 32 );
+    }
+
+    /* ------------------------------------------------------------------ *
+     * Returns the position (0-5) of one of the bits set in the given
+     * six-bit value (which must not be 0), each as likely as any other,
+     * from a single number of the stream.
+     * ------------------------------------------------------------------ */
+    int choose( int bits ) {
+      return c_POSITION[ bits ][ next( c_BITS[ bits ] ) ];
+    }
+
+  private:
+
+    static const unsigned char c_BITS[ 64 ];
+    static const unsigned char c_POSITION[ 64 ][ 6 ];
+
+    uint64_t m_next() {
+      uint64_t result;
+      uint64_t t;
+
+      result = m_rotate( m_state[ 1 ] * 5, 7 ) * 9;
+      t = m_state[ 1 ] << 17;
+
+      m_state[ 2 ] ^= m_state[ 0 ];
+      m_state[ 3 ] ^= m_state[ 1 ];
+      m_state[ 1 ] ^= m_state[ 2 ];
+      m_state[ 0 ] ^= m_state[ 3 ];
+      m_state[ 2 ] ^= t;
+      m_state[ 3 ] = m_rotate( m_state[ 3 ], 45 );
+
+      return result;
+    }
+
+    static uint64_t m_rotate( uint64_t x, int k ) {
+      return ( x << k ) | ( x >> ( 64 - k ) );
+    }
+
+    static uint64_t m_splitmix( uint64_t* x );
+
+    /* ------------------------------------------------------------------ *
+     * next(), for n of 2^31 or more: the same method, with all 64 bits
+     * of a number.
+     * ------------------------------------------------------------------ */
+    long m_nextWide( long n );
+
+    void m_seedState( uint64_t seed );
+
+  private:
+
+    uint64_t m_state[ 4 ];    /* the xoshiro256** state */
+    long     m_seed;          /* the seed the stream was started from */
+    int      m_source;        /* c_XOSHIRO or c_LEGACY */
+};
+
+#endif /* __JBRANDOM_H__ */
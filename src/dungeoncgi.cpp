@@ -28,6 +28,8 @@
 #include "jbdungeon.h"
 #include "jbdungeondata.h"
 #include "jbdungeonpaintergd.h"
+#include "jbmazegenerator.h"
+#include "jbmazemaskgenerator.h"
 
 #include "gd.h"
 
@@ -285,6 +287,7 @@ JBDungeon* prepareDungeon() {
   char* concealed;
   char* deadends;
   char* resolution;
+  char* mask;
 
   float minMod = 0;
   float maxMod = 0;
@@ -332,7 +335,29 @@ JBDungeon* prepareDungeon() {
   dungeonOpts.randomness = atoi( random );
   dungeonOpts.clearDeadends = atoi( deadends );
 
-//  dungeonOpts.mask = new JBMazeMask( "d:\\dev\\roger.txt" );
+  /* the algorithm is given by name, as to the console tool's -a */
+
+  dungeonOpts.algorithm = JBMazeGenerator::findAlgorithm( qValueDefault( "huntandkill", "algorithm" ) );
+  if( dungeonOpts.algorithm < 0 ) {
+    dungeonOpts.algorithm = JBMaze::c_HUNTANDKILL;
+  }
+
+  /* "compatible=1" makes the same dungeon from a seed that earlier versions
+   * did, so that links saved from them still work */
+
+  if( qiValue( "compatible" ) ) {
+    dungeonOpts.compatibility = JBMaze::c_COMPAT_ALL;
+  }
+
+//  dungeonOpts.setMask( JBMazeMask::load( "d:\\dev\\roger.txt" ) );
+
+  /* a mask may be made from a preset ("caverns", or "caverns,seed"), the
+   * size of the dungeon, rather than read from a file */
+
+  mask = qValueDefault( 0, "mask" );
+  if( ( mask != 0 ) && ( *mask != 0 ) ) {
+    dungeonOpts.mask = JBMazeMaskGenerator::create( mask, dungeonOpts.size.x, dungeonOpts.size.y, seedn );
+  }
 
   if( dungeonOpts.mask != 0 ) {
     dungeonOpts.size.x = dungeonOpts.mask->getWidth();
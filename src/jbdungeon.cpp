@@ -46,14 +46,65 @@ JBDungeonOptions::JBDungeonOptions() {
   secretDoors = 5;
   concealedDoors = 5;
 
+  compatibility = 0;
+  algorithm = JBMaze::c_HUNTANDKILL;
+
+  mask = 0;
+  storage = 0;
+}
+
+
+JBDungeonOptions::JBDungeonOptions( const JBDungeonOptions& options ) {
   mask = 0;
+  *this = options;
 }
 
 
 JBDungeonOptions::~JBDungeonOptions() {
   if( mask != 0 ) {
-    delete mask;
+    mask->release();
+  }
+}
+
+
+JBDungeonOptions& JBDungeonOptions::operator=( const JBDungeonOptions& options ) {
+  size = options.size;
+  start = options.start;
+  end = options.end;
+
+  /* the mask gains a reference before the old one loses one, in case
+   * they are the same */
+
+  if( options.mask != 0 ) {
+    options.mask->retain();
+  }
+  setMask( options.mask );
+
+  seed = options.seed;
+  randomness = options.randomness;
+  sparseness = options.sparseness;
+  clearDeadends = options.clearDeadends;
+  minRoomCount = options.minRoomCount;
+  maxRoomCount = options.maxRoomCount;
+  minRoomX = options.minRoomX;
+  maxRoomX = options.maxRoomX;
+  minRoomY = options.minRoomY;
+  maxRoomY = options.maxRoomY;
+  secretDoors = options.secretDoors;
+  concealedDoors = options.concealedDoors;
+  compatibility = options.compatibility;
+  algorithm = options.algorithm;
+  storage = options.storage;
+
+  return *this;
+}
+
+
+void JBDungeonOptions::setMask( JBMazeMask* newMask ) {
+  if( mask != 0 ) {
+    mask->release();
   }
+  mask = newMask;
 }
 
 
@@ -107,23 +158,49 @@ const int JBDungeon::c_WALL    = 0x0001;
 const int JBDungeon::c_PASSAGE = 0x0002;
 const int JBDungeon::c_ROOM    = 0x0004;
 
+const int JBDungeon::c_STREAM_MAZE        = 0;
+const int JBDungeon::c_STREAM_ROOMS       = 1;
+const int JBDungeon::c_STREAM_WALLS       = 2;
+const int JBDungeon::c_STREAM_DESCRIPTION = 3;
+
+
+int rollDice( JBRandom& random, int count, int sides ) {
+  int total;
+
+  if( random.getSource() == JBRandom::c_LEGACY ) {
+    return rollDice( count, sides );
+  }
+
+  for( total = 0; count > 0; count-- ) {
+    total += random.next( sides ) + 1;
+  }
+
+  return total;
+}
+
 
 JBDungeon::JBDungeon( JBDungeonOptions& options ) {
   m_dungeon = 0;
+  m_storage = 0;
   m_rooms   = 0;
   m_walls   = 0;
   m_dataPath = 0;
 
   m_x = m_y = m_z = 0;
+  m_compatibility = options.compatibility;
 
   if( options.mask != 0 ) {
-    m_mask = new JBMazeMask( *options.mask );
+    m_mask = options.mask->retain();
   } else {
     m_mask = new JBMazeMask( options.size.x, options.size.y );
   }
 
   setDataPath( "" );
 
+  m_random.seed( options.seed,
+                 ( ( options.compatibility & JBMaze::c_COMPAT_RANDOM ) != 0 ?
+                   JBRandom::c_LEGACY : JBRandom::c_XOSHIRO ) );
+
   m_generate( options );
   m_computeRooms( options );
   m_computeWalls( options );
@@ -131,18 +208,7 @@ JBDungeon::JBDungeon( JBDungeonOptions& options ) {
 
 
 JBDungeon::~JBDungeon() {
-  int x;
-  int y;
-
-  for( x = 0; x < m_x; x++ ) {
-    for( y = 0; y < m_y; y++ ) {
-      free( m_dungeon[x][y] );
-    }
-    free( m_dungeon[x] );
-  }
-  free( m_dungeon );
-
-  free( m_solution );
+  delete m_storage;
 
   if( m_rooms != 0 ) {
     delete m_rooms;
@@ -151,13 +217,14 @@ JBDungeon::~JBDungeon() {
     delete m_walls;
   }
 
-  delete m_mask;
+  m_mask->release();
   delete m_dataPath;
 }
 
 
 void JBDungeon::m_generate( JBDungeonOptions& options ) {
   JBMaze* maze;
+  char*   path;
   int     x;
   int     y;
   int     z;
@@ -169,24 +236,50 @@ void JBDungeon::m_generate( JBDungeonOptions& options ) {
                      options.start.x, options.start.y, options.start.z,
                      options.end.x, options.end.y, options.end.z );
 
+  maze->setCompatibility( options.compatibility );
+  maze->setRandom( m_random.split( c_STREAM_MAZE ) );
+  maze->setAlgorithm( options.algorithm );
+
   /* set the mask to use for the maze (and dungeon) */
-  maze->setMask( new JBMazeMask( *m_mask ) );
+  maze->setMask( m_mask->retain() );
+
+  /* a mapped dungeon maps its maze, too, from a file that lasts only as
+   * long as the maze */
+  if( options.storage != 0 ) {
+    path = (char*)malloc( strlen( options.storage ) + 6 );
+    strcpy( path, options.storage );
+    strcat( path, ".maze" );
+    maze->setStorage( path, 1 );
+    free( path );
+
+    /* a file that cannot be mapped leaves the maze in memory, as the
+     * dungeon is left, below */
+    if( maze->getCells() == 0 ) {
+      maze->setStorage( 0 );
+    }
+  }
 
-  /* generate, solve, sparsify, and clear the deadends */
+  /* generate, sparsify, and clear the deadends, and then solve the maze
+   * (older versions had to solve it before sparsifying it) */
   maze->generate();
-  maze->solve( &m_solution, &m_solutionLength );
+  if( ( options.compatibility & JBMaze::c_COMPAT_SOLVE ) != 0 ) {
+    maze->solve( &m_solution );
+  }
   maze->sparsify( options.sparseness );
   maze->clearDeadends( options.clearDeadends );
+  if( ( options.compatibility & JBMaze::c_COMPAT_SOLVE ) == 0 ) {
+    maze->solve( &m_solution );
+  }
+
+  /* measure the maze while it is at hand; the solution is already known */
+  maze->measure( &m_metrics, 0 );
+  m_metrics.solutionLength = m_solution.getLength();
 
   /* the dimension of the dungeon is twice (plus 1) the dimension of the
    * maze on which it was based.  This is to allow the walls of the dungeon
-   * to be considered full-blocks.  Here, we are converting the solution
-   * of the maze to the new dimensions. */
-
-  for( x = 0; x < m_solutionLength; x++ ) {
-    m_solution[ x ].x = m_solution[ x ].x * 2 + 1;
-    m_solution[ x ].y = m_solution[ x ].y * 2 + 1;
-  }
+   * to be considered full-blocks.  The solution is kept in the dimensions
+   * of the maze, and getSolutionStep() converts each point to the new
+   * dimensions as it is asked for. */
 
   /* set the dimensions of the dungeon to be the dimensions of the mask,
    * times 2 plus 1 (to account for walls) */
@@ -195,50 +288,48 @@ void JBDungeon::m_generate( JBDungeonOptions& options ) {
   m_y = m_mask->getHeight() * 2 + 1;
   m_z = options.size.z;
 
-  /* allocate and initialize the dungeon */
+  /* allocate and initialize the dungeon.  Points are stored as the cells
+   * of a maze are (see m_cell()), and filled in the same order, two rows
+   * of the dungeon for each row of the maze, so that a mapped dungeon
+   * only ever needs the rows being filled. */
 
-  m_dungeon = (int***)malloc( m_x * sizeof( int** ) );
+  m_storage = new JBMazeStorage( options.storage, (long)m_x * m_y * m_z * sizeof( int ) );
+  if( ( m_storage->getBlock() == 0 ) && ( options.storage != 0 ) ) {
+
+    /* the file could not be mapped (a bad path, or a full disk), so the
+     * dungeon is kept in memory instead */
+
+    delete m_storage;
+    m_storage = new JBMazeStorage( 0, (long)m_x * m_y * m_z * sizeof( int ) );
+  }
+  m_storage->advise( JBMazeStorage::c_SEQUENTIAL );
+  m_dungeon = (int*)m_storage->getBlock();
 
-  for( x = 0; x < m_mask->getWidth(); x++ ) {
-    m_dungeon[ x*2 ] = (int**)malloc( m_y * sizeof( int* ) );
-    m_dungeon[ x*2+1 ] = (int**)malloc( m_y * sizeof( int* ) );
+  for( z = 0; z < m_z; z++ ) {
     for( y = 0; y < m_mask->getHeight(); y++ ) {
-      m_dungeon[ x*2 ][ y*2 ] = (int*)malloc( m_z * sizeof( int ) );
-      m_dungeon[ x*2 ][ y*2+1 ] = (int*)malloc( m_z * sizeof( int ) );
-      m_dungeon[ x*2+1 ][ y*2 ] = (int*)malloc( m_z * sizeof( int ) );
-      m_dungeon[ x*2+1 ][ y*2+1 ] = (int*)malloc( m_z * sizeof( int ) );
-      for( z = 0; z < m_z; z++ ) {
-        m_dungeon[ x*2 ][ y*2 ][ z ] = c_WALL;
-        m_dungeon[ x*2 ][ y*2+1 ][ z ] = c_WALL;
-        m_dungeon[ x*2+1 ][ y*2 ][ z ] = c_WALL;
-        m_dungeon[ x*2+1 ][ y*2+1 ][ z ] = c_WALL;
+      for( x = 0; x < m_x; x++ ) {
+        m_dungeon[ m_cell( x, y*2, z ) ] = c_WALL;
+        m_dungeon[ m_cell( x, y*2+1, z ) ] = c_WALL;
+      }
+      for( x = 0; x < m_mask->getWidth(); x++ ) {
         dir = maze->getExitsAt( x, y, z );
         if( dir != 0 ) {
-          m_dungeon[ x*2+1 ][ y*2+1 ][ z ] = c_PASSAGE;
+          m_dungeon[ m_cell( x*2+1, y*2+1, z ) ] = c_PASSAGE;
         }
         if( ( dir & JBMaze::c_NORTH ) != 0 ) {
-          m_dungeon[ x*2+1 ][ y*2 ][ z ] = c_PASSAGE;
+          m_dungeon[ m_cell( x*2+1, y*2, z ) ] = c_PASSAGE;
         }
         if( ( dir & JBMaze::c_WEST ) != 0 ) {
-          m_dungeon[ x*2 ][ y*2+1 ][ z ] = c_PASSAGE;
+          m_dungeon[ m_cell( x*2, y*2+1, z ) ] = c_PASSAGE;
         }
       }
     }
-    m_dungeon[ x*2 ][ m_y-1 ] = (int*)malloc( m_z * sizeof( int ) );
-    m_dungeon[ x*2+1 ][ m_y-1 ] = (int*)malloc( m_z * sizeof( int ) );
-    for( z = 0; z < m_z; z++ ) {
-      m_dungeon[ x*2 ][ m_y-1 ][ z ] = c_WALL;
-      m_dungeon[ x*2+1 ][ m_y-1 ][ z ] = c_WALL;
+    for( x = 0; x < m_x; x++ ) {
+      m_dungeon[ m_cell( x, m_y-1, z ) ] = c_WALL;
     }
   }
 
-  m_dungeon[m_x-1] = (int**)malloc( m_y * sizeof( int* ) );
-  for( y = 0; y < m_y; y++ ) {
-    m_dungeon[ m_x-1 ][ y ] = (int*)malloc( m_z * sizeof( int ) );
-    for( z = 0; z < m_z; z++ ) {
-      m_dungeon[ m_x-1 ][ y ][ z ] = c_WALL;
-    }
-  }
+  m_storage->advise( JBMazeStorage::c_NORMAL );
 
   delete maze;
 }
@@ -266,7 +357,7 @@ int JBDungeon::getDungeonAt( int x, int y, int z ) {
     return 0;
   }
 
-  return m_dungeon[ x ][ y ][ z ];
+  return m_dungeon[ m_cell( x, y, z ) ];
 }
 
 
@@ -280,25 +371,28 @@ void JBDungeon::m_computeRooms( JBDungeonOptions& options ) {
   int z;
   int cx;
   int cy;
+  int inside;
+
+  m_phase = m_random.split( c_STREAM_ROOMS );
 
   for( z = 0; z < m_z; z++ ) {
     if( options.maxRoomCount == options.minRoomCount ) {
       roomCount = options.minRoomCount;
     } else {
-      roomCount = rand() % ( options.maxRoomCount - options.minRoomCount + 1 ) + options.minRoomCount;
+      roomCount = m_phase.next( options.maxRoomCount - options.minRoomCount + 1 ) + options.minRoomCount;
     }
 
     for( i = 0; i < roomCount; i++ ) {
       if( options.maxRoomX == options.minRoomX ) {
         rx = options.maxRoomX;
       } else {
-        rx = rand() % ( options.maxRoomX - options.minRoomX + 1 ) + options.minRoomX;
+        rx = m_phase.next( options.maxRoomX - options.minRoomX + 1 ) + options.minRoomX;
       }
 
       if( options.maxRoomY == options.minRoomY ) {
         ry = options.minRoomY;
       } else {
-        ry = rand() % ( options.maxRoomY - options.minRoomY + 1 ) + options.minRoomY;
+        ry = m_phase.next( options.maxRoomY - options.minRoomY + 1 ) + options.minRoomY;
       }
 
       /* disallow extremely narrow rooms by requiring that a room never be
@@ -317,10 +411,16 @@ void JBDungeon::m_computeRooms( JBDungeonOptions& options ) {
 
       m_addRoom( cx, cy, z, rx, ry );
 
+      /* a room wholly inside the mask (the usual case) needs no point of
+       * it checked */
+
+      inside = m_mask->isValid( cx>>1, cy>>1, ( ( cx+rx-1 )>>1 ) - ( cx>>1 ) + 1,
+                                ( ( cy+ry-1 )>>1 ) - ( cy>>1 ) + 1 );
+
       for( j = 0; j < rx; j++ ) {
         for( k = 0; k < ry; k++ ) {
-          if( m_mask->getMaskAt( (cx+j)>>1, (cy+k)>>1 ) ) {
-            m_dungeon[ cx+j ][ cy+k ][ z ] = c_ROOM;
+          if( inside || m_mask->getMaskAt( (cx+j)>>1, (cy+k)>>1 ) ) {
+            m_dungeon[ m_cell( cx+j, cy+k, z ) ] = c_ROOM;
           }
         }
       }
@@ -329,10 +429,10 @@ void JBDungeon::m_computeRooms( JBDungeonOptions& options ) {
 }
 
 
-int determineRandomDoorType( JBDungeonOptions& options ) {
+int determineRandomDoorType( JBRandom& random, JBDungeonOptions& options ) {
   int d;
 
-  d = rollDice( 1, 100 );
+  d = rollDice( random, 1, 100 );
   if( d <= options.secretDoors ) {
     return JBDungeonWall::c_SECRETDOOR;
   }
@@ -371,7 +471,9 @@ void JBDungeon::m_computeWalls( JBDungeonOptions& options ) {
    * And if that made no sense to you at all -- reread it.  It's a
    * simple procedure that's difficult to describe simply.
    * -------------------------------------------------------------------- */
-  
+
+  m_phase = m_random.split( c_STREAM_WALLS );
+
   for( room = m_rooms; room != 0; room = room->next ) {
     walls = 0;
 
@@ -383,14 +485,14 @@ void JBDungeon::m_computeWalls( JBDungeonOptions& options ) {
 
     for( j = 0; j < room->size.x; j++ ) {
       if( ( one != 0 ) && ( lastOne != j-1 ) ) {
-        wall = (JBDungeonWall*)getWeightedItem( &one, rollDice( 1, oneTotal ), &oneTotal );
-        wall->type = determineRandomDoorType( options );
+        wall = (JBDungeonWall*)getWeightedItem( &one, rollDice( m_phase, 1, oneTotal ), &oneTotal );
+        wall->type = determineRandomDoorType( m_phase, options );
 
         destroyWeightedList( &one );
         oneTotal = 0;
       }
 
-      if( m_dungeon[ room->topLeft.x+j ][ room->topLeft.y-1 ][ room->topLeft.z ] != c_WALL ) {
+      if( m_dungeon[ m_cell( room->topLeft.x+j, room->topLeft.y-1, room->topLeft.z ) ] != c_WALL ) {
         JBMazePt p1( room->topLeft.x+j, room->topLeft.y-1, room->topLeft.z );
         JBMazePt p2( room->topLeft.x+j, room->topLeft.y, room->topLeft.z );
 
@@ -402,14 +504,14 @@ void JBDungeon::m_computeWalls( JBDungeonOptions& options ) {
       }
 
       if( ( two != 0 ) && ( lastTwo != j-1 ) ) {
-        wall = (JBDungeonWall*)getWeightedItem( &two, rollDice( 1, twoTotal ), &twoTotal );
-        wall->type = determineRandomDoorType( options );
+        wall = (JBDungeonWall*)getWeightedItem( &two, rollDice( m_phase, 1, twoTotal ), &twoTotal );
+        wall->type = determineRandomDoorType( m_phase, options );
 
         destroyWeightedList( &two );
         twoTotal = 0;
       }
 
-      if( m_dungeon[ room->topLeft.x+j ][ room->topLeft.y+room->size.y ][ room->topLeft.z ] != c_WALL ) {
+      if( m_dungeon[ m_cell( room->topLeft.x+j, room->topLeft.y+room->size.y, room->topLeft.z ) ] != c_WALL ) {
         JBMazePt p1( room->topLeft.x+j, room->topLeft.y+room->size.y-1, room->topLeft.z );
         JBMazePt p2( room->topLeft.x+j, room->topLeft.y+room->size.y, room->topLeft.z );
 
@@ -422,12 +524,12 @@ void JBDungeon::m_computeWalls( JBDungeonOptions& options ) {
     }
 
     if( one != 0 ) {
-      wall = (JBDungeonWall*)getWeightedItem( &one, rollDice( 1, oneTotal ), &oneTotal );
-        wall->type = determineRandomDoorType( options );
+      wall = (JBDungeonWall*)getWeightedItem( &one, rollDice( m_phase, 1, oneTotal ), &oneTotal );
+        wall->type = determineRandomDoorType( m_phase, options );
     }
     if( two != 0 ) {
-      wall = (JBDungeonWall*)getWeightedItem( &two, rollDice( 1, twoTotal ), &twoTotal );
-        wall->type = determineRandomDoorType( options );
+      wall = (JBDungeonWall*)getWeightedItem( &two, rollDice( m_phase, 1, twoTotal ), &twoTotal );
+        wall->type = determineRandomDoorType( m_phase, options );
     }
 
     destroyWeightedList( &one );
@@ -441,14 +543,14 @@ void JBDungeon::m_computeWalls( JBDungeonOptions& options ) {
 
     for( j = 0; j < room->size.y; j++ ) {
       if( ( one != 0 ) && ( lastOne != j-1 ) ) {
-        wall = (JBDungeonWall*)getWeightedItem( &one, rollDice( 1, oneTotal ), &oneTotal );
-        wall->type = determineRandomDoorType( options );
+        wall = (JBDungeonWall*)getWeightedItem( &one, rollDice( m_phase, 1, oneTotal ), &oneTotal );
+        wall->type = determineRandomDoorType( m_phase, options );
 
         destroyWeightedList( &one );
         oneTotal = 0;
       }
 
-      if( m_dungeon[ room->topLeft.x-1 ][ room->topLeft.y+j ][ room->topLeft.z ] != c_WALL ) {
+      if( m_dungeon[ m_cell( room->topLeft.x-1, room->topLeft.y+j, room->topLeft.z ) ] != c_WALL ) {
         JBMazePt p1( room->topLeft.x-1, room->topLeft.y+j, room->topLeft.z );
         JBMazePt p2( room->topLeft.x, room->topLeft.y+j, room->topLeft.z );
 
@@ -460,14 +562,14 @@ void JBDungeon::m_computeWalls( JBDungeonOptions& options ) {
       }
 
       if( ( two != 0 ) && ( lastTwo != j-1 ) ) {
-        wall = (JBDungeonWall*)getWeightedItem( &two, rollDice( 1, twoTotal ), &twoTotal );
-        wall->type = determineRandomDoorType( options );
+        wall = (JBDungeonWall*)getWeightedItem( &two, rollDice( m_phase, 1, twoTotal ), &twoTotal );
+        wall->type = determineRandomDoorType( m_phase, options );
 
         destroyWeightedList( &two );
         twoTotal = 0;
       }
 
-      if( m_dungeon[ room->topLeft.x+room->size.x ][ room->topLeft.y+j ][ room->topLeft.z ] != c_WALL ) {
+      if( m_dungeon[ m_cell( room->topLeft.x+room->size.x, room->topLeft.y+j, room->topLeft.z ) ] != c_WALL ) {
         JBMazePt p1( room->topLeft.x+room->size.x-1, room->topLeft.y+j, room->topLeft.z );
         JBMazePt p2( room->topLeft.x+room->size.x, room->topLeft.y+j, room->topLeft.z );
 
@@ -480,12 +582,12 @@ void JBDungeon::m_computeWalls( JBDungeonOptions& options ) {
     }
 
     if( one != 0 ) {
-      wall = (JBDungeonWall*)getWeightedItem( &one, rollDice( 1, oneTotal ), &oneTotal );
-        wall->type = determineRandomDoorType( options );
+      wall = (JBDungeonWall*)getWeightedItem( &one, rollDice( m_phase, 1, oneTotal ), &oneTotal );
+        wall->type = determineRandomDoorType( m_phase, options );
     }
     if( two != 0 ) {
-      wall = (JBDungeonWall*)getWeightedItem( &two, rollDice( 1, twoTotal ), &twoTotal );
-        wall->type = determineRandomDoorType( options );
+      wall = (JBDungeonWall*)getWeightedItem( &two, rollDice( m_phase, 1, twoTotal ), &twoTotal );
+        wall->type = determineRandomDoorType( m_phase, options );
     }
 
     destroyWeightedList( &one );
@@ -517,6 +619,8 @@ int JBDungeon::m_findOptimalRoomPlacement( int& rx, int& ry, int z, int& cx, int
   int total;
   int overlapsRoom;
   int lowestOverlapsRoom;
+  int inside;
+  long valid;
 
   if( rx > m_x - 2 ) {
     rx = m_x - 2;
@@ -544,10 +648,16 @@ int JBDungeon::m_findOptimalRoomPlacement( int& rx, int& ry, int z, int& cx, int
         continue;
       }
 
+      /* if the room would lie wholly inside the mask, no point of it
+       * needs to be checked below */
+
+      inside = m_mask->isValid( x>>1, y>>1, ( ( x+rx-1 )>>1 ) - ( x>>1 ) + 1,
+                                ( ( y+ry-1 )>>1 ) - ( y>>1 ) + 1 );
+
       tally = 0;
       for( i = -1; i < rx+1; i++ ) {
         for( j = -1; j < ry+1; j++ ) {
-          d = m_dungeon[ x+i ][ y+j ][ z ];
+          d = m_dungeon[ m_cell( x+i, y+j, z ) ];
           if( ( ( i == -1 ) && ( j == -1 ) ) ||
               ( ( i == -1 ) && ( j == ry ) ) ||
               ( ( i == rx ) && ( j == -1 ) ) ||
@@ -568,7 +678,7 @@ int JBDungeon::m_findOptimalRoomPlacement( int& rx, int& ry, int z, int& cx, int
               overlapsRoom = 1;
             }
             if( ( i >= 0 ) && ( j >= 0 ) && ( i < rx ) && ( j < ry ) ) {
-              if( !m_mask->getMaskAt( (x+i)/2, (y+j)/2 ) ) {
+              if( !inside && !m_mask->getMaskAt( (x+i)/2, (y+j)/2 ) ) {
                 tally += 10;
               }
             }
@@ -607,10 +717,24 @@ int JBDungeon::m_findOptimalRoomPlacement( int& rx, int& ry, int z, int& cx, int
   }
 
   if( wlist == 0 ) {
-    cx = 1 + rand() % ( spaceX - 1 );
-    cy = 1 + rand() % ( spaceY - 1 );
+    cx = 1 + m_phase.next( spaceX - 1 );
+    cy = 1 + m_phase.next( spaceY - 1 );
+
+    /* a room dropped outside the mask is wasted; try (a few times) for a
+     * valid point of the mask instead, drawn straight from its runs */
+
+    valid = m_mask->countValid();
+    for( i = 0; ( i < 16 ) && ( valid > 0 ) && !m_mask->getMaskAt( cx>>1, cy>>1 ) &&
+                ( ( m_compatibility & JBMaze::c_COMPAT_START ) == 0 ); i++ )
+    {
+      m_mask->getValidPoint( m_phase.next( valid ), &x, &y );
+      if( ( x*2+1 < spaceX ) && ( y*2+1 < spaceY ) ) {
+        cx = x*2+1;
+        cy = y*2+1;
+      }
+    }
   } else {
-    total = getWeightedItem( &wlist, rollDice( 1, total ), &total );
+    total = getWeightedItem( &wlist, rollDice( m_phase, 1, total ), &total );
     cx = (unsigned int)( total >> 16 );
     cy = (unsigned int)( total & 0xFFFF );
   }
@@ -653,10 +777,10 @@ int JBDungeon::getWallBetween( const JBMazePt& p1, const JBMazePt& p2 ) {
     }
   }
 
-  if( ( ( m_dungeon[ p1.x ][ p1.y ][ p1.z ] == c_WALL ) ||
-        ( m_dungeon[ p2.x ][ p2.y ][ p2.z ] == c_WALL ) ) &&
-      ( ( m_dungeon[ p1.x ][ p1.y ][ p1.z ] != c_WALL ) ||
-        ( m_dungeon[ p2.x ][ p2.y ][ p2.z ] != c_WALL ) ) )
+  if( ( ( m_dungeon[ m_cell( p1.x, p1.y, p1.z ) ] == c_WALL ) ||
+        ( m_dungeon[ m_cell( p2.x, p2.y, p2.z ) ] == c_WALL ) ) &&
+      ( ( m_dungeon[ m_cell( p1.x, p1.y, p1.z ) ] != c_WALL ) ||
+        ( m_dungeon[ m_cell( p2.x, p2.y, p2.z ) ] != c_WALL ) ) )
   {
     return JBDungeonWall::c_WALL;
   }
@@ -1411,14 +1411,14 @@ static struct {
   {   0, 0,        { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 } }
 };
 
-typedef int (*CONTENTHANDLER)( JBDungeonRoomDatum*, int );
+typedef int (*CONTENTHANDLER)( JBRandom&, JBDungeonRoomDatum*, int );
 
 /* "handlers" to be used in generating room descriptions */
 
-int monsterHandler( JBDungeonRoomDatum* room, int level );
-int featureHandler( JBDungeonRoomDatum* room, int level );
-int trapHandler( JBDungeonRoomDatum* room, int level );
-int treasureHandler( JBDungeonRoomDatum* room, int level );
+int monsterHandler( JBRandom& random, JBDungeonRoomDatum* room, int level );
+int featureHandler( JBRandom& random, JBDungeonRoomDatum* room, int level );
+int trapHandler( JBRandom& random, JBDungeonRoomDatum* room, int level );
+int treasureHandler( JBRandom& random, JBDungeonRoomDatum* room, int level );
 
 /* handlers to use to determine the contents of a given room */
 
@@ -1598,6 +1598,7 @@ void JBDungeonRoomDatum::getDatumDescription( char* desc ) {
 
 
 JBDungeonDescription::JBDungeonDescription( JBDungeon* dungeon, int level ) {
+  m_random = dungeon->getRandom().split( JBDungeon::c_STREAM_DESCRIPTION );
   m_describeRooms( dungeon, level );
 }
 
@@ -1617,7 +1618,7 @@ void JBDungeonDescription::m_describeRooms( JBDungeon* dungeon, int level ) {
 }
 
 
-char* getRandomTrap( int level, int forDoor ) {
+char* getRandomTrap( JBRandom& random, int level, int forDoor ) {
   TRAPLIST* list;
   int       d;
   int       i;
@@ -1635,7 +1636,7 @@ char* getRandomTrap( int level, int forDoor ) {
 
   do {
     valid = 1;
-    d = rollDice( 1, 100 );
+    d = rollDice( random, 1, 100 );
     for( i = 0; list[ i ].dtop != 0; i++ ) {
       if( d <= list[ i ].dtop ) {
         if( !(list[ i ].forDoor) && ( forDoor ) ) {
@@ -1644,7 +1645,7 @@ char* getRandomTrap( int level, int forDoor ) {
         }
 
         if( list[ i ].trap == SPELLTRAP ) {
-          d = rollDice( 1, 100 );
+          d = rollDice( random, 1, 100 );
           for( i = 0; s_spellsForTraps[ i ].dtop != 0; i++ ) {
             if( d <= s_spellsForTraps[ i ].dtop ) {
               char* name;
@@ -1669,21 +1670,21 @@ char* getRandomTrap( int level, int forDoor ) {
 }
 
 
-long getDoorType( int allowReroll, DOORTYPE* doors ) {
+long getDoorType( JBRandom& random, int allowReroll, DOORTYPE* doors ) {
   int  d;
   int  i;
   int  valid;
   long value = 0;
 
   do {
-    d = rollDice( 1, 100 );
+    d = rollDice( random, 1, 100 );
     valid = 0;
     for( i = 0; doors[ i ].dtop != 0; i++ ) {
       if( d <= doors[ i ].dtop ) {
         value = doors[ i ].data;
         if( ( value & REROLL_ONCE ) != 0 ) {
           if( allowReroll ) {
-            value = ( value | getDoorType( 0, doors ) ) & ~REROLL_ONCE;
+            value = ( value | getDoorType( random, 0, doors ) ) & ~REROLL_ONCE;
             valid = 1;
           }
         } else {
@@ -1716,41 +1717,41 @@ void JBDungeonDescription::m_describeRoom( JBDungeon* dungeon, JBDungeonRoom* ro
     if( room->walls[ i ]->type == JBDungeonWall::c_WALL ) {
     } else if( room->walls[ i ]->type == JBDungeonWall::c_DOOR ) {
       if( room->walls[ i ]->data == 0 ) {
-        data = getDoorType( 1, s_doorTypes );
-        trap = ( ( data & dtTRAPPED ) != 0 ? getRandomTrap( level, 1 ) : 0 );
+        data = getDoorType( m_random, 1, s_doorTypes );
+        trap = ( ( data & dtTRAPPED ) != 0 ? getRandomTrap( m_random, level, 1 ) : 0 );
         room->walls[ i ]->data = new JBDungeonWallDatum( data, trap, 0 );
       }
     } else if( room->walls[ i ]->type == JBDungeonWall::c_SECRETDOOR ) {
       if( room->walls[ i ]->data == 0 ) {
-        data = getDoorType( 1, s_secretDoorTypes );
-        trap = ( ( data & dtTRAPPED ) != 0 ? getRandomTrap( level, 1 ) : 0 );
+        data = getDoorType( m_random, 1, s_secretDoorTypes );
+        trap = ( ( data & dtTRAPPED ) != 0 ? getRandomTrap( m_random, level, 1 ) : 0 );
         room->walls[ i ]->data = new JBDungeonWallDatum( data, trap, "(secret)" );
       }
     } else if( room->walls[ i ]->type == JBDungeonWall::c_CONCEALEDDOOR ) {
       if( room->walls[ i ]->data == 0 ) {
-        if( rand() % 3 != 0 ) {
-          data = getDoorType( 1, s_doorTypes );
-          if( rand() % 2 == 0 ) {
+        if( m_random.next( 3 ) != 0 ) {
+          data = getDoorType( m_random, 1, s_doorTypes );
+          if( m_random.next( 2 ) == 0 ) {
             data |= cdtBEHINDRUBBISH;
           } else {
             data |= cdtBEHINDTAPESTRY;
           }
         } else {
-          data = getDoorType( 1, s_concealedDoorTypes );
+          data = getDoorType( m_random, 1, s_concealedDoorTypes );
         }
 
-        trap = ( ( data & dtTRAPPED ) != 0 ? getRandomTrap( level, 1 ) : 0 );
+        trap = ( ( data & dtTRAPPED ) != 0 ? getRandomTrap( m_random, level, 1 ) : 0 );
         room->walls[ i ]->data = new JBDungeonWallDatum( data, trap, "(concealed)" );
       }
     }
   }
 
-  d = rollDice( 1, 100 );
+  d = rollDice( m_random, 1, 100 );
   for( i = 0; s_roomContents[ i ].dtop != 0; i++ ) {
     if( d <= s_roomContents[ i ].dtop ) {
       for( j = 0; s_contentHandlers[ j ].type != 0; j++ ) {
         if( ( s_contentHandlers[ j ].type & s_roomContents[ i ].contents ) != 0 ) {
-          s_contentHandlers[ j ].handler( rdatum, level );
+          s_contentHandlers[ j ].handler( m_random, rdatum, level );
         }
       }
       break;
@@ -1759,12 +1760,12 @@ void JBDungeonDescription::m_describeRoom( JBDungeon* dungeon, JBDungeonRoom* ro
 }
 
 
-char* getRandomDragon( int level ) {
+char* getRandomDragon( JBRandom& random, int level ) {
   int i;
   int d;
   static char buffer[128];
 
-  d = rollDice( 1, 100 );
+  d = rollDice( random, 1, 100 );
   for( i = 0; s_dragonTable[ i ].dtop != 0; i++ ) {
     if( d <= s_dragonTable[ i ].dtop ) {
       strcpy( buffer, "~B" );
@@ -1782,7 +1783,7 @@ char* getRandomDragon( int level ) {
 }
 
 
-int monsterHandler( JBDungeonRoomDatum* room, int level ) {
+int monsterHandler( JBRandom& random, JBDungeonRoomDatum* room, int level ) {
   DUNGEONLEVEL* masterData;
   DUNGEONMONSTERS* monsters;
   int           i;
@@ -1796,7 +1797,7 @@ int monsterHandler( JBDungeonRoomDatum* room, int level ) {
   char          buffer[512];
 
   masterData = s_masterMonsterTable[ level ];
-  d = rollDice( 1, 100 );
+  d = rollDice( random, 1, 100 );
   for( i = 0; masterData[i].dtop != 0; i++ ) {
     if( d <= masterData[ i ].dtop ) {
       lvl = masterData[ i ].level;
@@ -1804,12 +1805,12 @@ int monsterHandler( JBDungeonRoomDatum* room, int level ) {
       div = masterData[ i ].div;
 
       monsters = s_monsterTable[ lvl ];
-      d = rollDice( 1, 100 );
+      d = rollDice( random, 1, 100 );
       for( i = 0; monsters[ i ].dtop != 0; i++ ) {
         if( d <= monsters[ i ].dtop ) {
           k = monsters[ i ].dtop;
           while( k == monsters[ i ].dtop ) {
-            x = rollDice( monsters[ i ].dcount, monsters[ i ].dtype ) + monsters[ i ].dmod;
+            x = rollDice( random, monsters[ i ].dcount, monsters[ i ].dtype ) + monsters[ i ].dmod;
             x = ( x * mul ) / div;
             if( x < 1 ) {
               x = 1;
@@ -1819,7 +1820,7 @@ int monsterHandler( JBDungeonRoomDatum* room, int level ) {
               /* if the monster is a dragon, add a random dragon based on the
                * modified level of the monster to be generated. */
 
-              room->addMonster( getRandomDragon( lvl ) );
+              room->addMonster( getRandomDragon( random, lvl ) );
 
             } else if( monsters[ i ].npcMinLevel > 0 ) {
               /* if the monster is an NPC, use the NPC generator engine to
@@ -1900,7 +1901,7 @@ int monsterHandler( JBDungeonRoomDatum* room, int level ) {
 }
 
 
-int featureHandler( JBDungeonRoomDatum* room, int level ) {
+int featureHandler( JBRandom& random, JBDungeonRoomDatum* room, int level ) {
   FEATURELIST* lists[2];
   int          i;
   int          d;
@@ -1910,8 +1911,8 @@ int featureHandler( JBDungeonRoomDatum* room, int level ) {
   lists[0] = s_minorFeatures;
   lists[1] = s_majorFeatures;
   for( i = 0; i < 2; i++ ) {
-    for( j = rollDice( 1, 4 ); j > 0; j-- ) {
-      d = rollDice( 1, 100 );
+    for( j = rollDice( random, 1, 4 ); j > 0; j-- ) {
+      d = rollDice( random, 1, 100 );
       for( k = 0; lists[ i ][ k ].dtop != 0; k++ ) {
         if( d <= lists[ i ][ k ].dtop ) {
           room->addFeature( lists[ i ][ k ].feature );
@@ -1925,10 +1926,10 @@ int featureHandler( JBDungeonRoomDatum* room, int level ) {
 }
 
 
-int trapHandler( JBDungeonRoomDatum* room, int level ) {
+int trapHandler( JBRandom& random, JBDungeonRoomDatum* room, int level ) {
   char* trap;
 
-  trap = getRandomTrap( level, 0 );
+  trap = getRandomTrap( random, level, 0 );
 
   room->trap = new char[ strlen(trap) + 1 ];
   strcpy( room->trap, trap );
@@ -1937,7 +1938,7 @@ int trapHandler( JBDungeonRoomDatum* room, int level ) {
 }
 
 
-int treasureHandler( JBDungeonRoomDatum* room, int level ) {
+int treasureHandler( JBRandom& random, JBDungeonRoomDatum* room, int level ) {
   do {
     /* if there is hidden treasure, use the treasure generator engine to
      * compute the actual contents of the treasure. */
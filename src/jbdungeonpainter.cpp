@@ -70,10 +70,13 @@ void JBDungeonPainter::paint() {
   }
 
   /* draw specific walls and doors, by checking each point and the points
-   * to the left and below it to see if there is a wall between them. */
+   * to the left and below it to see if there is a wall between them.
+   * Everything here is drawn in one color, so the order does not matter;
+   * going a row at a time keeps the points being checked together, as
+   * the dungeon stores them. */
   
-  for( i = 0; i < m_dungeon->getX() - 1; i++ ) {
-    for( j = 0; j < m_dungeon->getY() - 1; j++ ) {
+  for( j = 0; j < m_dungeon->getY() - 1; j++ ) {
+    for( i = 0; i < m_dungeon->getX() - 1; i++ ) {
       JBMazePt p1( i, j, 0 );
       JBMazePt p2( i, j+1, 0 );
       JBMazePt p3( i+1, j, 0 );
@@ -11,8 +11,13 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <limits.h>
 
 #include "jbmaze.h"
+#include "jbmazegenerator.h"
+#include "jbmazepath.h"
+#include "jbmazecore.h"
+#include "jbmazeplanes.h"
 
 const int JBMaze::c_NORTH = 0x0001;
 const int JBMaze::c_SOUTH = 0x0002;
@@ -21,19 +26,73 @@ const int JBMaze::c_EAST  = 0x0008;
 const int JBMaze::c_UP    = 0x0010;
 const int JBMaze::c_DOWN  = 0x0020;
 
-const int JBMaze::c_MARK  = 0x8000;
+const int JBMaze::c_COMPAT_RESTART    = 0x0001;
+const int JBMaze::c_COMPAT_SOLVE      = 0x0002;
+const int JBMaze::c_COMPAT_DEADENDS   = 0x0004;
+const int JBMaze::c_COMPAT_RANDOM     = 0x0008;
+const int JBMaze::c_COMPAT_DIRECTIONS = 0x0010;
+const int JBMaze::c_COMPAT_START      = 0x0020;
+const int JBMaze::c_COMPAT_ALL        = 0x003F;
+
+const int JBMaze::c_HUNTANDKILL = 0;
+const int JBMaze::c_BACKTRACKER = 1;
+const int JBMaze::c_GROWINGTREE = 2;
+const int JBMaze::c_KRUSKAL     = 3;
+const int JBMaze::c_WILSON      = 4;
+const int JBMaze::c_TILED       = 5;
+const int JBMaze::c_LAYERED     = 6;
+const int JBMaze::c_STREAM      = 7;
+
+const int JBMaze::c_MARK  = 0x0040;
+
+const int JBMaze::c_ALIGNMENT = 64;
+
+const int JBMaze::c_STREAM_GENERATE = 0;
+const int JBMaze::c_STREAM_DEADENDS = 1;
+
+const int JBMaze::c_SOLVE_BFS           = 0;
+const int JBMaze::c_SOLVE_BIDIRECTIONAL = 1;
+
+const int JBMaze::c_JOB_NONE     = 0;
+const int JBMaze::c_JOB_GENERATE = 1;
+const int JBMaze::c_JOB_SPARSIFY = 2;
+const int JBMaze::c_JOB_DEADENDS = 3;
+
+const int  JBMaze::c_ALLDIRS = 0x003F;
+const long JBMaze::c_QUEUE_SIZE = 1024;
 
 
 JBMaze::JBMaze( int x, int y, int z, long seed, int randomness,
                 int sx, int sy, int sz,
                 int ex, int ey, int ez ) 
 {
-  int i;
-  int j;
-
-  m_deadendsClosed = 1;
+  m_compatibility = 0;
 
   m_maze = 0;
+  m_storage = 0;
+  m_storagePath = 0;
+  m_storageTemporary = 0;
+  m_advice = JBMazeStorage::c_NORMAL;
+  m_mask = 0;
+  m_frontierStorage = 0;
+  m_frontier = 0;
+  m_frontierPos = 0;
+  m_frontierCount = 0;
+  m_algorithm = c_HUNTANDKILL;
+  m_generator = 0;
+  m_solveStorage = 0;
+  m_solveStamp = 0;
+  m_solveFrom = 0;
+  m_planes = 0;
+  m_solveQueue[ 0 ].cells = m_solveQueue[ 1 ].cells = 0;
+  m_nodesExpanded = 0;
+  m_connectorRadius = 0;
+  m_generic = 0;
+  memset( &m_deadendStats, 0, sizeof( m_deadendStats ) );
+  m_job = c_JOB_NONE;
+  m_walk = 0;
+  m_jobQueue.cells = 0;
+  m_jobQueue.head = m_jobQueue.count = 0;
   m_x = m_y = m_z = 0;
   m_seed = 0;
   m_randomness = 0;
@@ -58,30 +117,29 @@ JBMaze::JBMaze( int x, int y, int z, long seed, int randomness,
 
   if( seed > 0 ) {
     m_seed = seed;
-    srand( m_seed );
   }
+  m_random.seed( m_seed );
 
   m_randomness = randomness;
 
-  m_maze = (int***)malloc( m_x * sizeof( int** ) );
-  for( i = 0; i < x; i++ ) {
-    m_maze[ i ] = (int**)malloc( m_y * sizeof( int* ) );
-    for( j = 0; j < y; j++ ) {
-      m_maze[ i ][ j ] = (int*)malloc( m_z * sizeof( int ) );
-      memset( m_maze[ i ][ j ], 0, m_z * sizeof( int ) );
-    }
-  }
+  m_allocateMaze();
 }
 
 
 JBMaze::~JBMaze() {
+  m_endJob();
   m_deallocateMaze();
+  m_deallocateFrontier();
 
   m_maze = 0;
   m_x = m_y = m_z = 0;
   m_seed = 0;
 
-  delete m_mask;
+  if( m_mask != 0 ) {
+    m_mask->release();
+  }
+  delete m_generator;
+  free( m_storagePath );
 }
 
 
@@ -95,196 +153,565 @@ int JBMaze::getExitsAt( int x, int y, int z ) {
   if( ( x >= m_x ) || ( y >= m_y ) || ( z >= m_z ) ) {
     return 0;
   }
-  return m_maze[ x ][ y ][ z ];
+  return m_maze[ m_index( x, y, z ) ];
 }
 
 
-void JBMaze::solve( JBMazePt** path, 
-                    int* pathLen ) 
-{
-  JBMaze::JBMAZE_SOLUTION* stack;
-  JBMaze::JBMAZE_SOLUTION* iter;
+long JBMaze::getMemoryUsage() {
+  long size;
 
-  int dirs;
-  int cx;
-  int cy;
-  int cz;
+  /* round up to a whole number of cache lines, so the block never shares
+   * its last line with anything else */
+
+  size = getCellCount();
+  return ( size + c_ALIGNMENT - 1 ) / c_ALIGNMENT * c_ALIGNMENT;
+}
+
+
+void JBMaze::solve( JBMazePt** path, int* pathLen, int method ) {
+  solve( m_start, m_end, path, pathLen, method );
+}
+
+
+void JBMaze::solve( const JBMazePt& from, const JBMazePt& to,
+                    JBMazePt** path, int* pathLen, int method )
+{
+  long start;
+  long meet;
+  long other;
+  long end;
+  int  headLen;
 
   *path = 0;
   *pathLen = 0;
 
-  if( ( m_maze == 0 ) || ( !m_deadendsClosed ) ) {
+  if( !m_solve( from, to, method, &start, &meet, &other, &end ) ) {
     return;
   }
 
-  /* put our starting position on the stack */
+  /* the path runs back from 'meet' to the start, and (if the search
+   * came from both ends) on from 'other' to the end */
 
-  cx = m_start.x;
-  cy = m_start.y;
-  cz = m_start.z;
+  headLen = m_traceLength( meet, start );
+  *pathLen = headLen + ( other >= 0 ? m_traceLength( other, end ) : 0 );
+  *path = (JBMazePt*)malloc( *pathLen * sizeof( JBMazePt ) );
 
-  stack = m_push( cx, cy, cz, 0 );
+  m_trace( meet, start, *path + headLen - 1, -1 );
+  if( other >= 0 ) {
+    m_trace( other, end, *path + headLen, 1 );
+  }
+}
 
-  /* loop while we have not reached the end point */
 
-  while( !( ( cx == m_end.x ) && ( cy == m_end.y ) && ( cz == m_end.z ) ) ) {
-    if( stack == 0 ) {
-      /* if we've run out of stack, then there is no solution to the maze.
-       * we have to just exit. */
-      return;
-    }
+void JBMaze::solve( JBMazePath* path, int method ) {
+  solve( m_start, m_end, path, method );
+}
 
-    /* test all possible directions from the given point, recursively.
-     * First, try north, then south, then east, etc, until all options
-     * have been tried, and if none of them worked, pop the stack and try
-     * with the previous position. */
-
-    dirs = m_maze[ cx ][ cy ][ cz ] & ~( stack->directions );
-    if( ( dirs & c_NORTH ) != 0 ) {
-      stack->directions |= c_NORTH;
-      if( cy > 0 ) {
-        cy--;
-        stack = m_push( cx, cy, cz, stack );
-        stack->directions |= c_SOUTH;
-      }
-    } else if( ( dirs & c_SOUTH ) != 0 ) {
-      stack->directions |= c_SOUTH;
-      if( cy+1 < m_y ) {
-        cy++;
-        stack = m_push( cx, cy, cz, stack );
-        stack->directions |= c_NORTH;
-      }
-    } else if( ( dirs & c_EAST ) != 0 ) {
-      stack->directions |= c_EAST;
-      if( cx+1 < m_x ) {
-        cx++;
-        stack = m_push( cx, cy, cz, stack );
-        stack->directions |= c_WEST;
-      }
-    } else if( ( dirs & c_WEST ) != 0 ) {
-      stack->directions |= c_WEST;
-      if( cx > 0 ) {
-        cx--;
-        stack = m_push( cx, cy, cz, stack );
-        stack->directions |= c_EAST;
-      }
-    } else if( ( dirs & c_UP ) != 0 ) {
-      stack->directions |= c_UP;
-      if( cz > 0 ) {
-        cz--;
-        stack = m_push( cx, cy, cz, stack );
-        stack->directions |= c_DOWN;
+
+void JBMaze::solve( const JBMazePt& from, const JBMazePt& to,
+                    JBMazePath* path, int method )
+{
+  long start;
+  long meet;
+  long other;
+  long end;
+  long headLen;
+  int  dir;
+
+  path->clear();
+
+  if( !m_solve( from, to, method, &start, &meet, &other, &end ) ) {
+    return;
+  }
+
+  headLen = m_traceLength( meet, start );
+  path->reset( from, headLen + ( other >= 0 ? m_traceLength( other, end ) : 0 ) );
+
+  m_tracePath( meet, start, path, headLen - 1, -1 );
+  if( other >= 0 ) {
+
+    /* the step across, from the side of the start to the side of the end */
+
+    for( dir = c_NORTH; dir <= c_DOWN; dir <<= 1 ) {
+      if( ( m_maze[ meet ] & dir ) && ( meet + m_solveOffsets[ dir ] == other ) ) {
+        path->setDirection( headLen - 1, dir );
+        break;
       }
-    } else if( ( dirs & c_DOWN ) != 0 ) {
-      stack->directions |= c_DOWN;
-      if( cz+1 < m_z ) {
-        cz++;
-        stack = m_push( cx, cy, cz, stack );
-        stack->directions |= c_UP;
+    }
+
+    m_tracePath( other, end, path, headLen, 1 );
+  }
+}
+
+
+void JBMaze::measure( JBMazeMetrics* metrics, int solve ) {
+  unsigned char kinds[ 0x40 ];
+  unsigned char* cells;
+  long* runs;
+  long  straightRun;
+  long  longest;
+  long  counts[ 4 ];
+  long  straight;
+  long  maskCells;
+  long  start;
+  long  meet;
+  long  other;
+  long  end;
+  int   exits;
+  int   kind;
+  int   x;
+  int   y;
+  int   z;
+
+  memset( metrics, 0, sizeof( *metrics ) );
+  if( m_maze == 0 ) {
+    return;
+  }
+
+  /* the number of exits of each set (capped at three, for junctions),
+   * with bit 4 set if the set is a straight corridor */
+
+  for( exits = 0; exits < 0x40; exits++ ) {
+    kinds[ exits ] = 0;
+    for( kind = 1; kind < 0x40; kind <<= 1 ) {
+      kinds[ exits ] += ( ( exits & kind ) != 0 );
+    }
+    if( kinds[ exits ] > 3 ) {
+      kinds[ exits ] = 3;
+    }
+    if( ( exits == ( c_NORTH | c_SOUTH ) ) || ( exits == ( c_WEST | c_EAST ) ) ||
+        ( exits == ( c_UP | c_DOWN ) ) )
+    {
+      kinds[ exits ] |= 0x4;
+    }
+  }
+
+  /* the run of passage reaching each cell from the west is kept as the row
+   * is scanned, and the run reaching it from the north, for every column */
+
+  runs = new long[ m_x ];
+  memset( counts, 0, sizeof( counts ) );
+  straight = 0;
+  longest = 0;
+
+  m_storage->advise( JBMazeStorage::c_SEQUENTIAL );
+
+  for( z = 0; z < m_z; z++ ) {
+    for( x = 0; x < m_x; x++ ) {
+      runs[ x ] = 0;
+    }
+
+    for( y = 0; y < m_y; y++ ) {
+      cells = m_maze + m_index( 0, y, z );
+      straightRun = 0;
+
+      for( x = 0; x < m_x; x++ ) {
+        exits = cells[ x ] & c_ALLDIRS;
+        kind = kinds[ exits ];
+        counts[ kind & 0x3 ]++;
+        straight += ( kind >> 2 );
+
+        /* a run goes on through a cell with an exit back along it, and
+         * starts over at any other (without a branch, so the scan never
+         * stalls on one) */
+
+        straightRun = straightRun * ( ( exits & c_WEST ) != 0 ) + ( exits != 0 );
+        runs[ x ] = runs[ x ] * ( ( exits & c_NORTH ) != 0 ) + ( exits != 0 );
+        longest = ( straightRun > longest ? straightRun : longest );
+        longest = ( runs[ x ] > longest ? runs[ x ] : longest );
       }
-    } else {
-      stack = m_pop( stack );
-      if( stack == 0 ) {
-        /* if the stack is empty, there is no solution! */
-        break;
+    }
+  }
+
+  delete[] runs;
+  m_storage->advise( m_advice );
+
+  /* every level has the same mask */
+
+  maskCells = m_mask->countValid( m_x, m_y );
+
+  metrics->cells = maskCells * m_z;
+  metrics->deadends = counts[ 1 ];
+  metrics->corridors = counts[ 2 ];
+  metrics->junctions = counts[ 3 ];
+  metrics->passages = counts[ 1 ] + counts[ 2 ] + counts[ 3 ];
+  metrics->straight = straight;
+  metrics->longest = longest;
+  metrics->coverage = ( metrics->cells > 0 ? (double)metrics->passages / metrics->cells : 0.0 );
+  metrics->river = ( metrics->corridors > 0 ? (double)straight / metrics->corridors : 0.0 );
+
+  if( solve && m_solve( m_start, m_end, c_SOLVE_BIDIRECTIONAL, &start, &meet, &other, &end ) ) {
+    metrics->solutionLength = m_traceLength( meet, start ) +
+                              ( other >= 0 ? m_traceLength( other, end ) : 0 );
+  }
+}
+
+
+int JBMaze::m_solve( const JBMazePt& from, const JBMazePt& to, int method,
+                     long* start, long* meet, long* other, long* end )
+{
+  m_nodesExpanded = 0;
+
+  if( ( m_maze == 0 ) || !m_contains( from ) || !m_contains( to ) ) {
+    return 0;
+  }
+
+  m_allocateSolver();
+
+  *start = m_index( from.x, from.y, from.z );
+  *end = m_index( to.x, to.y, to.z );
+  *meet = *end;
+  *other = -1;
+
+  if( *start == *end ) {
+    return 1;
+  }
+
+  if( method == c_SOLVE_BIDIRECTIONAL ) {
+
+    /* the searches met between 'meet' (reached from the start) and
+     * 'other' (reached from the end) */
+
+    return m_solveBidirectional( *start, *end, meet, other );
+  }
+
+  return m_solveBFS( *start, *end );
+}
+
+
+int JBMaze::m_solveBFS( long start, long end ) {
+  JBMAZE_QUEUE* queue;
+  unsigned int  generation;
+  long cell;
+  long next;
+  int  exits;
+  int  dir;
+
+  /* breadth-first search from the start.  A cell has been reached if its
+   * stamp is the current generation, and m_solveFrom then gives the
+   * direction that leads back toward the start. */
+
+  generation = m_nextSolveGeneration();
+  queue = &m_solveQueue[ 0 ];
+  queue->head = queue->count = 0;
+
+  m_solveStamp[ start ] = generation;
+  m_solveFrom[ start ] = c_MARK;
+  m_enqueue( queue, start );
+
+  while( queue->count > 0 ) {
+    cell = m_dequeue( queue );
+    m_nodesExpanded++;
+
+    if( cell == end ) {
+      return 1;
+    }
+
+    /* visit each exit in turn, except the one we came in by (which, in
+     * a perfect maze, is the only one that leads to a visited cell) */
+
+    exits = m_maze[ cell ] & c_ALLDIRS & ~m_solveFrom[ cell ];
+    while( exits != 0 ) {
+      dir = exits & -exits;
+      exits ^= dir;
+
+      next = cell + m_solveOffsets[ dir ];
+      if( m_solveStamp[ next ] == generation ) {
+        continue;
       }
-      cx = stack->x;
-      cy = stack->y;
-      cz = stack->z;
+
+      m_solveStamp[ next ] = generation;
+      m_solveFrom[ next ] = m_solveBack[ dir ];
+      m_enqueue( queue, next );
     }
   }
 
-  /* determine the number of items in the solution */
-  for( iter = stack, *pathLen = 0; iter != 0; (*pathLen)++, iter = iter->previous );
+  return 0;
+}
 
-  /* allocate the solution array */
-  *path = (JBMazePt*)malloc( *pathLen * sizeof( JBMazePt ) );
 
-  /* work backwards from the ends, populating the solution array */
-  for( cx = *pathLen-1; cx >= 0; cx-- ) {
-    (*path)[cx].x = stack->x;
-    (*path)[cx].y = stack->y;
-    (*path)[cx].z = stack->z;
-    stack = m_pop( stack );
+int JBMaze::m_solveBidirectional( long start, long end, long* meet, long* other ) {
+  JBMAZE_QUEUE* queue;
+  unsigned int  generation;
+  unsigned int  mine;
+  unsigned int  theirs;
+  long cell;
+  long next;
+  long level;
+  int  side;
+  int  exits;
+  int  dir;
+
+  /* search from both ends at once, a whole level at a time, always
+   * growing the side with the smaller frontier.  Cells reached from the
+   * start are stamped with the generation, and cells reached from the end
+   * with the generation plus one.  Because each side finishes one level
+   * before the other side takes its turn, the first time one side finds a
+   * cell reached by the other, the path through them is a shortest one. */
+
+  generation = m_nextSolveGeneration();
+
+  m_solveQueue[ 0 ].head = m_solveQueue[ 0 ].count = 0;
+  m_solveQueue[ 1 ].head = m_solveQueue[ 1 ].count = 0;
+
+  m_solveStamp[ start ] = generation;
+  m_solveFrom[ start ] = c_MARK;
+  m_enqueue( &m_solveQueue[ 0 ], start );
+
+  m_solveStamp[ end ] = generation + 1;
+  m_solveFrom[ end ] = c_MARK;
+  m_enqueue( &m_solveQueue[ 1 ], end );
+
+  while( ( m_solveQueue[ 0 ].count > 0 ) && ( m_solveQueue[ 1 ].count > 0 ) ) {
+    side = ( m_solveQueue[ 0 ].count <= m_solveQueue[ 1 ].count ? 0 : 1 );
+    queue = &m_solveQueue[ side ];
+    mine = generation + side;
+    theirs = generation + 1 - side;
+
+    for( level = queue->count; level > 0; level-- ) {
+      cell = m_dequeue( queue );
+      m_nodesExpanded++;
+
+      exits = m_maze[ cell ] & c_ALLDIRS & ~m_solveFrom[ cell ];
+      while( exits != 0 ) {
+        dir = exits & -exits;
+        exits ^= dir;
+
+        next = cell + m_solveOffsets[ dir ];
+        if( m_solveStamp[ next ] == theirs ) {
+          *meet = ( side == 0 ? cell : next );
+          *other = ( side == 0 ? next : cell );
+          return 1;
+        }
+        if( m_solveStamp[ next ] == mine ) {
+          continue;
+        }
+
+        m_solveStamp[ next ] = mine;
+        m_solveFrom[ next ] = m_solveBack[ dir ];
+        m_enqueue( queue, next );
+      }
+    }
   }
+
+  return 0;
 }
 
 
 void JBMaze::sparsify( int amount ) {
-  int i;
-  int x;
-  int y;
-  int z;
-  int dir;
+  beginSparsify( amount );
+  m_finishJob();
+}
 
-  if( m_maze == 0 ) {
+
+void JBMaze::beginSparsify( int amount ) {
+  int startZ;
+
+  m_finishJob();
+
+  if( ( m_maze == 0 ) || ( amount < 1 ) ) {
     return;
   }
 
-  for( i = 0; i < amount; i++ ) {
-    for( x = 0; x < m_x; x++ ) {
-      for( y = 0; y < m_y; y++ ) {
-        for( z = 0; z < m_z; z++ ) {
+  /* don't sparsify from the beginning and end points -- this guarantees
+   * that the solution to the maze (from solve()) will still be valid
+   * after calling sparsify().  (With c_COMPAT_SOLVE the beginning point is
+   * taken on the level of the end point, as it always used to be, so that
+   * a given seed still sparsifies the same way; the maze was solved before
+   * sparsifying then, so nothing depended on the beginning point.) */
 
-          /* don't sparsify from the beginning and end points -- this guarantees
-           * that the solution to the maze (from solve()) will still be valid
-           * after calling sparsify() */
+  startZ = ( ( m_compatibility & c_COMPAT_SOLVE ) != 0 ) ? m_end.z : m_start.z;
 
-          if( ( x == m_start.x ) && ( y == m_start.y ) && ( z == m_end.z ) ) {
-            continue;
-          }
-          if( ( x == m_end.x ) && ( y == m_end.y ) && ( z == m_end.z ) ) {
-            continue;
-          }
+  m_jobKeep[ 0 ] = m_jobKeep[ 1 ] = -1;
+  if( m_contains( JBMazePt( m_start.x, m_start.y, startZ ) ) ) {
+    m_jobKeep[ 0 ] = m_index( m_start.x, m_start.y, startZ );
+  }
+  if( m_contains( m_end ) ) {
+    m_jobKeep[ 1 ] = m_index( m_end.x, m_end.y, m_end.z );
+  }
 
-          /* if the indicated position (x,y,z) is a deadend (ie, there is
-           * only one direction out of it), then we "erase" the passage
-           * here and mark it as visited. */
-
-          dir = m_maze[ x ][ y ][ z ];
-          switch( dir ) {
-            case c_NORTH:
-            case c_SOUTH:
-            case c_WEST:
-            case c_EAST:
-            case c_UP:
-            case c_DOWN:
-              break;
-            default:
-              continue;
-          }
+  /* each round erases every deadend (a cell with only one way out) that
+   * the maze had when the round began.  Erasing a deadend can only make a
+   * deadend of the cell it led to, so rather than scanning the whole maze
+   * each round, the deadends for the next round are collected as the
+   * current round erases its own.  A cell that is no longer a deadend when
+   * its turn comes (because the cell it led to was erased first, leaving
+   * it with no way out at all) is simply skipped. */
+
+  m_jobQueue.capacity = c_QUEUE_SIZE;
+  m_jobQueue.cells = (long*)malloc( c_QUEUE_SIZE * sizeof( long ) );
+  m_jobQueue.head = m_jobQueue.count = 0;
+
+  m_findDeadends( &m_jobQueue, m_jobKeep );
+
+  m_job = c_JOB_SPARSIFY;
+  m_jobAmount = amount;
+  m_jobRound = 0;
+  m_jobRoundLeft = m_jobQueue.count;
+  m_jobTotal = m_jobQueue.count;
+}
 
-          m_maze[ x ][ y ][ z ] = 0;
-          if( ( dir & c_NORTH ) != 0 ) {
-            m_maze[ x ][ y - 1 ][ z ] &= ~c_SOUTH;
-            m_maze[ x ][ y - 1 ][ z ] |= c_MARK;
-          } else if( ( dir & c_SOUTH ) != 0 ) {
-            m_maze[ x ][ y + 1 ][ z ] &= ~c_NORTH;
-            m_maze[ x ][ y + 1 ][ z ] |= c_MARK;
-          } else if( ( dir & c_WEST ) != 0 ) {
-            m_maze[ x - 1 ][ y ][ z ] &= ~c_EAST;
-            m_maze[ x - 1 ][ y ][ z ] |= c_MARK;
-          } else if( ( dir & c_EAST ) != 0 ) {
-            m_maze[ x + 1 ][ y ][ z ] &= ~c_WEST;
-            m_maze[ x + 1 ][ y ][ z ] |= c_MARK;
-          } else if( ( dir & c_UP ) != 0 ) {
-            m_maze[ x ][ y ][ z - 1 ] &= ~c_DOWN;
-            m_maze[ x ][ y ][ z - 1 ] |= c_MARK;
-          } else if( ( dir & c_DOWN ) != 0 ) {
-            m_maze[ x ][ y ][ z + 1 ] &= ~c_UP;
-            m_maze[ x ][ y ][ z + 1 ] |= c_MARK;
-          }
-        }
+
+long JBMaze::m_stepSparsify( long budget ) {
+  long cell;
+  long next;
+  long erased;
+  int  dir;
+
+  long offsets[ 0x21 ];
+  unsigned char back[ 0x21 ];
+
+  for( dir = c_NORTH; dir <= c_DOWN; dir <<= 1 ) {
+    offsets[ dir ] = m_offset( dir );
+    back[ dir ] = m_opposite( dir );
+  }
+
+  erased = 0;
+  for( ;; ) {
+    if( m_jobRoundLeft == 0 ) {
+      m_jobRound++;
+      if( ( m_jobRound >= m_jobAmount ) || ( m_jobQueue.count == 0 ) ) {
+        m_endJob();
+        break;
       }
+      m_jobRoundLeft = m_jobQueue.count;
+    }
+
+    if( erased >= budget ) {
+      break;
+    }
+
+    m_jobRoundLeft--;
+    cell = m_dequeue( &m_jobQueue );
+
+    dir = m_maze[ cell ];
+    if( !m_isDeadend( dir ) ) {
+      continue;
     }
 
-    /* clear the marks so we're ready to go for another pass! */
-    m_clearMarks();
+    m_maze[ cell ] = 0;
+    erased++;
+
+    next = cell + offsets[ dir ];
+    m_maze[ next ] &= ~back[ dir ];
+
+    if( m_isDeadend( m_maze[ next ] ) && ( next != m_jobKeep[ 0 ] ) && ( next != m_jobKeep[ 1 ] ) ) {
+      m_enqueue( &m_jobQueue, next );
+      m_jobTotal++;
+    }
   }
+
+  return erased;
 }
 
 
 void JBMaze::clearDeadends( int percentage ) {
+  beginClearDeadends( percentage );
+  m_finishJob();
+}
+
+
+void JBMaze::beginClearDeadends( int percentage ) {
+  static const long none[ 2 ] = { -1, -1 };
+
+  m_finishJob();
+
+  memset( &m_deadendStats, 0, sizeof( m_deadendStats ) );
+
+  if( m_maze == 0 ) {
+    return;
+  }
+
+  m_phase = m_random.split( c_STREAM_DEADENDS );
+
+  m_job = c_JOB_DEADENDS;
+  m_jobAmount = percentage;
+
+  /* the random walk of c_COMPAT_DEADENDS has no queue, and is done all at
+   * once (counting a unit for every cell it scans) */
+
+  if( ( m_compatibility & c_COMPAT_DEADENDS ) != 0 ) {
+    m_jobTotal = getCellCount();
+    return;
+  }
+
+  m_allocateSolver();
+
+  /* index the deadends in one pass.  Connecting one deadend may connect
+   * another (by reaching it), so each is checked again when its turn
+   * comes. */
+
+  m_jobQueue.capacity = c_QUEUE_SIZE;
+  m_jobQueue.cells = (long*)malloc( c_QUEUE_SIZE * sizeof( long ) );
+  m_jobQueue.head = m_jobQueue.count = 0;
+
+  m_findDeadends( &m_jobQueue, none );
+
+  m_deadendStats.deadends = m_jobQueue.count;
+  m_jobTotal = m_jobQueue.count;
+}
+
+
+long JBMaze::m_stepDeadends( long budget ) {
+  long cell;
+  long looked;
+
+  if( m_jobQueue.cells == 0 ) {
+    m_walkDeadends( m_jobAmount );
+    m_endJob();
+    return getCellCount();
+  }
+
+  looked = 0;
+  while( ( m_jobQueue.count > 0 ) && ( looked < budget ) ) {
+    cell = m_dequeue( &m_jobQueue );
+    looked++;
+
+    if( !m_isDeadend( m_maze[ cell ] ) ) {
+      continue;
+    }
+
+    /* do we close this deadend, or not? */
+
+    if( m_phase.next( 100 ) + 1 > m_jobAmount ) {
+      continue;
+    }
+
+    if( m_planar() ) {
+      m_recordConnector( JBMazeCore< 2 >::connectDeadend( this, cell ) );
+    } else {
+      m_recordConnector( JBMazeCore< 3 >::connectDeadend( this, cell ) );
+    }
+  }
+
+  if( m_jobQueue.count == 0 ) {
+    m_endJob();
+  }
+
+  return looked;
+}
+
+
+void JBMaze::m_recordConnector( long length ) {
+
+  /* a length below zero is that of a connector that failed */
+
+  if( length <= 0 ) {
+    m_deadendStats.failed++;
+    length = ( length < 0 ? -length - 1 : 0 );
+  } else {
+    m_deadendStats.cleared++;
+  }
+
+  m_deadendStats.carved += length;
+  if( length > m_deadendStats.longest ) {
+    m_deadendStats.longest = length;
+  }
+}
+
+
+void JBMaze::m_walkDeadends( int percentage ) {
+  JBMazePt to;
   int x;
   int y;
   int z;
@@ -297,17 +724,13 @@ void JBMaze::clearDeadends( int percentage ) {
   int dir;
   int rdir = 0;
   int dirsTested;
-
-  if( m_maze == 0 ) {
-    return;
-  }
-
-  m_deadendsClosed = 0;
+  int open;
+  long length;
 
   for( x = 0; x < m_x; x++ ) {
     for( y = 0; y < m_y; y++ ) {
       for( z = 0; z < m_z; z++ ) {
-        dir = m_maze[ x ][ y ][ z ];
+        dir = m_maze[ m_index( x, y, z ) ];
         switch( dir ) {
           case c_NORTH:
           case c_SOUTH:
@@ -320,9 +743,11 @@ void JBMaze::clearDeadends( int percentage ) {
             continue;
         }
 
+        m_deadendStats.deadends++;
+
         /* do we close this deadend, or not? */
 
-        if( rand() % 100 + 1 > percentage ) {
+        if( m_phase.next( 100 ) + 1 > percentage ) {
           continue;
         }
 
@@ -332,16 +757,38 @@ void JBMaze::clearDeadends( int percentage ) {
         cx = x;
         cy = y;
         cz = z;
+        length = 0;
 
         do {
           dir = 0;
           dirsTested = 0;
-          
-          do {
+
+          if( ( m_compatibility & c_COMPAT_DIRECTIONS ) == 0 ) {
+
+            /* pick one of the directions we may go, with a single draw */
+
+            m_deadendStats.probes++;
+            open = m_walkDirections( cx, cy, cz );
+            if( open == 0 ) {
+              length = -length - 1;
+              break;
+            }
+
+            dir = ( 1 << m_phase.choose( open ) );
+            rdir = m_opposite( dir );
+            to = JBMazePt( cx, cy, cz );
+            m_move( dir, &to );
+            tx = to.x;
+            ty = to.y;
+            tz = to.z;
+          }
+
+          while( dir == 0 ) {
+            m_deadendStats.probes++;
             tx = cx;
             ty = cy;
             tz = cz;
-            switch( rand() % 6 ) {
+            switch( m_phase.next( 6 ) ) {
               case 0: if( cy > 0 ) { dir = c_NORTH; rdir = c_SOUTH; ty--; } 
                       else { dirsTested |= c_NORTH; } 
                       break;
@@ -361,7 +808,7 @@ void JBMaze::clearDeadends( int percentage ) {
                       else { dirsTested |= c_DOWN; } 
                       break;
             }
-            if( m_maze[ cx ][ cy ][ cz ] == dir ) {
+            if( m_maze[ m_index( cx, cy, cz ) ] == dir ) {
               dirsTested |= dir;
               dir = 0;
             }
@@ -372,257 +819,433 @@ void JBMaze::clearDeadends( int percentage ) {
             if( dirsTested == ( c_NORTH | c_SOUTH | c_WEST | c_EAST | c_UP | c_DOWN ) ) {
               break;
             }
-          } while( dir == 0 );
+          }
 
           if( dirsTested == ( c_NORTH | c_SOUTH | c_WEST | c_EAST | c_UP | c_DOWN ) ) {
+            length = -length - 1;
             break;
           }
 
-          m_maze[ cx ][ cy ][ cz ] |= dir;
-          m_maze[ tx ][ ty ][ tz ] |= rdir;
+          length++;
+          m_maze[ m_index( cx, cy, cz ) ] |= dir;
+          m_maze[ m_index( tx, ty, tz ) ] |= rdir;
 
           cx = tx;
           cy = ty;
           cz = tz;
-        } while( m_maze[ tx ][ ty ][ tz ] == rdir );
+        } while( m_maze[ m_index( tx, ty, tz ) ] == rdir );
+
+        /* a walk that was boxed in is recorded as having failed */
+        m_recordConnector( length );
       }
     }
   }
 }
 
 
+int JBMaze::m_walkDirections( int x, int y, int z ) {
+  JBMazePt to;
+  int open;
+  int dir;
+
+  /* a walk may go any way that stays within the maze and the mask, except
+   * back out of a deadend the way it came in */
+
+  open = 0;
+  for( dir = c_NORTH; dir <= c_DOWN; dir <<= 1 ) {
+    to = JBMazePt( x, y, z );
+    m_move( dir, &to );
+    if( m_contains( to ) && m_mask->getMaskAt( to.x, to.y ) &&
+        ( m_maze[ m_index( x, y, z ) ] != dir ) )
+    {
+      open |= dir;
+    }
+  }
+
+  return open;
+}
+
+
 void JBMaze::generate() {
-  unsigned long remaining;
-  int x;
-  int y;
-  int z;
-  int tx;
-  int ty;
-  int tz;
-  int directions;
-  int direction;
-  int allDirections;
-  int doRandomSelection;
-  int lastDirection = 0;
-  int straightStretch;
+  beginGenerate();
+  m_finishJob();
+}
+
+
+void JBMaze::beginGenerate() {
+  m_finishJob();
 
   if( m_maze == 0 ) {
     return;
   }
 
-  allDirections = c_NORTH | c_SOUTH | c_WEST | c_EAST | c_UP | c_DOWN;
-  straightStretch = 0;
-
-  /* compute how many valid points there are in the maze */
+  m_phase = m_random.split( c_STREAM_GENERATE );
+  m_job = c_JOB_GENERATE;
 
-  remaining = 0;
-  for( x = 0; x < m_x; x++ ) {
-    for( y = 0; y < m_y; y++ ) {
-      remaining += m_mask->getMaskAt( x, y );
+  if( m_generator != 0 ) {
+    m_generator->begin( this );
+  } else {
+    m_walk = new JBMazeWalk;
+    if( m_planar() ) {
+      JBMazeCore< 2 >::begin( this, m_walk );
+    } else {
+      JBMazeCore< 3 >::begin( this, m_walk );
     }
   }
-  remaining *= m_z;
-  remaining--;
-
-  /* find the point at which we want to start -- make sure the point we
-   * pick is within the mask. */
-
-  directions = 0;
-  do {
-    x = rand() % m_x;
-    y = rand() % m_y;
-    z = rand() % m_z;
-  } while( !m_mask->getMaskAt( x, y ) );
-
-  /* now, for each point remaining in the maze, we loop! */
-
-  while( remaining > 0 ) {
-    if( directions == allDirections ) {
-      
-      /* if we're stuck (boxed in or otherwise), choose another point, this
-       * time choosing one that has already been visited. */
-
-      do {
-        x = rand() % m_x;
-        y = rand() % m_y;
-        z = rand() % m_z;
-      } while( m_maze[ x ][ y ][ z ] == 0 );
-      directions = m_maze[ x ][ y ][ z ];
+}
+
+
+long JBMaze::m_stepGenerate( long budget ) {
+  long carved;
+
+  if( m_generator != 0 ) {
+    carved = m_generator->step( this, budget );
+    if( m_generator->getRemaining() == 0 ) {
+      m_endJob();
     }
+    return carved;
+  }
 
-    /* eliminate obviously impossible directions */
+  if( m_planar() ) {
+    carved = JBMazeCore< 2 >::step( this, m_walk, budget );
+  } else {
+    carved = JBMazeCore< 3 >::step( this, m_walk, budget );
+  }
+  if( m_walk->remaining == 0 ) {
+    m_endJob();
+  }
 
-    if( x < 1 ) directions |= c_WEST;
-    if( x+1 >= m_x ) directions |= c_EAST;
-    if( y < 1 ) directions |= c_NORTH;
-    if( y+1 >= m_y ) directions |= c_SOUTH;
-    if( z < 1 ) directions |= c_UP;
-    if( z+1 >= m_z ) directions |= c_DOWN;
+  return carved;
+}
 
-    doRandomSelection = 0;
 
-    if( rand() % 100 < m_randomness ) {
-      /* choose a direction at random */
-      doRandomSelection = 1;
-    } else {
-      /* otherwise, move, based on the direction last chosen.  Note that we're
-       * only allowing a straight stretch that is less than half as long as the
-       * relevant dimension of the maze. */
-
-      switch( lastDirection ) {
-        case c_NORTH:
-          if( ( straightStretch < ( m_y >> 1 ) ) && ( y > 0 ) && ( m_maze[ x ][ y-1 ][ z ] == 0 ) && ( m_mask->getMaskAt( x, y-1 ) ) ) {
-            direction = lastDirection;
-          } else {
-            doRandomSelection = 1;
-          }
-          break;
-        case c_SOUTH:
-          if( ( straightStretch < ( m_y >> 1 ) ) && ( y+1 < m_y ) && ( m_maze[ x ][ y+1 ][ z ] == 0 ) && ( m_mask->getMaskAt( x, y+1 ) ) ) {
-            direction = lastDirection;
-          } else {
-            doRandomSelection = 1;
-          }
-          break;
-        case c_WEST:
-          if( ( straightStretch < ( m_x >> 1 ) ) && ( x > 0 ) && ( m_maze[ x-1 ][ y ][ z ] == 0 ) && ( m_mask->getMaskAt( x-1, y ) ) ) {
-            direction = lastDirection;
-          } else {
-            doRandomSelection = 1;
-          }
-          break;
-        case c_EAST:
-          if( ( straightStretch < ( m_x >> 1 ) ) && ( x+1 < m_x ) && ( m_maze[ x+1 ][ y ][ z ] == 0 ) && ( m_mask->getMaskAt( x+1, y ) ) ) {
-            direction = lastDirection;
-          } else {
-            doRandomSelection = 1;
-          }
-          break;
-        case c_UP:
-          if( ( straightStretch < ( m_z >> 1 ) ) && ( z > 0 ) && ( m_maze[ x ][ y ][ z-1 ] == 0 ) ) {
-            direction = lastDirection;
-          } else {
-            doRandomSelection = 1;
-          }
-          break;
-        case c_DOWN:
-          if( ( straightStretch < ( m_z >> 1 ) ) && ( z+1 < m_z ) && ( m_maze[ x ][ y ][ z+1 ] == 0 ) ) {
-            direction = lastDirection;
-          } else {
-            doRandomSelection = 1;
-          }
-          break;
-        default:
-          doRandomSelection = 1;
-      }
-    }
+long JBMaze::step( long budget ) {
+  if( budget < 1 ) {
+    return 0;
+  }
 
-    if( doRandomSelection ) {
-      /* reset the straight stretch count */
-
-      straightStretch = 0;
-      direction = 0;
-
-      /* pick a random direction */
-
-      while( ( direction == 0 ) || ( ( directions & direction ) != 0 ) ) {
-        tx = x;
-        ty = y;
-        tz = z;
-        switch( rand() % 6 ) {
-          case 0: if( y > 0 ) { direction = c_NORTH; ty--; } else { directions |= c_NORTH; } break;
-          case 1: if( y+1 < m_y ) { direction = c_SOUTH; ty++; } else { directions |= c_SOUTH; }  break;
-          case 2: if( x > 0 ) { direction = c_WEST; tx--; } else { directions |= c_WEST; }  break;
-          case 3: if( x+1 < m_x ) { direction = c_EAST; tx++; } else { directions |= c_EAST; }  break;
-          case 4: if( z > 0 ) { direction = c_UP; tz--; } else { directions |= c_UP; }  break;
-          case 5: if( z+1 < m_z ) { direction = c_DOWN; tz++; } else { directions |= c_DOWN; }  break;
-        }
-        if( ( !m_mask->getMaskAt( tx, ty ) ) || ( m_maze[ tx ][ ty ][ tz ] != 0 ) ) {
-          directions |= direction;
-          if( directions == allDirections ) {
-            break;
-          }
-          direction = 0;
-        }
-      }
+  if( m_job == c_JOB_GENERATE ) {
+    return m_stepGenerate( budget );
+  } else if( m_job == c_JOB_SPARSIFY ) {
+    return m_stepSparsify( budget );
+  } else if( m_job == c_JOB_DEADENDS ) {
+    return m_stepDeadends( budget );
+  }
+
+  return 0;
+}
+
+
+long JBMaze::getRemaining() {
+  if( m_job == c_JOB_GENERATE ) {
+    return ( m_walk != 0 ? m_walk->remaining : m_generator->getRemaining() );
+  } else if( m_job != c_JOB_NONE ) {
+    return ( m_jobQueue.cells != 0 ? m_jobQueue.count : m_jobTotal );
+  }
+
+  return 0;
+}
+
+
+long JBMaze::getTotal() {
+  if( m_job == c_JOB_GENERATE ) {
+    return ( m_walk != 0 ? m_walk->total : m_generator->getTotal() );
+  } else if( m_job != c_JOB_NONE ) {
+    return m_jobTotal;
+  }
+
+  return 0;
+}
+
+
+void JBMaze::m_finishJob() {
+  while( m_job != c_JOB_NONE ) {
+    step( LONG_MAX );
+  }
+}
+
+
+void JBMaze::m_endJob() {
+  if( m_walk != 0 ) {
+    if( m_planar() ) {
+      JBMazeCore< 2 >::end( this, m_walk );
     } else {
-      straightStretch++;
+      JBMazeCore< 3 >::end( this, m_walk );
     }
+    delete m_walk;
+    m_walk = 0;
+  }
 
-    if( directions == allDirections ) {
-      /* if we've tested all directions, then we are stuck.  Continue to the
-       * top of the loop, where we will select a new point to search from. */
-      continue;
-    }
+  free( m_jobQueue.cells );
+  m_jobQueue.cells = 0;
+  m_jobQueue.head = m_jobQueue.count = 0;
 
-    /* set the given direction in the maze, both at the point of origin and
-     * the point of destination. */
-
-    lastDirection = direction;
-    m_maze[ x ][ y ][ z ] |= direction;
-    switch( direction ) {
-      case c_NORTH: y--; direction = c_SOUTH; break;
-      case c_SOUTH: y++; direction = c_NORTH; break;
-      case c_WEST: x--; direction = c_EAST; break;
-      case c_EAST: x++; direction = c_WEST; break;
-      case c_UP: z--; direction = c_DOWN; break;
-      case c_DOWN: z++; direction = c_UP; break;
-    }
-    m_maze[ x ][ y ][ z ] |= direction;
-    directions = m_maze[ x ][ y ][ z ];
+  m_job = c_JOB_NONE;
+}
+
+
+int JBMaze::m_contains( const JBMazePt& pt ) {
+  return ( ( pt.x >= 0 ) && ( pt.y >= 0 ) && ( pt.z >= 0 ) &&
+           ( pt.x < m_x ) && ( pt.y < m_y ) && ( pt.z < m_z ) );
+}
+
+
+long JBMaze::m_offset( int direction ) {
+  if( direction == c_NORTH ) return -(long)m_x;
+  if( direction == c_SOUTH ) return m_x;
+  if( direction == c_WEST ) return -1;
+  if( direction == c_EAST ) return 1;
+  if( direction == c_UP ) return -(long)m_x * m_y;
+  if( direction == c_DOWN ) return (long)m_x * m_y;
+  return 0;
+}
+
+
+int JBMaze::m_opposite( int direction ) {
+  if( direction == c_NORTH ) return c_SOUTH;
+  if( direction == c_SOUTH ) return c_NORTH;
+  if( direction == c_WEST ) return c_EAST;
+  if( direction == c_EAST ) return c_WEST;
+  if( direction == c_UP ) return c_DOWN;
+  if( direction == c_DOWN ) return c_UP;
+  return 0;
+}
+
+
+void JBMaze::m_move( int direction, JBMazePt* pt ) {
+  if( direction == c_NORTH ) pt->y--;
+  else if( direction == c_SOUTH ) pt->y++;
+  else if( direction == c_WEST ) pt->x--;
+  else if( direction == c_EAST ) pt->x++;
+  else if( direction == c_UP ) pt->z--;
+  else if( direction == c_DOWN ) pt->z++;
+}
+
+
+void JBMaze::m_point( long cell, JBMazePt* pt ) {
+  pt->x = (int)( cell % m_x );
+  pt->y = (int)( ( cell / m_x ) % m_y );
+  pt->z = (int)( cell / ( (long)m_x * m_y ) );
+}
 
-    /* decrement the number of points remaining */
 
-    remaining--;
+void JBMaze::m_allocateSolver() {
+  long cells;
+  int  dir;
+  int  i;
+
+  if( m_solveStamp != 0 ) {
+    return;
+  }
+
+  cells = getCellCount();
+
+  m_solveStorage = m_allocateScratch( ".solve", cells * ( sizeof( unsigned int ) + 1 ) );
+  m_solveStorage->advise( JBMazeStorage::c_RANDOM );
+  m_solveStamp = (unsigned int*)m_solveStorage->getBlock();
+  m_solveFrom = (unsigned char*)( m_solveStamp + cells );
+  m_solveGeneration = 0;
+
+  for( i = 0; i < 2; i++ ) {
+    m_solveQueue[ i ].capacity = c_QUEUE_SIZE;
+    m_solveQueue[ i ].cells = (long*)malloc( c_QUEUE_SIZE * sizeof( long ) );
+    m_solveQueue[ i ].head = m_solveQueue[ i ].count = 0;
+  }
+
+  for( dir = c_NORTH; dir <= c_DOWN; dir <<= 1 ) {
+    m_solveOffsets[ dir ] = m_offset( dir );
+    m_solveBack[ dir ] = m_opposite( dir );
+  }
+}
+
+
+void JBMaze::m_deallocateSolver() {
+  delete m_solveStorage;
+  free( m_solveQueue[ 0 ].cells );
+  free( m_solveQueue[ 1 ].cells );
+
+  m_solveStorage = 0;
+  m_solveStamp = 0;
+  m_solveFrom = 0;
+  m_solveQueue[ 0 ].cells = m_solveQueue[ 1 ].cells = 0;
+}
+
+
+unsigned int JBMaze::m_nextSolveGeneration() {
+
+  /* each search uses two stamps (one per side of a bidirectional search).
+   * Only when the stamps run out do they have to be cleared. */
+
+  if( m_solveGeneration >= 0xFFFFFFF0u ) {
+    memset( m_solveStamp, 0, getCellCount() * sizeof( unsigned int ) );
+    m_solveGeneration = 0;
   }
+
+  m_solveGeneration += 2;
+  return m_solveGeneration;
 }
 
 
-JBMaze::JBMAZE_SOLUTION* JBMaze::m_push( int x, int y, int z, JBMAZE_SOLUTION* stack ) {
-  JBMaze::JBMAZE_SOLUTION* newItem;
+void JBMaze::m_enqueue( JBMAZE_QUEUE* queue, long cell ) {
+  long* grown;
+  long  i;
 
-  newItem = new JBMaze::JBMAZE_SOLUTION;
-  newItem->x = x;
-  newItem->y = y;
-  newItem->z = z;
-  newItem->directions = 0;
-  newItem->previous = stack;
+  if( queue->count == queue->capacity ) {
+    grown = (long*)malloc( queue->capacity * 2 * sizeof( long ) );
+    for( i = 0; i < queue->count; i++ ) {
+      grown[ i ] = queue->cells[ ( queue->head + i ) & ( queue->capacity - 1 ) ];
+    }
+    free( queue->cells );
+    queue->cells = grown;
+    queue->head = 0;
+    queue->capacity *= 2;
+  }
 
-  return newItem;
+  queue->cells[ ( queue->head + queue->count ) & ( queue->capacity - 1 ) ] = cell;
+  queue->count++;
 }
 
 
-JBMaze::JBMAZE_SOLUTION* JBMaze::m_pop( JBMAZE_SOLUTION* stack ) {
-  JBMaze::JBMAZE_SOLUTION* next;
+long JBMaze::m_dequeue( JBMAZE_QUEUE* queue ) {
+  long cell;
 
-  next = stack->previous;
-  delete stack;
+  cell = queue->cells[ queue->head ];
+  queue->head = ( queue->head + 1 ) & ( queue->capacity - 1 );
+  queue->count--;
 
-  return next;
+  return cell;
 }
 
 
-void JBMaze::m_clearMarks() {
-  int i;
-  int j;
-  int k;
+int JBMaze::m_traceLength( long cell, long stop ) {
+  int length;
 
-  if( m_maze == 0 ) {
+  for( length = 1; cell != stop; length++ ) {
+    cell += m_solveOffsets[ m_solveFrom[ cell ] ];
+  }
+
+  return length;
+}
+
+
+void JBMaze::m_trace( long cell, long stop, JBMazePt* path, int step ) {
+  for( ;; path += step ) {
+    m_point( cell, path );
+    if( cell == stop ) {
+      break;
+    }
+    cell += m_solveOffsets[ m_solveFrom[ cell ] ];
+  }
+}
+
+
+void JBMaze::m_tracePath( long cell, long stop, JBMazePath* path, long index, int step ) {
+  int dir;
+
+  /* m_solveFrom gives the way back toward the stop cell, which is the
+   * way the path goes when it is traced forward, and the opposite way
+   * when it is traced backward */
+
+  for( ; cell != stop; index += step ) {
+    dir = m_solveFrom[ cell ];
+    if( step < 0 ) {
+      path->setDirection( index - 1, m_solveBack[ dir ] );
+    } else {
+      path->setDirection( index, dir );
+    }
+    cell += m_solveOffsets[ dir ];
+  }
+}
+
+
+void JBMaze::m_findDeadends( JBMAZE_QUEUE* queue, const long* keep ) {
+  uint64_t bits;
+  long rows;
+  long row;
+  long cell;
+  int  words;
+  int  word;
+
+  /* a mapped maze may be larger than memory, and the bitplanes with it,
+   * so its cells are scanned directly, in the order they lie in the file.
+   * So are those of a branch, which would otherwise need bitplanes of its
+   * own for every cell it shares. */
+
+  if( m_storage->isMapped() || m_storage->isPrivate() ) {
+    m_storage->advise( JBMazeStorage::c_SEQUENTIAL );
+    for( cell = 0; cell < getCellCount(); cell++ ) {
+      if( m_isDeadend( m_maze[ cell ] ) && ( cell != keep[ 0 ] ) && ( cell != keep[ 1 ] ) ) {
+        m_enqueue( queue, cell );
+      }
+    }
+    m_storage->advise( m_advice );
     return;
   }
 
-  for( i = 0; i < m_x; i++ ) {
-    for( j = 0; j < m_y; j++ ) {
-      for( k = 0; k < m_z; k++ ) {
-        m_maze[ i ][ j ][ k ] &= ~c_MARK;
+  /* find the deadends 64 cells at a time, in the bitplanes, and then
+   * visit only the bits that are set */
+
+  if( m_planes == 0 ) {
+    m_planes = new JBMazePlanes( m_x, m_y, m_z );
+  }
+  m_planes->mirror( m_maze );
+
+  rows = m_planes->getRowCount();
+  words = m_planes->getWordsPerRow();
+
+  for( row = 0; row < rows; row++ ) {
+    for( word = 0; word < words; word++ ) {
+      for( bits = m_planes->getDeadends( row, word ); bits != 0; bits &= bits - 1 ) {
+        cell = row * m_x + word * 64 + __builtin_ctzll( bits );
+        if( ( cell != keep[ 0 ] ) && ( cell != keep[ 1 ] ) ) {
+          m_enqueue( queue, cell );
+        }
       }
     }
   }
 }
 
 
+int JBMaze::m_planar() {
+
+  /* a legacy random stream must draw its numbers exactly as it always has,
+   * six directions at a time */
+
+  return ( ( m_z == 1 ) && !m_generic && ( ( m_compatibility & c_COMPAT_RANDOM ) == 0 ) );
+}
+
+
+int JBMaze::m_isDeadend( int exits ) {
+  return ( ( exits != 0 ) && ( ( exits & ( exits - 1 ) ) == 0 ) && ( ( exits & ~c_ALLDIRS ) == 0 ) );
+}
+
+
+void JBMaze::setCompatibility( int flags ) {
+  m_compatibility = flags;
+  m_random.seed( m_seed, ( ( flags & c_COMPAT_RANDOM ) != 0 ? JBRandom::c_LEGACY : JBRandom::c_XOSHIRO ) );
+}
+
+
+void JBMaze::setAlgorithm( int algorithm ) {
+  setGenerator( JBMazeGenerator::create( algorithm ) );
+}
+
+
+void JBMaze::setGenerator( JBMazeGenerator* generator ) {
+  m_endJob();
+  if( generator != m_generator ) {
+    delete m_generator;
+  }
+  m_generator = generator;
+  m_algorithm = ( generator != 0 ? JBMazeGenerator::findAlgorithm( generator->getName() ) : c_HUNTANDKILL );
+}
+
+
 void JBMaze::setMask( JBMazeMask* mask ) {
-  delete m_mask;
+  m_endJob();
+  if( m_mask != 0 ) {
+    m_mask->release();
+  }
   m_mask = mask;
 
   m_deallocateMaze();
@@ -632,38 +1255,91 @@ void JBMaze::setMask( JBMazeMask* mask ) {
 }
 
 
-void JBMaze::m_deallocateMaze() {
-  int i;
-  int j;
+void JBMaze::m_allocateFrontier() {
+  long count;
 
-  if( m_maze != 0 ) {
-    for( i = 0; i < m_x; i++ ) {
-      for( j = 0; j < m_y; j++ ) {
-        delete[] m_maze[ i ][ j ];
-      }
-      delete[] m_maze[ i ];
-    }
-    delete[] m_maze;
-  }
+  m_deallocateFrontier();
+
+  count = getCellCount();
+  m_frontierStorage = m_allocateScratch( ".frontier", count * 2 * sizeof( long ) );
+  m_frontier = (long*)m_frontierStorage->getBlock();
+  m_frontierPos = m_frontier + count;
+  memset( m_frontierPos, 0xFF, count * sizeof( long ) );
+  m_frontierCount = 0;
+}
+
+
+void JBMaze::m_deallocateFrontier() {
+  delete m_frontierStorage;
 
+  m_frontierStorage = 0;
+  m_frontier = 0;
+  m_frontierPos = 0;
+  m_frontierCount = 0;
+}
+
+
+void JBMaze::m_deallocateMaze() {
+  m_deallocateSolver();
+  delete m_planes;
+  m_planes = 0;
+  delete m_storage;
+  m_storage = 0;
   m_maze = 0;
 }
 
 
 void JBMaze::m_allocateMaze() {
-  int i;
-  int j;
-
   if( m_maze != 0 ) {
     m_deallocateMaze();
   }
 
-  m_maze = new int**[ m_x ];
-  for( i = 0; i < m_x; i++ ) {
-    m_maze[ i ] = new int*[ m_y ];
-    for( j = 0; j < m_y; j++ ) {
-      m_maze[ i ][ j ] = new int[ m_z ];
-      memset( m_maze[ i ][ j ], 0, m_z * sizeof( int ) );
-    }
+  /* the whole maze lives in a single block, one byte per cell, aligned to
+   * a cache line (or a page, if it is mapped) so that rows start on
+   * predictable boundaries. */
+
+  m_storage = new JBMazeStorage( m_storagePath, getMemoryUsage(), m_storageTemporary );
+  m_maze = (unsigned char*)m_storage->getBlock();
+  m_storage->advise( m_advice );
+}
+
+
+JBMazeStorage* JBMaze::m_allocateScratch( const char* suffix, long size ) {
+  JBMazeStorage* scratch;
+  char*          path;
+
+  if( m_storagePath == 0 ) {
+    return new JBMazeStorage( 0, size );
+  }
+
+  path = (char*)malloc( strlen( m_storagePath ) + strlen( suffix ) + 1 );
+  strcpy( path, m_storagePath );
+  strcat( path, suffix );
+
+  scratch = new JBMazeStorage( path, size, 1 );
+  free( path );
+
+  return scratch;
+}
+
+
+void JBMaze::setStorage( const char* path, int temporary ) {
+  m_endJob();
+  m_deallocateMaze();
+
+  free( m_storagePath );
+  m_storagePath = ( path != 0 ? strdup( path ) : 0 );
+  m_storageTemporary = temporary;
+
+  if( ( m_x > 0 ) && ( m_y > 0 ) && ( m_z > 0 ) ) {
+    m_allocateMaze();
+  }
+}
+
+
+void JBMaze::setAdvice( int advice ) {
+  m_advice = advice;
+  if( m_storage != 0 ) {
+    m_storage->advise( m_advice );
   }
 }
@@ -0,0 +1,263 @@
+/* ---------------------------------------------------------------------- *
+ * This file is in the public domain, and may be used, modified, and
+ * distributed without restriction.
+ * ---------------------------------------------------------------------- *
+ * JBMazeBatch
+ *
+ * Author: Jamis Buck <jamis@jamisbuck.org>
+ * Homepage: http://github.com/jamis/dnd-dungeon
+ * ---------------------------------------------------------------------- */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "jbmazebatch.h"
+#include "jbrandom.h"
+
+const int JBMazeBatch::c_MAX_LANES = 16;
+const int JBMazeBatch::c_MAX_CELLS = 1 << 20;
+
+
+JBMazeBatch::JBMazeBatch( int x, int y, int lanes, int randomness ) {
+  long cells;
+  long cell;
+  int  i;
+
+  m_x = ( x < 1 ? 1 : x );
+  m_y = ( y < 1 ? 1 : y );
+  if( (long)m_x * m_y > c_MAX_CELLS ) {
+    m_y = c_MAX_CELLS / m_x;
+  }
+  m_lanes = ( lanes < 1 ? 1 : ( lanes > c_MAX_LANES ? c_MAX_LANES : lanes ) );
+  m_randomness = randomness;
+
+  cells = getCellCount();
+
+  /* a row of guard cells above and below the mazes lets a step look at
+   * every neighbor of a cell without checking first whether it is there.
+   * The guards look visited, so they are never chosen. */
+
+  m_block = new unsigned char[ ( cells + 2 * m_x ) * m_lanes ];
+  memset( m_block, 0xFF, ( cells + 2 * m_x ) * m_lanes );
+  m_cells = m_block + m_x * m_lanes;
+
+  m_bounds = new unsigned char[ cells ];
+  for( cell = 0; cell < cells; cell++ ) {
+    m_bounds[ cell ] = 0;
+    if( cell >= m_x ) m_bounds[ cell ] |= JBMaze::c_NORTH;
+    if( cell + m_x < cells ) m_bounds[ cell ] |= JBMaze::c_SOUTH;
+    if( cell % m_x > 0 ) m_bounds[ cell ] |= JBMaze::c_WEST;
+    if( cell % m_x + 1 < m_x ) m_bounds[ cell ] |= JBMaze::c_EAST;
+  }
+
+  memset( m_offsets, 0, sizeof( m_offsets ) );
+  m_offsets[ JBMaze::c_NORTH ] = -m_x;
+  m_offsets[ JBMaze::c_SOUTH ] = m_x;
+  m_offsets[ JBMaze::c_WEST ] = -1;
+  m_offsets[ JBMaze::c_EAST ] = 1;
+  for( i = 0; i < 0x09; i++ ) {
+    m_steps[ i ] = m_offsets[ i ] * m_lanes;
+  }
+
+  memset( m_limits, 0, sizeof( m_limits ) );
+  m_limits[ JBMaze::c_NORTH ] = m_limits[ JBMaze::c_SOUTH ] = m_y >> 1;
+  m_limits[ JBMaze::c_WEST ] = m_limits[ JBMaze::c_EAST ] = m_x >> 1;
+
+  /* the directions in each set of exits, in order, so a step can pick
+   * one with a multiply instead of a loop over the bits */
+
+  for( i = 0; i < 0x10; i++ ) {
+    int dir;
+
+    m_counts[ i ] = 0;
+    memset( m_choices[ i ], 0, sizeof( m_choices[ i ] ) );
+    for( dir = 1; dir < 0x10; dir <<= 1 ) {
+      if( i & dir ) {
+        m_choices[ i ][ m_counts[ i ]++ ] = dir;
+      }
+    }
+  }
+
+  m_state = new uint64_t[ 4 * m_lanes ];
+  m_draws = new uint64_t[ m_lanes ];
+  m_stacks = new int[ ( cells + 1 ) * m_lanes ];
+  m_depth = new int[ m_lanes ];
+  m_last = new int[ m_lanes ];
+  m_stretch = new int[ m_lanes ];
+
+  for( i = 0; i < m_lanes; i++ ) {
+    m_depth[ i ] = 0;
+  }
+}
+
+
+JBMazeBatch::~JBMazeBatch() {
+  delete[] m_block;
+  delete[] m_bounds;
+  delete[] m_state;
+  delete[] m_draws;
+  delete[] m_stacks;
+  delete[] m_depth;
+  delete[] m_last;
+  delete[] m_stretch;
+}
+
+
+void JBMazeBatch::generate( long seed ) {
+  long seeds[ c_MAX_LANES ];
+  int  i;
+
+  for( i = 0; i < m_lanes; i++ ) {
+    seeds[ i ] = seed + i;
+  }
+
+  generate( seeds );
+}
+
+
+void JBMazeBatch::generate( const long* seeds ) {
+  long cells;
+  long steps;
+  long step;
+  int  lane;
+
+  cells = getCellCount();
+  memset( m_cells, 0, cells * m_lanes );
+
+  /* each lane's stream is seeded as JBRandom seeds a stream, but is kept
+   * here, one word of state for every lane side by side, so that a single
+   * pass draws a number for every lane */
+
+  for( lane = 0; lane < m_lanes; lane++ ) {
+    JBRandom random( seeds[ lane ] );
+    uint64_t draw;
+    int      word;
+
+    for( word = 0; word < 4; word++ ) {
+      draw = (uint64_t)random.next( 0x10000 ) << 48;
+      draw |= (uint64_t)random.next( 0x10000 ) << 32;
+      draw |= (uint64_t)random.next( 0x10000 ) << 16;
+      draw |= (uint64_t)random.next( 0x10000 );
+      m_state[ word * m_lanes + lane ] = draw;
+    }
+    m_state[ lane ] |= 1;
+
+    m_stacks[ lane * ( cells + 1 ) ] = (int)random.next( cells );
+    m_depth[ lane ] = 1;
+    m_last[ lane ] = 0;
+    m_stretch[ lane ] = 0;
+  }
+
+  /* every cell is stepped into once and back out of once, except the
+   * first, which is only stepped out of */
+
+  steps = 2 * cells - 1;
+  for( step = 0; step < steps; step++ ) {
+    m_step();
+  }
+}
+
+
+void JBMazeBatch::m_step() {
+  uint64_t* s0 = m_state;
+  uint64_t* s1 = m_state + m_lanes;
+  uint64_t* s2 = m_state + 2 * m_lanes;
+  uint64_t* s3 = m_state + 3 * m_lanes;
+  uint64_t  t;
+  uint64_t  draw;
+  unsigned char* grid;
+  unsigned char* bounds;
+  unsigned char* at;
+  int* stacks;
+  int* stack;
+  int* depths;
+  int* lasts;
+  int* stretches;
+  long cells;
+  long north, south, west, east;
+  int  lanes;
+  int  randomness;
+  int  n, s, w, e;
+  int  lane;
+  int  depth;
+  int  cell;
+  int  open;
+  int  last;
+  int  straight;
+  int  dir;
+
+  /* one xoshiro256** draw for every lane.  There are no branches here, so
+   * the compiler is free to do several lanes at once. */
+
+  for( lane = 0; lane < m_lanes; lane++ ) {
+    m_draws[ lane ] = m_rotate( s1[ lane ] * 5, 7 ) * 9;
+    t = s1[ lane ] << 17;
+    s2[ lane ] ^= s0[ lane ];
+    s3[ lane ] ^= s1[ lane ];
+    s1[ lane ] ^= s2[ lane ];
+    s0[ lane ] ^= s3[ lane ];
+    s2[ lane ] ^= t;
+    s3[ lane ] = m_rotate( s3[ lane ], 45 );
+  }
+
+  /* then one step of every lane.  A lane with nowhere to go chooses
+   * direction 0, which carves nothing and pops its stack, so a step never
+   * branches on what the maze looks like, and the lanes (which do not
+   * depend on one another) overlap in the processor. */
+
+  /* everything the loop reads that a store to a cell could (as far as
+   * the compiler knows) change is copied into locals first */
+
+  cells = getCellCount();
+  lanes = m_lanes;
+  randomness = m_randomness;
+  grid = m_cells;
+  bounds = m_bounds;
+  stacks = m_stacks;
+  depths = m_depth;
+  lasts = m_last;
+  stretches = m_stretch;
+  n = JBMaze::c_NORTH;
+  s = JBMaze::c_SOUTH;
+  w = JBMaze::c_WEST;
+  e = JBMaze::c_EAST;
+  north = m_steps[ n ];
+  south = m_steps[ s ];
+  west = m_steps[ w ];
+  east = m_steps[ e ];
+
+  for( lane = 0; lane < lanes; lane++ ) {
+    stack = stacks + lane * ( cells + 1 );
+    depth = depths[ lane ];
+    cell = stack[ depth - 1 ];
+    at = grid + (long)cell * lanes + lane;
+
+    /* the neighbors that have no exits have not been visited */
+
+    open = ( ( at[ north ] == 0 ) * n ) | ( ( at[ south ] == 0 ) * s ) |
+           ( ( at[ west ] == 0 ) * w ) | ( ( at[ east ] == 0 ) * e );
+    open &= bounds[ cell ];
+
+    /* keep going straight, or bend, by the same rule JBMazeGenerator
+     * uses; the high half of the draw decides which, and the low half
+     * picks the bend */
+
+    last = lasts[ lane ];
+    draw = m_draws[ lane ];
+    straight = -( ( ( open & last ) != 0 ) &
+                  ( (int)( ( ( draw >> 32 ) * 100 ) >> 32 ) >= randomness ) &
+                  ( stretches[ lane ] < m_limits[ last ] ) );
+    dir = m_choices[ open ][ ( ( draw & 0xFFFFFFFFULL ) * m_counts[ open ] ) >> 32 ];
+    dir = ( last & straight ) | ( dir & ~straight );
+    stretches[ lane ] = ( stretches[ lane ] + 1 ) & straight;
+
+    /* the opposite of each direction is its neighboring bit */
+
+    at[ 0 ] |= dir;
+    at[ m_steps[ dir ] ] |= ( ( dir & 0x5 ) << 1 ) | ( ( dir & 0xA ) >> 1 );
+
+    stack[ depth ] = cell + m_offsets[ dir ];
+    depths[ lane ] = depth + 2 * ( dir != 0 ) - 1;
+    lasts[ lane ] = dir;
+  }
+}
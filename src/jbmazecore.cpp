@@ -0,0 +1,525 @@
+/* ---------------------------------------------------------------------- *
+ * This file is in the public domain, and may be used, modified, and
+ * distributed without restriction.
+ * ---------------------------------------------------------------------- *
+ * JBMazeCore
+ *
+ * Author: Jamis Buck <jamis@jamisbuck.org>
+ * Homepage: http://github.com/jamis/dnd-dungeon
+ * ---------------------------------------------------------------------- */
+
+#include <stdlib.h>
+
+#include "jbmazecore.h"
+
+
+template< int D >
+void JBMazeCore< D >::generate( JBMaze* maze ) {
+  JBMazeWalk walk;
+
+  begin( maze, &walk );
+  step( maze, &walk, walk.remaining );
+  end( maze, &walk );
+}
+
+
+template< int D >
+void JBMazeCore< D >::begin( JBMaze* maze, JBMazeWalk* walk ) {
+  JBRandom&   random = maze->m_phase;
+  JBMazeMask* mask = maze->m_mask;
+  long remaining;
+  long valid;
+  int  sample;
+  int  x;
+  int  y;
+  int  z;
+
+  m_offsets( maze, walk->offsets );
+
+  walk->allDirections = ( 1 << c_DIRECTIONS ) - 1;
+  walk->lastDirection = -1;
+  walk->straightStretch = 0;
+
+  /* a straight stretch must be less than half as long as the dimension
+   * it runs along */
+
+  walk->limits[ 0 ] = walk->limits[ 1 ] = ( maze->m_y >> 1 );
+  walk->limits[ 2 ] = walk->limits[ 3 ] = ( maze->m_x >> 1 );
+  walk->limits[ 4 ] = walk->limits[ 5 ] = ( maze->m_z >> 1 );
+
+  /* compute how many valid points there are in the maze, a row (and 64
+   * points) at a time */
+
+  valid = mask->countValid( maze->m_x, maze->m_y );
+  remaining = valid * maze->m_z;
+  remaining--;
+
+  walk->total = walk->remaining = remaining;
+
+  /* find the point at which we want to start -- make sure the point we
+   * pick is within the mask.  If the first point misses it, one of the
+   * mask's valid points is drawn instead (each as likely as any other, so
+   * the start is as random as it ever was), rather than drawing points
+   * until one lands in a mask that may be nearly empty. */
+
+  sample = ( ( ( maze->m_compatibility & JBMaze::c_COMPAT_START ) == 0 ) &&
+             ( mask->getWidth() == maze->m_x ) && ( mask->getHeight() == maze->m_y ) &&
+             ( valid > 0 ) );
+
+  z = 0;
+  do {
+    x = random.next( maze->m_x );
+    y = random.next( maze->m_y );
+    if( D == 3 ) {
+      z = random.next( maze->m_z );
+    }
+    if( sample && !mask->getMaskAt( x, y ) ) {
+      mask->getValidPoint( random.next( valid ), &x, &y );
+    }
+  } while( !mask->getMaskAt( x, y ) );
+
+  walk->x = x;
+  walk->y = y;
+  walk->z = z;
+  walk->cell = maze->m_index( x, y, z );
+  walk->directions = 0;
+
+  walk->scan = 0;
+  walk->useFrontier = ( ( maze->m_compatibility & JBMaze::c_COMPAT_RESTART ) == 0 );
+  walk->rejection = ( ( maze->m_compatibility & JBMaze::c_COMPAT_DIRECTIONS ) != 0 );
+  if( walk->useFrontier ) {
+    maze->m_allocateFrontier();
+    m_visit( maze, walk->offsets, walk->cell, x, y, z );
+  }
+}
+
+
+template< int D >
+void JBMazeCore< D >::end( JBMaze* maze, JBMazeWalk* walk ) {
+  if( walk->useFrontier ) {
+    maze->m_deallocateFrontier();
+  }
+}
+
+
+template< int D >
+long JBMazeCore< D >::step( JBMaze* maze, JBMazeWalk* walk, long budget ) {
+  JBRandom&      random = maze->m_phase;
+  JBMazeMask*    mask = maze->m_mask;
+  unsigned char* cells = maze->m_maze;
+  const long*    offsets = walk->offsets;
+  const int*     limits = walk->limits;
+  long remaining;
+  long carved;
+  long cell;
+  long next;
+  int  x;
+  int  y;
+  int  z;
+  int  tx;
+  int  ty;
+  int  tz;
+  int  i;
+  int  inside;
+  int  directions;
+  int  direction;
+  int  allDirections;
+  int  lastDirection;
+  int  straightStretch;
+  int  useFrontier;
+  int  rejection;
+
+  /* the walk is kept in locals while it runs, and put back at the end */
+
+  remaining = walk->remaining;
+  cell = walk->cell;
+  x = walk->x;
+  y = walk->y;
+  z = walk->z;
+  directions = walk->directions;
+  allDirections = walk->allDirections;
+  lastDirection = walk->lastDirection;
+  straightStretch = walk->straightStretch;
+  useFrontier = walk->useFrontier;
+  rejection = walk->rejection;
+  carved = 0;
+
+  /* now, for each point remaining in the maze, we loop! */
+
+  while( ( remaining > 0 ) && ( carved < budget ) ) {
+    if( directions == allDirections ) {
+
+      /* if we're stuck (boxed in or otherwise), choose another point, this
+       * time choosing one that has already been visited.  Every cell in
+       * the frontier has at least one unvisited neighbor, so any of them
+       * will do; if the frontier is empty, the rest of the mask cannot be
+       * reached from here, so the walk starts over in the next region of
+       * the mask that it has not visited (which gets a maze of its own),
+       * and is over when there are none. */
+
+      if( useFrontier ) {
+        if( maze->m_frontierCount == 0 ) {
+          for( ; walk->scan < maze->getCellCount(); walk->scan++ ) {
+            if( cells[ walk->scan ] == 0 ) {
+              m_point( maze, walk->scan, &x, &y, &z );
+              if( mask->getMaskAt( x, y ) ) {
+                break;
+              }
+            }
+          }
+          if( walk->scan == maze->getCellCount() ) {
+            remaining = 0;
+            break;
+          }
+          cell = walk->scan++;
+          m_visit( maze, offsets, cell, x, y, z );
+          directions = 0;
+          continue;
+        }
+        cell = maze->m_frontier[ random.next( maze->m_frontierCount ) ];
+        m_point( maze, cell, &x, &y, &z );
+      } else {
+        do {
+          x = random.next( maze->m_x );
+          y = random.next( maze->m_y );
+          if( D == 3 ) {
+            z = random.next( maze->m_z );
+          }
+          cell = maze->m_index( x, y, z );
+        } while( cells[ cell ] == 0 );
+      }
+      directions = cells[ cell ];
+    }
+
+    if( rejection ) {
+
+      /* eliminate obviously impossible directions */
+
+      for( i = 0; i < c_DIRECTIONS; i++ ) {
+        tx = x;
+        ty = y;
+        tz = z;
+        if( !m_step( maze, i, &tx, &ty, &tz ) ) {
+          directions |= ( 1 << i );
+        }
+      }
+    } else {
+
+      /* rule out, all at once, every direction that does not lead to an
+       * unvisited cell within the mask */
+
+      directions = allDirections & ~m_open( maze, offsets, cell, x, y, z );
+      if( directions == allDirections ) {
+        continue;
+      }
+    }
+
+    /* keep going the way we went last time, unless the passage is due to
+     * bend (or can't go any further that way) */
+
+    direction = -1;
+
+    if( ( random.next( 100 ) >= maze->m_randomness ) && ( lastDirection >= 0 ) &&
+        ( straightStretch < limits[ lastDirection ] ) )
+    {
+      tx = x;
+      ty = y;
+      tz = z;
+      if( m_step( maze, lastDirection, &tx, &ty, &tz ) &&
+          ( cells[ cell + offsets[ lastDirection ] ] == 0 ) && mask->getMaskAt( tx, ty ) )
+      {
+        direction = lastDirection;
+      }
+    }
+
+    if( direction >= 0 ) {
+      straightStretch++;
+    } else if( !rejection ) {
+
+      /* pick one of the directions that are left, at random */
+
+      straightStretch = 0;
+      direction = random.choose( ~directions & allDirections );
+    } else {
+
+      /* pick a random direction, until one leads to an unvisited cell or
+       * all of them have been ruled out.  (A direction that leaves the
+       * maze from the very first cell, before it has been carved, does
+       * not end the search, as it never has.) */
+
+      straightStretch = 0;
+
+      for( ;; ) {
+        i = random.next( c_DIRECTIONS );
+        tx = x;
+        ty = y;
+        tz = z;
+        inside = m_step( maze, i, &tx, &ty, &tz );
+        if( inside && mask->getMaskAt( tx, ty ) && ( cells[ cell + offsets[ i ] ] == 0 ) ) {
+          direction = i;
+          break;
+        }
+
+        directions |= ( 1 << i );
+        if( ( directions == allDirections ) && ( inside || ( cells[ cell ] != 0 ) ) ) {
+          break;
+        }
+      }
+    }
+
+    if( direction < 0 ) {
+      /* if we've tested all directions, then we are stuck.  Continue to the
+       * top of the loop, where we will select a new point to search from. */
+      continue;
+    }
+
+    /* set the given direction in the maze, both at the point of origin and
+     * the point of destination. */
+
+    lastDirection = direction;
+    next = cell + offsets[ direction ];
+    cells[ cell ] |= ( 1 << direction );
+    cells[ next ] |= ( 1 << ( direction ^ 1 ) );
+
+    m_step( maze, direction, &x, &y, &z );
+    cell = next;
+    directions = cells[ cell ];
+
+    if( useFrontier ) {
+      m_visit( maze, offsets, cell, x, y, z );
+    }
+
+    /* decrement the number of points remaining */
+
+    remaining--;
+    carved++;
+  }
+
+  walk->remaining = remaining;
+  walk->cell = cell;
+  walk->x = x;
+  walk->y = y;
+  walk->z = z;
+  walk->directions = directions;
+  walk->lastDirection = lastDirection;
+  walk->straightStretch = straightStretch;
+
+  return carved;
+}
+
+
+template< int D >
+long JBMazeCore< D >::connectDeadend( JBMaze* maze, long cell ) {
+  JBMaze::JBMAZE_QUEUE* queue;
+  unsigned char* cells = maze->m_maze;
+  unsigned int   generation;
+  long offsets[ 6 ];
+  long current;
+  long next;
+  long length;
+  int  ox;
+  int  oy;
+  int  oz;
+  int  x;
+  int  y;
+  int  z;
+  int  tx;
+  int  ty;
+  int  tz;
+  int  first;
+  int  dir;
+  int  i;
+  int  k;
+
+  /* breadth-first search outward from the deadend, through empty cells
+   * that lie within the mask, until a cell with passages of its own is
+   * found.  The deadend's own exit is not followed.  The search starts in
+   * a random direction, so that equally near passages are chosen fairly. */
+
+  m_offsets( maze, offsets );
+
+  generation = maze->m_nextSolveGeneration();
+  queue = &maze->m_solveQueue[ 0 ];
+  queue->head = queue->count = 0;
+
+  m_point( maze, cell, &ox, &oy, &oz );
+  maze->m_solveStamp[ cell ] = generation;
+  maze->m_solveFrom[ cell ] = JBMaze::c_MARK;
+  maze->m_enqueue( queue, cell );
+
+  first = maze->m_phase.next( c_DIRECTIONS );
+
+  while( queue->count > 0 ) {
+    current = maze->m_dequeue( queue );
+    m_point( maze, current, &x, &y, &z );
+
+    for( k = 0; k < c_DIRECTIONS; k++ ) {
+      i = ( first + k ) % c_DIRECTIONS;
+      if( ( current == cell ) && ( ( 1 << i ) == cells[ cell ] ) ) {
+        continue;
+      }
+
+      tx = x;
+      ty = y;
+      tz = z;
+      if( !m_step( maze, i, &tx, &ty, &tz ) || !maze->m_mask->getMaskAt( tx, ty ) ) {
+        continue;
+      }
+
+      next = current + offsets[ i ];
+      if( maze->m_solveStamp[ next ] == generation ) {
+        continue;
+      }
+
+      maze->m_deadendStats.probes++;
+      maze->m_solveStamp[ next ] = generation;
+      maze->m_solveFrom[ next ] = ( 1 << ( i ^ 1 ) );
+
+      if( cells[ next ] != 0 ) {
+
+        /* found a passage: carve the route back to the deadend */
+
+        for( length = 0; next != cell; length++ ) {
+          dir = maze->m_solveFrom[ next ];
+          cells[ next ] |= dir;
+          next += maze->m_solveOffsets[ dir ];
+          cells[ next ] |= maze->m_solveBack[ dir ];
+        }
+
+        return length;
+      }
+
+      if( ( maze->m_connectorRadius > 0 ) &&
+          ( abs( tx - ox ) + abs( ty - oy ) + abs( tz - oz ) >= maze->m_connectorRadius ) )
+      {
+        continue;
+      }
+
+      maze->m_enqueue( queue, next );
+    }
+  }
+
+  return 0;
+}
+
+
+template< int D >
+int JBMazeCore< D >::m_step( JBMaze* maze, int i, int* x, int* y, int* z ) {
+  static const int dx[ 6 ] = {  0, 0, -1, 1,  0, 0 };
+  static const int dy[ 6 ] = { -1, 1,  0, 0,  0, 0 };
+  static const int dz[ 6 ] = {  0, 0,  0, 0, -1, 1 };
+
+  *x += dx[ i ];
+  *y += dy[ i ];
+  if( D == 3 ) {
+    *z += dz[ i ];
+  }
+
+  return ( ( *x >= 0 ) && ( *x < maze->m_x ) && ( *y >= 0 ) && ( *y < maze->m_y ) &&
+           ( ( D == 2 ) || ( ( *z >= 0 ) && ( *z < maze->m_z ) ) ) );
+}
+
+
+template< int D >
+void JBMazeCore< D >::m_offsets( JBMaze* maze, long* offsets ) {
+  offsets[ 0 ] = -(long)maze->m_x;
+  offsets[ 1 ] = maze->m_x;
+  offsets[ 2 ] = -1;
+  offsets[ 3 ] = 1;
+  offsets[ 4 ] = -(long)maze->m_x * maze->m_y;
+  offsets[ 5 ] = (long)maze->m_x * maze->m_y;
+}
+
+
+template< int D >
+void JBMazeCore< D >::m_point( JBMaze* maze, long cell, int* x, int* y, int* z ) {
+  if( D == 2 ) {
+    *x = (int)( cell % maze->m_x );
+    *y = (int)( cell / maze->m_x );
+    *z = 0;
+  } else {
+    *x = (int)( cell % maze->m_x );
+    *y = (int)( ( cell / maze->m_x ) % maze->m_y );
+    *z = (int)( cell / ( (long)maze->m_x * maze->m_y ) );
+  }
+}
+
+
+template< int D >
+int JBMazeCore< D >::m_open( JBMaze* maze, const long* offsets,
+                             long cell, int x, int y, int z )
+{
+  int open;
+  int tx;
+  int ty;
+  int tz;
+  int i;
+
+  open = 0;
+  for( i = 0; i < c_DIRECTIONS; i++ ) {
+    tx = x;
+    ty = y;
+    tz = z;
+    if( m_step( maze, i, &tx, &ty, &tz ) ) {
+      open |= ( ( maze->m_maze[ cell + offsets[ i ] ] == 0 ) & ( maze->m_mask->getMaskAt( tx, ty ) != 0 ) ) << i;
+    }
+  }
+
+  return open;
+}
+
+
+template< int D >
+void JBMazeCore< D >::m_frontierUpdate( JBMaze* maze, const long* offsets,
+                                        long cell, int x, int y, int z )
+{
+  long pos;
+
+  pos = maze->m_frontierPos[ cell ];
+
+  if( m_open( maze, offsets, cell, x, y, z ) != 0 ) {
+    if( pos < 0 ) {
+      maze->m_frontierPos[ cell ] = maze->m_frontierCount;
+      maze->m_frontier[ maze->m_frontierCount++ ] = cell;
+    }
+  } else if( pos >= 0 ) {
+
+    /* remove the cell by moving the last entry of the frontier into its
+     * slot */
+
+    maze->m_frontierCount--;
+    maze->m_frontier[ pos ] = maze->m_frontier[ maze->m_frontierCount ];
+    maze->m_frontierPos[ maze->m_frontier[ pos ] ] = pos;
+    maze->m_frontierPos[ cell ] = -1;
+  }
+}
+
+
+template< int D >
+void JBMazeCore< D >::m_visit( JBMaze* maze, const long* offsets,
+                               long cell, int x, int y, int z )
+{
+  int tx;
+  int ty;
+  int tz;
+  int i;
+
+  /* the newly visited cell may belong on the frontier, and any of its
+   * neighbors that are already on the frontier may have just lost their
+   * last unvisited neighbor. */
+
+  m_frontierUpdate( maze, offsets, cell, x, y, z );
+
+  for( i = 0; i < c_DIRECTIONS; i++ ) {
+    tx = x;
+    ty = y;
+    tz = z;
+    if( m_step( maze, i, &tx, &ty, &tz ) && ( maze->m_frontierPos[ cell + offsets[ i ] ] >= 0 ) ) {
+      m_frontierUpdate( maze, offsets, cell + offsets[ i ], tx, ty, tz );
+    }
+  }
+}
+
+
+template class JBMazeCore< 2 >;
+template class JBMazeCore< 3 >;
@@ -0,0 +1,1326 @@
+/* ---------------------------------------------------------------------- *
+ * This file is in the public domain, and may be used, modified, and
+ * distributed without restriction.
+ * ---------------------------------------------------------------------- *
+ * JBMazeGenerator
+ *
+ * Author: Jamis Buck <jamis@jamisbuck.org>
+ * Homepage: http://github.com/jamis/dnd-dungeon
+ * ---------------------------------------------------------------------- */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "jbmazegenerator.h"
+#include "jbmazestream.h"
+
+
+JBMazeGenerator* JBMazeGenerator::create( int algorithm ) {
+  if( algorithm == JBMaze::c_BACKTRACKER ) {
+    return new JBBacktrackerGenerator();
+  } else if( algorithm == JBMaze::c_GROWINGTREE ) {
+    return new JBGrowingTreeGenerator();
+  } else if( algorithm == JBMaze::c_KRUSKAL ) {
+    return new JBKruskalGenerator();
+  } else if( algorithm == JBMaze::c_WILSON ) {
+    return new JBWilsonGenerator();
+  } else if( algorithm == JBMaze::c_TILED ) {
+    return new JBTiledGenerator();
+  } else if( algorithm == JBMaze::c_LAYERED ) {
+    return new JBLayeredGenerator();
+  } else if( algorithm == JBMaze::c_STREAM ) {
+    return new JBStreamGenerator();
+  }
+
+  return 0;
+}
+
+
+int JBMazeGenerator::findAlgorithm( const char* name ) {
+  if( strcmp( name, "huntandkill" ) == 0 ) {
+    return JBMaze::c_HUNTANDKILL;
+  } else if( strcmp( name, "backtracker" ) == 0 ) {
+    return JBMaze::c_BACKTRACKER;
+  } else if( strcmp( name, "growingtree" ) == 0 ) {
+    return JBMaze::c_GROWINGTREE;
+  } else if( strcmp( name, "kruskal" ) == 0 ) {
+    return JBMaze::c_KRUSKAL;
+  } else if( strcmp( name, "wilson" ) == 0 ) {
+    return JBMaze::c_WILSON;
+  } else if( strcmp( name, "tiled" ) == 0 ) {
+    return JBMaze::c_TILED;
+  } else if( strcmp( name, "layered" ) == 0 ) {
+    return JBMaze::c_LAYERED;
+  } else if( strcmp( name, "stream" ) == 0 ) {
+    return JBMaze::c_STREAM;
+  }
+
+  return -1;
+}
+
+
+int JBMazeGenerator::m_openDirections( JBMaze* maze, int x, int y, int z, int unvisitedOnly ) {
+  unsigned char* cells;
+  JBMazeMask*    mask;
+  long           cell;
+  long           level;
+  int            directions;
+
+  cells = maze->m_maze;
+  mask = maze->getMask();
+  cell = maze->m_index( x, y, z );
+  level = (long)maze->getX() * maze->getY();
+  directions = 0;
+
+  if( ( y > 0 ) && mask->getMaskAt( x, y-1 ) ) {
+    if( !unvisitedOnly || ( cells[ cell - maze->getX() ] == 0 ) ) directions |= JBMaze::c_NORTH;
+  }
+  if( ( y+1 < maze->getY() ) && mask->getMaskAt( x, y+1 ) ) {
+    if( !unvisitedOnly || ( cells[ cell + maze->getX() ] == 0 ) ) directions |= JBMaze::c_SOUTH;
+  }
+  if( ( x > 0 ) && mask->getMaskAt( x-1, y ) ) {
+    if( !unvisitedOnly || ( cells[ cell - 1 ] == 0 ) ) directions |= JBMaze::c_WEST;
+  }
+  if( ( x+1 < maze->getX() ) && mask->getMaskAt( x+1, y ) ) {
+    if( !unvisitedOnly || ( cells[ cell + 1 ] == 0 ) ) directions |= JBMaze::c_EAST;
+  }
+  if( z > 0 ) {
+    if( !unvisitedOnly || ( cells[ cell - level ] == 0 ) ) directions |= JBMaze::c_UP;
+  }
+  if( z+1 < maze->getZ() ) {
+    if( !unvisitedOnly || ( cells[ cell + level ] == 0 ) ) directions |= JBMaze::c_DOWN;
+  }
+
+  return directions;
+}
+
+
+int JBMazeGenerator::m_chooseDirection( JBMaze* maze, int candidates, int lastDirection, int* stretch ) {
+  return m_chooseDirection( maze, m_getRandom( maze ), candidates, lastDirection, stretch );
+}
+
+
+int JBMazeGenerator::m_chooseDirection( JBMaze* maze, JBRandom& random, int candidates,
+                                        int lastDirection, int* stretch )
+{
+  int limit;
+
+  if( candidates == 0 ) {
+    return 0;
+  }
+
+  if( ( ( candidates & lastDirection ) != 0 ) && ( random.next( 100 ) >= maze->getRandomness() ) ) {
+    if( ( lastDirection == JBMaze::c_NORTH ) || ( lastDirection == JBMaze::c_SOUTH ) ) {
+      limit = maze->getY() >> 1;
+    } else if( ( lastDirection == JBMaze::c_WEST ) || ( lastDirection == JBMaze::c_EAST ) ) {
+      limit = maze->getX() >> 1;
+    } else {
+      limit = maze->getZ() >> 1;
+    }
+
+    if( *stretch < limit ) {
+      (*stretch)++;
+      return lastDirection;
+    }
+  }
+
+  /* choose one of the candidates at random */
+
+  *stretch = 0;
+  return ( 1 << random.choose( candidates ) );
+}
+
+
+int JBMazeGenerator::m_opposite( int direction ) {
+  return ( ( direction & 0x15 ) << 1 ) | ( ( direction & 0x2A ) >> 1 );
+}
+
+
+long JBMazeGenerator::m_offset( JBMaze* maze, int direction ) {
+  if( direction == JBMaze::c_NORTH ) return -maze->getX();
+  if( direction == JBMaze::c_SOUTH ) return maze->getX();
+  if( direction == JBMaze::c_WEST ) return -1;
+  if( direction == JBMaze::c_EAST ) return 1;
+  if( direction == JBMaze::c_UP ) return -(long)maze->getX() * maze->getY();
+  if( direction == JBMaze::c_DOWN ) return (long)maze->getX() * maze->getY();
+  return 0;
+}
+
+
+void JBMazeGenerator::m_move( int direction, int* x, int* y, int* z ) {
+  if( direction == JBMaze::c_NORTH ) (*y)--;
+  else if( direction == JBMaze::c_SOUTH ) (*y)++;
+  else if( direction == JBMaze::c_WEST ) (*x)--;
+  else if( direction == JBMaze::c_EAST ) (*x)++;
+  else if( direction == JBMaze::c_UP ) (*z)--;
+  else if( direction == JBMaze::c_DOWN ) (*z)++;
+}
+
+
+void JBMazeGenerator::m_point( JBMaze* maze, long cell, int* x, int* y, int* z ) {
+  *x = (int)( cell % maze->getX() );
+  *y = (int)( ( cell / maze->getX() ) % maze->getY() );
+  *z = (int)( cell / ( (long)maze->getX() * maze->getY() ) );
+}
+
+
+void JBMazeGenerator::m_carve( JBMaze* maze, long cell, int direction ) {
+  maze->m_maze[ cell ] |= direction;
+  maze->m_maze[ cell + m_offset( maze, direction ) ] |= m_opposite( direction );
+}
+
+
+long JBMazeGenerator::m_passageCount( JBMaze* maze ) {
+  long count;
+
+  count = maze->getMask()->countValid( maze->getX(), maze->getY() ) * maze->getZ();
+
+  return ( count > 0 ? count - 1 : 0 );
+}
+
+
+long JBMazeGenerator::m_findRegions( JBMaze* maze, long* region, long* order, long* first ) {
+  JBMazeMask* mask;
+  long*       queue;
+  long        regions;
+  long        area;
+  long        head;
+  long        tail;
+  long        pos;
+  int         x;
+  int         y;
+
+  mask = maze->getMask();
+  area = (long)maze->getX() * maze->getY();
+  queue = order;
+
+  for( pos = 0; pos < area; pos++ ) {
+    region[ pos ] = -1;
+  }
+
+  regions = 0;
+  tail = 0;
+  for( pos = 0; pos < area; pos++ ) {
+    if( ( region[ pos ] >= 0 ) || !mask->getMaskAt( (int)( pos % maze->getX() ), (int)( pos / maze->getX() ) ) ) {
+      continue;
+    }
+
+    first[ regions ] = tail;
+    region[ pos ] = regions;
+    queue[ tail++ ] = pos;
+
+    for( head = first[ regions ]; head < tail; head++ ) {
+      x = (int)( queue[ head ] % maze->getX() );
+      y = (int)( queue[ head ] / maze->getX() );
+
+      if( ( y > 0 ) && ( region[ queue[ head ] - maze->getX() ] < 0 ) && mask->getMaskAt( x, y-1 ) ) {
+        region[ queue[ head ] - maze->getX() ] = regions;
+        queue[ tail++ ] = queue[ head ] - maze->getX();
+      }
+      if( ( y+1 < maze->getY() ) && ( region[ queue[ head ] + maze->getX() ] < 0 ) && mask->getMaskAt( x, y+1 ) ) {
+        region[ queue[ head ] + maze->getX() ] = regions;
+        queue[ tail++ ] = queue[ head ] + maze->getX();
+      }
+      if( ( x > 0 ) && ( region[ queue[ head ] - 1 ] < 0 ) && mask->getMaskAt( x-1, y ) ) {
+        region[ queue[ head ] - 1 ] = regions;
+        queue[ tail++ ] = queue[ head ] - 1;
+      }
+      if( ( x+1 < maze->getX() ) && ( region[ queue[ head ] + 1 ] < 0 ) && mask->getMaskAt( x+1, y ) ) {
+        region[ queue[ head ] + 1 ] = regions;
+        queue[ tail++ ] = queue[ head ] + 1;
+      }
+    }
+
+    regions++;
+  }
+  first[ regions ] = tail;
+
+  return regions;
+}
+
+
+void JBMazeGenerator::begin( JBMaze* maze ) {
+  m_total = m_remaining = m_passageCount( maze );
+}
+
+
+long JBMazeGenerator::step( JBMaze* maze, long budget ) {
+  long carved;
+
+  /* the whole maze, however small the budget */
+
+  carved = m_remaining;
+  if( carved > 0 ) {
+    generate( maze );
+    m_remaining = 0;
+  }
+
+  return carved;
+}
+
+
+int JBMazeGenerator::m_threadCount( long count, int threads ) {
+  if( threads < 1 ) {
+    threads = (int)sysconf( _SC_NPROCESSORS_ONLN );
+  }
+  if( threads > count ) {
+    threads = (int)count;
+  }
+  return ( threads < 1 ? 1 : threads );
+}
+
+
+void JBMazeGenerator::m_runTasks( long count, int threads ) {
+  JBMAZE_WORKER* workers;
+  pthread_t*     ids;
+  int            i;
+
+  m_taskCount = count;
+  m_nextTask = 0;
+  pthread_mutex_init( &m_taskLock, 0 );
+
+  workers = new JBMAZE_WORKER[ threads ];
+  ids = new pthread_t[ threads ];
+
+  for( i = 0; i < threads; i++ ) {
+    workers[ i ].generator = this;
+    workers[ i ].worker = i;
+  }
+  for( i = 1; i < threads; i++ ) {
+    pthread_create( &ids[ i ], 0, m_work, &workers[ i ] );
+  }
+  m_work( &workers[ 0 ] );
+  for( i = 1; i < threads; i++ ) {
+    pthread_join( ids[ i ], 0 );
+  }
+
+  delete[] ids;
+  delete[] workers;
+  pthread_mutex_destroy( &m_taskLock );
+}
+
+
+void* JBMazeGenerator::m_work( void* worker ) {
+  JBMazeGenerator* self;
+  long             task;
+
+  self = ( (JBMAZE_WORKER*)worker )->generator;
+
+  for( ;; ) {
+    pthread_mutex_lock( &self->m_taskLock );
+    task = self->m_nextTask++;
+    pthread_mutex_unlock( &self->m_taskLock );
+
+    if( task >= self->m_taskCount ) {
+      break;
+    }
+
+    self->m_runTask( task, ( (JBMAZE_WORKER*)worker )->worker );
+  }
+
+  return 0;
+}
+
+
+/* ---------------------------------------------------------------------- *
+ * Returns the first cell at or after a random point in the maze that lies
+ * within the mask, or -1 if no cell does.
+ * ---------------------------------------------------------------------- */
+
+static long randomStart( JBMaze* maze, JBRandom& random ) {
+  JBMazeMask* mask;
+  long count;
+  long area;
+  long cell;
+  long i;
+  int  x;
+  int  y;
+
+  count = maze->getCellCount();
+  cell = random.next( count );
+
+  /* a mask the size of the maze can find the next valid point itself,
+   * from its runs; one that is not is searched a cell at a time */
+
+  mask = maze->getMask();
+  if( ( mask->getWidth() == maze->getX() ) && ( mask->getHeight() == maze->getY() ) ) {
+    area = (long)maze->getX() * maze->getY();
+    x = (int)( cell % maze->getX() );
+    y = (int)( ( cell % area ) / maze->getX() );
+    if( mask->findNext( &x, &y ) ) {
+      return cell / area * area + (long)y * maze->getX() + x;
+    }
+    x = y = 0;
+    if( !mask->findNext( &x, &y ) ) {
+      return -1;
+    }
+    return ( cell / area + 1 ) % maze->getZ() * area + (long)y * maze->getX() + x;
+  }
+
+  for( i = 0; i < count; i++, cell = ( cell + 1 ) % count ) {
+    x = (int)( cell % maze->getX() );
+    y = (int)( ( cell / maze->getX() ) % maze->getY() );
+    if( maze->getMask()->getMaskAt( x, y ) ) {
+      return cell;
+    }
+  }
+
+  return -1;
+}
+
+
+void JBBacktrackerGenerator::generate( JBMaze* maze ) {
+  begin( maze );
+  step( maze, m_remaining );
+}
+
+
+void JBBacktrackerGenerator::begin( JBMaze* maze ) {
+  long count;
+  long root;
+
+  count = maze->getCellCount();
+
+  delete[] m_stack;
+  m_stack = new long[ count ];
+  m_peakMemory = count * sizeof( long );
+
+  m_total = m_remaining = m_passageCount( maze );
+  m_depth = 0;
+  m_next = 0;
+
+  root = randomStart( maze, m_getRandom( maze ) );
+  if( root < 0 ) {
+    m_remaining = 0;
+  } else {
+    m_stack[ 0 ] = root;
+    m_depth = 1;
+    m_lastDirection = 0;
+    m_stretch = 0;
+  }
+}
+
+
+long JBBacktrackerGenerator::step( JBMaze* maze, long budget ) {
+  unsigned char* cells;
+  long           count;
+  long           carved;
+  long           root;
+  int            candidates;
+  int            direction;
+  int            x;
+  int            y;
+  int            z;
+
+  cells = m_getCells( maze );
+  count = maze->getCellCount();
+  carved = 0;
+
+  while( ( m_remaining > 0 ) && ( carved < budget ) ) {
+    if( m_depth == 0 ) {
+
+      /* look for a region of the mask that has not been visited yet */
+
+      for( root = -1; m_next < count; m_next++ ) {
+        m_point( maze, m_next, &x, &y, &z );
+        if( ( cells[ m_next ] == 0 ) && maze->getMask()->getMaskAt( x, y ) &&
+            ( m_openDirections( maze, x, y, z, 1 ) != 0 ) )
+        {
+          root = m_next;
+          break;
+        }
+      }
+
+      if( root < 0 ) {
+        m_remaining = 0;
+        break;
+      }
+
+      m_stack[ 0 ] = root;
+      m_depth = 1;
+      m_lastDirection = 0;
+      m_stretch = 0;
+    }
+
+    m_point( maze, m_stack[ m_depth-1 ], &x, &y, &z );
+    candidates = m_openDirections( maze, x, y, z, 1 );
+
+    if( candidates == 0 ) {
+      m_depth--;
+      m_lastDirection = 0;
+      continue;
+    }
+
+    direction = m_chooseDirection( maze, candidates, m_lastDirection, &m_stretch );
+    m_carve( maze, m_stack[ m_depth-1 ], direction );
+    m_stack[ m_depth ] = m_stack[ m_depth-1 ] + m_offset( maze, direction );
+    m_depth++;
+    m_lastDirection = direction;
+
+    carved++;
+    m_remaining--;
+  }
+
+  if( m_remaining == 0 ) {
+    delete[] m_stack;
+    m_stack = 0;
+  }
+
+  return carved;
+}
+
+
+void JBGrowingTreeGenerator::generate( JBMaze* maze ) {
+  unsigned char* cells;
+  long*          active;
+  long           activeCount;
+  long           count;
+  long           next;
+  long           root;
+  long           index;
+  long           cell;
+  long           lastCell;
+  int            candidates;
+  int            direction;
+  int            lastDirection;
+  int            stretch;
+  int            x;
+  int            y;
+  int            z;
+
+  cells = m_getCells( maze );
+  count = maze->getCellCount();
+
+  active = new long[ count ];
+  m_peakMemory = count * sizeof( long );
+
+  root = randomStart( maze, m_getRandom( maze ) );
+  next = 0;
+
+  while( root >= 0 ) {
+    active[ 0 ] = root;
+    activeCount = 1;
+    lastCell = -1;
+    lastDirection = 0;
+    stretch = 0;
+
+    while( activeCount > 0 ) {
+      if( m_getRandom( maze ).next( 100 ) < m_newest ) {
+        index = activeCount - 1;
+      } else {
+        index = m_getRandom( maze ).next( activeCount );
+      }
+
+      cell = active[ index ];
+      m_point( maze, cell, &x, &y, &z );
+      candidates = m_openDirections( maze, x, y, z, 1 );
+
+      if( candidates == 0 ) {
+        active[ index ] = active[ --activeCount ];
+        continue;
+      }
+
+      /* a passage can only continue straight if we are growing the cell
+       * that was just added */
+
+      if( cell != lastCell ) {
+        lastDirection = 0;
+      }
+
+      direction = m_chooseDirection( maze, candidates, lastDirection, &stretch );
+      m_carve( maze, cell, direction );
+
+      lastCell = cell + m_offset( maze, direction );
+      lastDirection = direction;
+      active[ activeCount++ ] = lastCell;
+    }
+
+    for( root = -1; next < count; next++ ) {
+      m_point( maze, next, &x, &y, &z );
+      if( ( cells[ next ] == 0 ) && maze->getMask()->getMaskAt( x, y ) &&
+          ( m_openDirections( maze, x, y, z, 1 ) != 0 ) )
+      {
+        root = next;
+        break;
+      }
+    }
+  }
+
+  delete[] active;
+}
+
+
+long JBKruskalGenerator::m_find( long* parent, long cell ) {
+  while( parent[ cell ] != cell ) {
+    parent[ cell ] = parent[ parent[ cell ] ];
+    cell = parent[ cell ];
+  }
+  return cell;
+}
+
+
+void JBKruskalGenerator::generate( JBMaze* maze ) {
+  static const int axes[ 3 ] = { JBMaze::c_EAST, JBMaze::c_SOUTH, JBMaze::c_DOWN };
+
+  long* parent;
+  long* edges;
+  long  edgeCount;
+  long  count;
+  long  cell;
+  long  other;
+  long  i;
+  long  j;
+  long  t;
+  int   direction;
+  int   open;
+  int   stretch;
+  int   limit;
+  int   a;
+  int   x;
+  int   y;
+  int   z;
+
+  count = maze->getCellCount();
+
+  parent = new long[ count ];
+  edges = new long[ count * 3 ];
+  m_peakMemory = count * sizeof( long ) * 4;
+
+  /* every cell starts in a set of its own, and every pair of adjacent
+   * cells within the mask is a candidate edge.  Edges are encoded as
+   * cell * 4 + axis. */
+
+  edgeCount = 0;
+  for( cell = 0; cell < count; cell++ ) {
+    parent[ cell ] = cell;
+
+    m_point( maze, cell, &x, &y, &z );
+    if( !maze->getMask()->getMaskAt( x, y ) ) {
+      continue;
+    }
+
+    open = m_openDirections( maze, x, y, z, 0 );
+    for( a = 0; a < 3; a++ ) {
+      if( ( open & axes[ a ] ) != 0 ) {
+        edges[ edgeCount++ ] = cell * 4 + a;
+      }
+    }
+  }
+
+  /* shuffle the edges */
+
+  for( i = edgeCount - 1; i > 0; i-- ) {
+    j = m_getRandom( maze ).next( i + 1 );
+    t = edges[ i ];
+    edges[ i ] = edges[ j ];
+    edges[ j ] = t;
+  }
+
+  for( i = 0; i < edgeCount; i++ ) {
+    cell = edges[ i ] >> 2;
+    direction = axes[ edges[ i ] & 3 ];
+
+    if( direction == JBMaze::c_EAST ) {
+      limit = maze->getX() >> 1;
+    } else if( direction == JBMaze::c_SOUTH ) {
+      limit = maze->getY() >> 1;
+    } else {
+      limit = maze->getZ() >> 1;
+    }
+
+    /* join the two cells if they are not already connected.  Each time a
+     * pair is joined, the passage may continue straight on into the next
+     * cell, which is how the randomness setting is honored here. */
+
+    stretch = 0;
+    do {
+      other = cell + m_offset( maze, direction );
+      if( m_find( parent, cell ) == m_find( parent, other ) ) {
+        break;
+      }
+
+      m_carve( maze, cell, direction );
+      parent[ m_find( parent, cell ) ] = m_find( parent, other );
+
+      cell = other;
+      m_point( maze, cell, &x, &y, &z );
+      if( ( m_openDirections( maze, x, y, z, 0 ) & direction ) == 0 ) {
+        break;
+      }
+    } while( ( stretch++ < limit ) && ( m_getRandom( maze ).next( 100 ) >= maze->getRandomness() ) );
+  }
+
+  delete[] parent;
+  delete[] edges;
+}
+
+
+void JBWilsonGenerator::generate( JBMaze* maze ) {
+  static const unsigned char c_INTREE  = 0x80;
+  static const unsigned char c_REACHED = 0x40;
+  static const unsigned char c_DIRS    = 0x3F;
+
+  unsigned char* state;
+  long*          queue;
+  long           head;
+  long           tail;
+  long           count;
+  long           cell;
+  long           start;
+  int            direction;
+  int            lastDirection;
+  int            stretch;
+  int            open;
+  int            x;
+  int            y;
+  int            z;
+
+  count = maze->getCellCount();
+
+  state = new unsigned char[ count ];
+  queue = new long[ count ];
+  memset( state, 0, count );
+  m_peakMemory = count * ( sizeof( unsigned char ) + sizeof( long ) );
+
+  /* a random walk can only end when it reaches the tree, so each region
+   * of the mask needs a cell of its own in the tree to begin with.  Flood
+   * each region, and put the first cell of each one in the tree. */
+
+  for( start = 0; start < count; start++ ) {
+    m_point( maze, start, &x, &y, &z );
+    if( ( state[ start ] & c_REACHED ) || !maze->getMask()->getMaskAt( x, y ) ) {
+      continue;
+    }
+
+    state[ start ] = c_INTREE | c_REACHED;
+    queue[ 0 ] = start;
+    head = 0;
+    tail = 1;
+
+    while( head < tail ) {
+      cell = queue[ head++ ];
+      m_point( maze, cell, &x, &y, &z );
+      open = m_openDirections( maze, x, y, z, 0 );
+      for( direction = 1; direction <= JBMaze::c_DOWN; direction <<= 1 ) {
+        if( ( open & direction ) && !( state[ cell + m_offset( maze, direction ) ] & c_REACHED ) ) {
+          state[ cell + m_offset( maze, direction ) ] |= c_REACHED;
+          queue[ tail++ ] = cell + m_offset( maze, direction );
+        }
+      }
+    }
+  }
+
+  delete[] queue;
+
+  /* now walk from every cell that is not yet in the tree, remembering the
+   * last direction taken out of each cell (which erases any loops), until
+   * the tree is reached.  Then add the loop-erased walk to the tree. */
+
+  for( start = 0; start < count; start++ ) {
+    if( ( state[ start ] & ( c_INTREE | c_REACHED ) ) != c_REACHED ) {
+      continue;
+    }
+
+    cell = start;
+    m_point( maze, cell, &x, &y, &z );
+    lastDirection = 0;
+    stretch = 0;
+
+    while( !( state[ cell ] & c_INTREE ) ) {
+      open = m_openDirections( maze, x, y, z, 0 );
+      direction = m_chooseDirection( maze, open, lastDirection, &stretch );
+      state[ cell ] = ( state[ cell ] & ~c_DIRS ) | direction;
+      cell += m_offset( maze, direction );
+      m_move( direction, &x, &y, &z );
+      lastDirection = direction;
+    }
+
+    for( cell = start; !( state[ cell ] & c_INTREE ); cell += m_offset( maze, direction ) ) {
+      direction = state[ cell ] & c_DIRS;
+      m_carve( maze, cell, direction );
+      state[ cell ] |= c_INTREE;
+    }
+  }
+
+  delete[] state;
+}
+
+
+const unsigned int JBTiledGenerator::c_UNCARVED = 0xFFFFFFFF;
+
+
+JBTiledGenerator::JBTiledGenerator( int tileSize, int threads ) {
+  m_tileSize = ( tileSize < 1 ? 1 : tileSize );
+  m_threads = threads;
+  m_maze = 0;
+  m_component = 0;
+  m_componentCount = 0;
+  m_stacks = 0;
+}
+
+
+long JBTiledGenerator::m_find( long* parent, long component ) {
+  while( parent[ component ] != component ) {
+    parent[ component ] = parent[ parent[ component ] ];
+    component = parent[ component ];
+  }
+  return component;
+}
+
+
+void JBTiledGenerator::generate( JBMaze* maze ) {
+  long*      base;
+  long*      parent;
+  long*      edges;
+  long       edgeCount;
+  long       components;
+  long       count;
+  long       tileCount;
+  long       tile;
+  long       cell;
+  long       other;
+  long       a;
+  long       b;
+  long       i;
+  long       j;
+  long       t;
+  int        threadCount;
+  int        direction;
+  int        x;
+  int        y;
+  int        z;
+
+  m_maze = maze;
+  m_random = m_getRandom( maze );
+  count = maze->getCellCount();
+
+  m_tilesX = ( maze->getX() + m_tileSize - 1 ) / m_tileSize;
+  tileCount = m_tilesX * ( ( maze->getY() + m_tileSize - 1 ) / m_tileSize );
+
+  m_component = new unsigned int[ count ];
+  m_componentCount = new unsigned int[ tileCount ];
+  memset( m_component, 0xFF, count * sizeof( unsigned int ) );
+
+  /* every tile splits its own stream from the maze's, and touches only
+   * its own cells, so the tiles may be carved in any order.  rand() is
+   * shared by every thread, though, so a legacy stream gets only one. */
+
+  threadCount = m_threadCount( tileCount, ( m_random.getSource() == JBRandom::c_LEGACY ? 1 : m_threads ) );
+  m_stacks = new long[ threadCount * (long)m_tileSize * m_tileSize * maze->getZ() ];
+
+  m_runTasks( tileCount, threadCount );
+
+  delete[] m_stacks;
+  m_stacks = 0;
+
+  /* every tile is now a forest, with one tree per region of the mask
+   * within the tile.  Number the trees of all the tiles consecutively,
+   * and join them with randomized Kruskal's algorithm over the pairs of
+   * neighboring cells that lie in different tiles. */
+
+  base = new long[ tileCount ];
+  for( components = 0, tile = 0; tile < tileCount; tile++ ) {
+    base[ tile ] = components;
+    components += m_componentCount[ tile ];
+  }
+
+  parent = new long[ components ];
+  for( i = 0; i < components; i++ ) {
+    parent[ i ] = i;
+  }
+
+  edges = new long[ ( ( m_tilesX - 1 ) * maze->getY() +
+                      ( tileCount / m_tilesX - 1 ) * maze->getX() ) * (long)maze->getZ() + 1 ];
+  edgeCount = 0;
+
+  for( z = 0; z < maze->getZ(); z++ ) {
+    for( y = 0; y < maze->getY(); y++ ) {
+      for( x = m_tileSize - 1; x + 1 < maze->getX(); x += m_tileSize ) {
+        if( maze->getMask()->getMaskAt( x, y ) && maze->getMask()->getMaskAt( x+1, y ) ) {
+          edges[ edgeCount++ ] = ( ( (long)z * maze->getY() + y ) * maze->getX() + x ) * 2;
+        }
+      }
+    }
+    for( y = m_tileSize - 1; y + 1 < maze->getY(); y += m_tileSize ) {
+      for( x = 0; x < maze->getX(); x++ ) {
+        if( maze->getMask()->getMaskAt( x, y ) && maze->getMask()->getMaskAt( x, y+1 ) ) {
+          edges[ edgeCount++ ] = ( ( (long)z * maze->getY() + y ) * maze->getX() + x ) * 2 + 1;
+        }
+      }
+    }
+  }
+
+  m_peakMemory = count * sizeof( unsigned int ) + tileCount * ( sizeof( unsigned int ) + sizeof( long ) ) +
+                 components * sizeof( long ) + edgeCount * sizeof( long ) +
+                 (long)threadCount * m_tileSize * m_tileSize * maze->getZ() * sizeof( long );
+
+  for( i = edgeCount - 1; i > 0; i-- ) {
+    j = m_random.next( i + 1 );
+    t = edges[ i ];
+    edges[ i ] = edges[ j ];
+    edges[ j ] = t;
+  }
+
+  for( i = 0; i < edgeCount; i++ ) {
+    cell = edges[ i ] >> 1;
+    direction = ( ( edges[ i ] & 1 ) != 0 ? JBMaze::c_SOUTH : JBMaze::c_EAST );
+    other = cell + m_offset( maze, direction );
+
+    m_point( maze, cell, &x, &y, &z );
+    a = base[ y / m_tileSize * m_tilesX + x / m_tileSize ] + m_component[ cell ];
+    m_point( maze, other, &x, &y, &z );
+    b = base[ y / m_tileSize * m_tilesX + x / m_tileSize ] + m_component[ other ];
+
+    a = m_find( parent, a );
+    b = m_find( parent, b );
+    if( a != b ) {
+      parent[ a ] = b;
+      m_carve( maze, cell, direction );
+    }
+  }
+
+  delete[] edges;
+  delete[] parent;
+  delete[] base;
+  delete[] m_componentCount;
+  delete[] m_component;
+
+  m_component = 0;
+  m_componentCount = 0;
+  m_maze = 0;
+}
+
+
+void JBTiledGenerator::m_runTask( long tile, int worker ) {
+  JBRandom     random;
+  long*        stack;
+  unsigned int components;
+  long         depth;
+  long         cell;
+  long         next;
+  int          candidates;
+  int          direction;
+  int          lastDirection;
+  int          stretch;
+  int          left;
+  int          top;
+  int          right;
+  int          bottom;
+  int          x;
+  int          y;
+  int          z;
+  int          cx;
+  int          cy;
+  int          cz;
+
+  random = m_random.split( (int)tile );
+  stack = m_stacks + worker * (long)m_tileSize * m_tileSize * m_maze->getZ();
+
+  left = (int)( tile % m_tilesX ) * m_tileSize;
+  top = (int)( tile / m_tilesX ) * m_tileSize;
+  right = ( left + m_tileSize < m_maze->getX() ? left + m_tileSize : m_maze->getX() );
+  bottom = ( top + m_tileSize < m_maze->getY() ? top + m_tileSize : m_maze->getY() );
+
+  /* carve the tile with the backtracker, starting again from each cell
+   * that has not been reached, until every region of the mask within the
+   * tile has a tree of its own */
+
+  components = 0;
+
+  for( z = 0; z < m_maze->getZ(); z++ ) {
+    for( y = top; y < bottom; y++ ) {
+      for( x = left; x < right; x++ ) {
+        cell = ( (long)z * m_maze->getY() + y ) * m_maze->getX() + x;
+        if( ( m_component[ cell ] != c_UNCARVED ) || !m_maze->getMask()->getMaskAt( x, y ) ) {
+          continue;
+        }
+
+        m_component[ cell ] = components;
+        stack[ 0 ] = cell;
+        depth = 1;
+        lastDirection = 0;
+        stretch = 0;
+
+        while( depth > 0 ) {
+          m_point( m_maze, stack[ depth-1 ], &cx, &cy, &cz );
+          candidates = m_tileDirections( stack[ depth-1 ], cx, cy, cz, left, top, right, bottom );
+
+          if( candidates == 0 ) {
+            depth--;
+            lastDirection = 0;
+            continue;
+          }
+
+          direction = m_chooseDirection( m_maze, random, candidates, lastDirection, &stretch );
+          m_carve( m_maze, stack[ depth-1 ], direction );
+          next = stack[ depth-1 ] + m_offset( m_maze, direction );
+          m_component[ next ] = components;
+          stack[ depth++ ] = next;
+          lastDirection = direction;
+        }
+
+        components++;
+      }
+    }
+  }
+
+  m_componentCount[ tile ] = components;
+}
+
+
+int JBTiledGenerator::m_tileDirections( long cell, int x, int y, int z,
+                                        int left, int top, int right, int bottom )
+{
+  JBMazeMask* mask;
+  long        width;
+  long        level;
+  int         directions;
+
+  mask = m_maze->getMask();
+  width = m_maze->getX();
+  level = width * m_maze->getY();
+  directions = 0;
+
+  if( ( y > top ) && ( m_component[ cell - width ] == c_UNCARVED ) && mask->getMaskAt( x, y-1 ) ) {
+    directions |= JBMaze::c_NORTH;
+  }
+  if( ( y+1 < bottom ) && ( m_component[ cell + width ] == c_UNCARVED ) && mask->getMaskAt( x, y+1 ) ) {
+    directions |= JBMaze::c_SOUTH;
+  }
+  if( ( x > left ) && ( m_component[ cell - 1 ] == c_UNCARVED ) && mask->getMaskAt( x-1, y ) ) {
+    directions |= JBMaze::c_WEST;
+  }
+  if( ( x+1 < right ) && ( m_component[ cell + 1 ] == c_UNCARVED ) && mask->getMaskAt( x+1, y ) ) {
+    directions |= JBMaze::c_EAST;
+  }
+  if( ( z > 0 ) && ( m_component[ cell - level ] == c_UNCARVED ) ) {
+    directions |= JBMaze::c_UP;
+  }
+  if( ( z+1 < m_maze->getZ() ) && ( m_component[ cell + level ] == c_UNCARVED ) ) {
+    directions |= JBMaze::c_DOWN;
+  }
+
+  return directions;
+}
+
+
+JBLayeredGenerator::JBLayeredGenerator( int links, int threads ) {
+  m_links = ( links < 1 ? 1 : links );
+  m_threads = threads;
+  m_maze = 0;
+  m_stacks = 0;
+  m_levels = 0;
+  m_levelTimes = 0;
+  m_levelLinks = 0;
+}
+
+
+JBLayeredGenerator::~JBLayeredGenerator() {
+  delete[] m_levelTimes;
+  delete[] m_levelLinks;
+}
+
+
+double JBLayeredGenerator::getLevelTime( int z ) {
+  return ( ( z >= 0 ) && ( z < m_levels ) ? m_levelTimes[ z ] : 0 );
+}
+
+
+long JBLayeredGenerator::getLevelLinks( int z ) {
+  return ( ( z >= 0 ) && ( z < m_levels ) ? m_levelLinks[ z ] : 0 );
+}
+
+
+void JBLayeredGenerator::generate( JBMaze* maze ) {
+  long area;
+  int  threadCount;
+
+  m_maze = maze;
+  m_random = m_getRandom( maze );
+  area = (long)maze->getX() * maze->getY();
+
+  delete[] m_levelTimes;
+  delete[] m_levelLinks;
+  m_levels = maze->getZ();
+  m_levelTimes = new double[ m_levels ];
+  m_levelLinks = new long[ m_levels ];
+  memset( m_levelLinks, 0, m_levels * sizeof( long ) );
+
+  /* every level splits its own stream from the maze's, and touches only
+   * its own cells, so the levels may be carved in any order (but rand()
+   * is shared, so a legacy stream gets only one thread) */
+
+  threadCount = m_threadCount( m_levels, ( m_random.getSource() == JBRandom::c_LEGACY ? 1 : m_threads ) );
+  m_stacks = new long[ threadCount * area ];
+
+  m_runTasks( m_levels, threadCount );
+
+  delete[] m_stacks;
+  m_stacks = 0;
+
+  m_peakMemory = threadCount * area * sizeof( long );
+
+  m_link();
+  m_maze = 0;
+}
+
+
+void JBLayeredGenerator::m_runTask( long level, int worker ) {
+  struct timespec start;
+  struct timespec end;
+  JBRandom        random;
+  unsigned char*  cells;
+  long*           stack;
+  long            base;
+  long            depth;
+  long            cell;
+  int             candidates;
+  int             direction;
+  int             lastDirection;
+  int             stretch;
+  int             x;
+  int             y;
+
+  clock_gettime( CLOCK_MONOTONIC, &start );
+
+  random = m_random.split( (int)level );
+  cells = m_getCells( m_maze );
+  stack = m_stacks + worker * (long)m_maze->getX() * m_maze->getY();
+  base = level * m_maze->getX() * m_maze->getY();
+
+  /* carve the level with the backtracker, starting again from each cell
+   * that has not been reached, until every region of the mask has a tree
+   * of its own.  A cell is reached once it has an exit; the first cell
+   * of each tree gets one as soon as it is left. */
+
+  for( y = 0; y < m_maze->getY(); y++ ) {
+    for( x = 0; x < m_maze->getX(); x++ ) {
+      cell = base + (long)y * m_maze->getX() + x;
+      if( ( cells[ cell ] != 0 ) || !m_maze->getMask()->getMaskAt( x, y ) ) {
+        continue;
+      }
+
+      stack[ 0 ] = cell;
+      depth = 1;
+      lastDirection = 0;
+      stretch = 0;
+
+      while( depth > 0 ) {
+        cell = stack[ depth-1 ];
+        candidates = m_levelDirections( cell, (int)( ( cell - base ) % m_maze->getX() ),
+                                        (int)( ( cell - base ) / m_maze->getX() ) );
+
+        if( candidates == 0 ) {
+          depth--;
+          lastDirection = 0;
+          continue;
+        }
+
+        direction = m_chooseDirection( m_maze, random, candidates, lastDirection, &stretch );
+        m_carve( m_maze, cell, direction );
+        stack[ depth++ ] = cell + m_offset( m_maze, direction );
+        lastDirection = direction;
+      }
+    }
+  }
+
+  clock_gettime( CLOCK_MONOTONIC, &end );
+  m_levelTimes[ level ] = ( end.tv_sec - start.tv_sec ) + ( end.tv_nsec - start.tv_nsec ) / 1e9;
+}
+
+
+int JBLayeredGenerator::m_levelDirections( long cell, int x, int y ) {
+  unsigned char* cells;
+  JBMazeMask*    mask;
+  long           width;
+  int            directions;
+
+  cells = m_getCells( m_maze );
+  mask = m_maze->getMask();
+  width = m_maze->getX();
+  directions = 0;
+
+  if( ( y > 0 ) && ( cells[ cell - width ] == 0 ) && mask->getMaskAt( x, y-1 ) ) {
+    directions |= JBMaze::c_NORTH;
+  }
+  if( ( y+1 < m_maze->getY() ) && ( cells[ cell + width ] == 0 ) && mask->getMaskAt( x, y+1 ) ) {
+    directions |= JBMaze::c_SOUTH;
+  }
+  if( ( x > 0 ) && ( cells[ cell - 1 ] == 0 ) && mask->getMaskAt( x-1, y ) ) {
+    directions |= JBMaze::c_WEST;
+  }
+  if( ( x+1 < width ) && ( cells[ cell + 1 ] == 0 ) && mask->getMaskAt( x+1, y ) ) {
+    directions |= JBMaze::c_EAST;
+  }
+
+  return directions;
+}
+
+
+void JBLayeredGenerator::m_link() {
+  long*       region;
+  long*       order;
+  long*       first;
+  long        regions;
+  long        area;
+  long        pos;
+  long        size;
+  long        t;
+  long        i;
+  long        j;
+  int         links;
+  int         z;
+
+  area = (long)m_maze->getX() * m_maze->getY();
+
+  /* every level has one tree in each region of the mask, so the levels
+   * are joined by carving stairways down from each region of each level
+   * into the same region of the next.  Find the regions first, listing
+   * the cells of each one together in order[]. */
+
+  region = new long[ area ];
+  order = new long[ area ];
+  first = new long[ area + 1 ];
+
+  regions = m_findRegions( m_maze, region, order, first );
+
+  if( m_peakMemory < area * 3 * (long)sizeof( long ) ) {
+    m_peakMemory = area * 3 * sizeof( long );
+  }
+
+  /* choose the stairways of each region by shuffling just enough of its
+   * cells to the front of its list */
+
+  for( z = 0; z + 1 < m_levels; z++ ) {
+    for( i = 0; i < regions; i++ ) {
+      size = first[ i+1 ] - first[ i ];
+      links = ( m_links < size ? m_links : (int)size );
+
+      for( j = 0; j < links; j++ ) {
+        pos = first[ i ] + j + m_random.next( size - j );
+        t = order[ pos ];
+        order[ pos ] = order[ first[ i ] + j ];
+        order[ first[ i ] + j ] = t;
+
+        m_carve( m_maze, z * area + t, JBMaze::c_DOWN );
+        m_levelLinks[ z ]++;
+      }
+    }
+  }
+
+  delete[] first;
+  delete[] order;
+  delete[] region;
+}
+
+
+const long JBStreamGenerator::c_BAND_SIZE = 4L << 20;
+
+
+/* ---------------------------------------------------------------------- *
+ * Copies each row of a JBMazeStream into one level of a maze, releasing
+ * the rows it has finished with a band at a time.
+ * ---------------------------------------------------------------------- */
+class JBMazeLevelSink : public JBMazeRowSink {
+  public:
+
+    JBMazeLevelSink( unsigned char* level, JBMazeStorage* storage, long offset ) {
+      m_level = level;
+      m_storage = storage;
+      m_offset = offset;
+      m_released = 0;
+    }
+
+    virtual void row( long y, const unsigned char* exits, int width ) {
+      long written;
+
+      memcpy( m_level + y * width, exits, width );
+
+      written = ( y + 1 ) * width;
+      if( written - m_released >= JBStreamGenerator::c_BAND_SIZE ) {
+        m_storage->release( m_offset + m_released, written - m_released );
+        m_released = written;
+      }
+    }
+
+    virtual void end() {
+      m_storage->release( m_offset + m_released );
+    }
+
+  private:
+
+    unsigned char* m_level;
+    JBMazeStorage* m_storage;
+    long           m_offset;     /* of the level, in the maze's block */
+    long           m_released;   /* bytes of the level released so far */
+};
+
+
+void JBStreamGenerator::generate( JBMaze* maze ) {
+  JBMazeStream* stream;
+  JBMazeMask*   mask;
+  long*         region;
+  long*         order;
+  long*         first;
+  long          regions;
+  long          area;
+  long          pos;
+  long          i;
+  int           z;
+
+  mask = maze->getMask();
+  area = (long)maze->getX() * maze->getY();
+  m_peakMemory = 0;
+
+  /* the rows are written once each, in the order they are stored, and
+   * never read back, so only the current band needs to be in memory */
+
+  maze->getStorage()->advise( JBMazeStorage::c_SEQUENTIAL );
+
+  for( z = 0; z < maze->getZ(); z++ ) {
+    JBMazeLevelSink sink( m_getCells( maze ) + z * area, maze->getStorage(), z * area );
+
+    stream = new JBMazeStream( maze->getX(), maze->getY(),
+                               m_getRandom( maze ).next( 0x7FFFFFFF ) + 1,
+                               maze->getRandomness() );
+    stream->setMask( mask->retain() );
+    stream->generate( &sink );
+    if( stream->getMemoryUsage() > m_peakMemory ) {
+      m_peakMemory = stream->getMemoryUsage();
+    }
+    delete stream;
+  }
+
+  maze->getStorage()->advise( maze->getAdvice() );
+
+  /* the stream gives each level one tree in each region of the mask, so
+   * join each level to the one below it with a stairway at a random cell
+   * of each region (see JBLayeredGenerator::m_link()) */
+
+  if( maze->getZ() < 2 ) {
+    return;
+  }
+
+  region = new long[ area ];
+  order = new long[ area ];
+  first = new long[ area + 1 ];
+
+  regions = m_findRegions( maze, region, order, first );
+
+  if( m_peakMemory < area * 3 * (long)sizeof( long ) ) {
+    m_peakMemory = area * 3 * sizeof( long );
+  }
+
+  for( z = 0; z + 1 < maze->getZ(); z++ ) {
+    for( i = 0; i < regions; i++ ) {
+      pos = order[ first[ i ] + m_getRandom( maze ).next( first[ i+1 ] - first[ i ] ) ];
+      m_carve( maze, z * area + pos, JBMaze::c_DOWN );
+    }
+  }
+
+  delete[] first;
+  delete[] order;
+  delete[] region;
+}
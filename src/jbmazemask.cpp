@@ -8,103 +8,923 @@
  * Homepage: http://github.com/jamis/dnd-dungeon
  * ---------------------------------------------------------------------- */
 
-#include <fstream>
+#include <ctype.h>
+#include <pthread.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 
+#include "png.h"
 #include "jbmazemask.h"
 
+const int JBMazeMask::c_MAX_LOADED = 16;
+
+
+/* ---------------------------------------------------------------------- *
+ * The masks load() has read, most recently loaded first, with what it
+ * knew of each file when it read it.  The lock guards the list, and the
+ * building of every mask's index of runs (so that a shared mask may be
+ * queried from many threads at once).
+ * ---------------------------------------------------------------------- */
+struct JBLoadedMask {
+  char*         path;
+  int           threshold;
+  time_t        modified;
+  long          modifiedNsec;
+  off_t         size;
+  JBMazeMask*   mask;     /* holds a reference of its own */
+  JBLoadedMask* next;
+};
+
+static JBLoadedMask* s_loaded = 0;
+static pthread_mutex_t s_lock = PTHREAD_MUTEX_INITIALIZER;
+
+
+/* ---------------------------------------------------------------------- *
+ * Unlinks the given entry from the list of loaded masks (the lock must be
+ * held), and returns its mask, whose reference the caller must release
+ * (once the lock is not held, since releasing it may take some time).
+ * ---------------------------------------------------------------------- */
+static JBMazeMask* unlinkLoaded( JBLoadedMask** link ) {
+  JBLoadedMask* entry;
+  JBMazeMask* mask;
+
+  entry = *link;
+  *link = entry->next;
+
+  mask = entry->mask;
+  free( entry->path );
+  delete entry;
+
+  return mask;
+}
+
+
+/* ---------------------------------------------------------------------- *
+ * Reads a number from the header of a PBM, skipping the whitespace and
+ * comments before it; returns -1 if there is none.
+ * ---------------------------------------------------------------------- */
+static int pbmNumber( FILE* file ) {
+  int c;
+  int n;
+
+  for( ;; ) {
+    c = getc( file );
+    if( c == '#' ) {
+      while( ( c != '\n' ) && ( c != EOF ) ) {
+        c = getc( file );
+      }
+    } else if( !isspace( c ) ) {
+      break;
+    }
+  }
+
+  if( !isdigit( c ) ) {
+    return -1;
+  }
+
+  for( n = 0; isdigit( c ); c = getc( file ) ) {
+    n = n * 10 + ( c - '0' );
+  }
+
+  /* the single whitespace after the number is part of it */
+
+  return n;
+}
+
 JBMazeMask::JBMazeMask( int width, int height ) {
-  int i;
+  m_references = 1;
+  m_allocate( width, height, 1 );
+}
+
 
-  m_width  = width;
-  m_height = height;
+JBMazeMask::JBMazeMask( const char* filename, int threshold ) {
+  FILE*         file;
+  unsigned char magic[ 8 ];
+  int           ok;
 
-  m_mask = new char*[ m_width ];
-  for( i = 0; i < m_width; i++ ) {
-    m_mask[ i ] = new char[ m_height ];
-    memset( m_mask[ i ], 1, m_height );
+  m_references = 1;
+  m_allocate( 0, 0, 0 );
+  memset( magic, 0, sizeof( magic ) );
+
+  file = fopen( filename, "rb" );
+  if( file == 0 ) {
+    return;
   }
+
+  /* a PNG begins with its eight-byte signature, and a PBM with "P1"
+   * (plain) or "P4" (raw); anything else is taken to be text */
+
+  ok = 0;
+  if( ( fread( magic, 1, 8, file ) == 8 ) && ( png_sig_cmp( magic, 0, 8 ) == 0 ) ) {
+    ok = m_readPNG( file, threshold );
+  } else if( ( magic[ 0 ] == 'P' ) && ( ( magic[ 1 ] == '1' ) || ( magic[ 1 ] == '4' ) ) ) {
+    fseek( file, 2, SEEK_SET );
+    ok = m_readPBM( file, ( magic[ 1 ] == '4' ) );
+  } else {
+    rewind( file );
+    ok = m_readText( file );
+  }
+
+  fclose( file );
+
+  if( !ok ) {
+    m_deallocate();
+    m_allocate( 0, 0, 0 );
+  }
+}
+
+
+JBMazeMask::JBMazeMask( JBMazeMask& master ) {
+  m_references = 1;
+  m_allocate( master.m_width, master.m_height, 0 );
+  memcpy( m_bits, master.m_bits, (long)m_height * m_stride * sizeof( uint64_t ) );
+}
+
+
+JBMazeMask::~JBMazeMask() {
+  m_deallocate();
 }
 
 
-JBMazeMask::JBMazeMask( char* filename ) {
-  std::ifstream in( filename );
-  char     line[ 1024 ];
-  int      i;
-  int      j;
+JBMazeMask* JBMazeMask::load( const char* filename, int threshold ) {
+  struct stat  info;
+  JBLoadedMask** link;
+  JBLoadedMask*  entry;
+  JBMazeMask*  mask;
+  JBMazeMask*  stale;
+  int          count;
 
-  if( !in ) {
-    m_width = 0;
-    m_height = 0;
-    m_mask = 0;
+  if( stat( filename, &info ) != 0 ) {
+    return new JBMazeMask( filename, threshold );
   }
 
-  /* read the first line to get the width and height */
+  /* a mask already loaded from the file as it is now is shared; one
+   * loaded from the file as it was is let go */
 
-  in >> line;
-  sscanf( line, "%d,%d", &m_width, &m_height );
-  
-  /* allocate and initialize the mask array */
+  stale = 0;
+  pthread_mutex_lock( &s_lock );
+  for( link = &s_loaded; *link != 0; link = &(*link)->next ) {
+    entry = *link;
+    if( ( entry->threshold != threshold ) || ( strcmp( entry->path, filename ) != 0 ) ) {
+      continue;
+    }
+
+    if( ( entry->modified == info.st_mtim.tv_sec ) && ( entry->modifiedNsec == info.st_mtim.tv_nsec ) &&
+        ( entry->size == info.st_size ) )
+    {
+      *link = entry->next;
+      entry->next = s_loaded;
+      s_loaded = entry;
+      mask = entry->mask->retain();
+      pthread_mutex_unlock( &s_lock );
+      return mask;
+    }
+
+    stale = unlinkLoaded( link );
+    break;
+  }
+  pthread_mutex_unlock( &s_lock );
 
-  m_mask = new char*[ m_width ];
-  for( i = 0; i < m_width; i++ ) {
-    m_mask[ i ] = new char[ m_height ];
-    memset( m_mask[ i ], 0, m_height );
+  if( stale != 0 ) {
+    stale->release();
   }
 
-  /* loop until we hit the end of the file, or until we have read as many
-   * lines as the mask is high. */
+  /* read it without holding the lock, so that other files (and other
+   * masks' indexes) need not wait on it */
 
-  j = 0;
-  while( !in.eof() ) {
-    if( j >= m_height ) {
+  mask = new JBMazeMask( filename, threshold );
+  if( ( mask->m_width == 0 ) || ( mask->m_height == 0 ) ) {
+    return mask;
+  }
+
+  entry = new JBLoadedMask;
+  entry->path = strdup( filename );
+  entry->threshold = threshold;
+  entry->modified = info.st_mtim.tv_sec;
+  entry->modifiedNsec = info.st_mtim.tv_nsec;
+  entry->size = info.st_size;
+  entry->mask = mask->retain();
+
+  pthread_mutex_lock( &s_lock );
+  entry->next = s_loaded;
+  s_loaded = entry;
+
+  /* only so many are kept (an entry the same as this one, loaded by
+   * another thread in the meantime, is simply the older of the two) */
+
+  stale = 0;
+  for( count = 0, link = &s_loaded; *link != 0; count++ ) {
+    if( ( count >= c_MAX_LOADED ) ||
+        ( ( count > 0 ) && ( (*link)->threshold == threshold ) && ( strcmp( (*link)->path, filename ) == 0 ) ) )
+    {
+      stale = unlinkLoaded( link );
       break;
     }
+    link = &(*link)->next;
+  }
+  pthread_mutex_unlock( &s_lock );
 
-    /* read the next line and parse it */
-    in >> line;
+  if( stale != 0 ) {
+    stale->release();
+  }
 
-    for( i = 0; i < m_width; i++ ) {
-      if( line[ i ] == 0 ) {
-        break;
-      }
+  return mask;
+}
+
+
+void JBMazeMask::unloadAll() {
+  JBMazeMask* mask;
+
+  for( ;; ) {
+    pthread_mutex_lock( &s_lock );
+    mask = ( s_loaded != 0 ? unlinkLoaded( &s_loaded ) : 0 );
+    pthread_mutex_unlock( &s_lock );
 
-      /* if the current char is a '1' then the mask is valid at that point */
-      m_mask[ i ][ j ] = ( line[i] == '1' ? 1 : 0 );
+    if( mask == 0 ) {
+      break;
     }
+    mask->release();
+  }
+}
+
 
-    j++;
+void JBMazeMask::setMaskAt( int x, int y, int valid ) {
+  uint64_t* word;
+  uint64_t  bit;
+
+  if( ( x < 0 ) || ( y < 0 ) || ( x >= m_width ) || ( y >= m_height ) ) {
+    return;
+  }
+
+  if( isShared() ) {
+    return;
   }
+
+  word = &m_bits[ (long)y * m_stride + ( x >> 6 ) ];
+  bit = (uint64_t)1 << ( x & 63 );
+  *word = ( valid ? ( *word | bit ) : ( *word & ~bit ) );
+
+  m_discardRuns();
 }
 
 
-JBMazeMask::JBMazeMask( JBMazeMask& master ) {
-  int i;
+long JBMazeMask::countRow( int y, int x0, int x1 ) {
+  uint64_t* row;
+  long count;
+  int  word;
 
-  m_width = master.m_width;
-  m_height = master.m_height;
+  if( x0 < 0 ) x0 = 0;
+  if( x1 > m_width ) x1 = m_width;
+  if( ( y < 0 ) || ( y >= m_height ) || ( x0 >= x1 ) ) {
+    return 0;
+  }
 
-  m_mask = new char*[ m_width ];
-  for( i = 0; i < m_width; i++ ) {
-    m_mask[ i ] = new char[ m_height ];
-    memcpy( m_mask[ i ], master.m_mask[ i ], m_height );
+  row = m_bits + (long)y * m_stride;
+  count = 0;
+  for( word = ( x0 >> 6 ); word <= ( ( x1 - 1 ) >> 6 ); word++ ) {
+    count += __builtin_popcountll( row[ word ] & m_span( word, x0, x1 ) );
   }
+
+  return count;
 }
 
 
-JBMazeMask::~JBMazeMask() {
-  int i;
+long JBMazeMask::countValid( int width, int height ) {
+  long count;
+  long limit;
+  long run;
+  int  y;
+
+  if( height > m_height ) height = m_height;
+  if( ( width <= 0 ) || ( height <= 0 ) ) {
+    return 0;
+  }
+
+  /* whole rows are counted from the index of runs: every valid point
+   * before the first point past the last row */
+
+  if( width >= m_width ) {
+    limit = (long)height * m_width;
+    run = m_findRun( limit );
+    count = m_runBefore[ run ];
+    if( ( run < m_runCount ) && ( m_runStart[ run ] < limit ) ) {
+      count += limit - m_runStart[ run ];
+    }
+    return count;
+  }
+
+  count = 0;
+  for( y = 0; y < height; y++ ) {
+    count += countRow( y, 0, width );
+  }
+
+  return count;
+}
+
+
+int JBMazeMask::isValid( int x, int y, int width, int height ) {
+  uint64_t* row;
+  uint64_t  span;
+  int  word;
+  int  j;
+
+  if( ( width <= 0 ) || ( height <= 0 ) ) {
+    return 1;
+  }
+  if( ( x < 0 ) || ( y < 0 ) || ( x + width > m_width ) || ( y + height > m_height ) ) {
+    return 0;
+  }
+
+  for( j = y; j < y + height; j++ ) {
+    row = m_bits + (long)j * m_stride;
+    for( word = ( x >> 6 ); word <= ( ( x + width - 1 ) >> 6 ); word++ ) {
+      span = m_span( word, x, x + width );
+      if( ( row[ word ] & span ) != span ) {
+        return 0;
+      }
+    }
+  }
+
+  return 1;
+}
+
+
+int JBMazeMask::findNext( int* x, int* y ) {
+  long offset;
+  long run;
+
+  if( ( *x < 0 ) || ( *y < 0 ) ) {
+    offset = 0;
+  } else if( *x >= m_width ) {
+    offset = (long)( *y + 1 ) * m_width;
+  } else {
+    offset = (long)*y * m_width + *x;
+  }
+
+  /* the point itself, if it is in a run, or else the start of the next */
+
+  run = m_findRun( offset );
+  if( run >= m_runCount ) {
+    return 0;
+  }
+  if( m_runStart[ run ] > offset ) {
+    offset = m_runStart[ run ];
+  }
+
+  *x = (int)( offset % m_width );
+  *y = (int)( offset / m_width );
+  return 1;
+}
+
+
+long JBMazeMask::getRunCount() {
+  m_buildRuns();
+  return m_runCount;
+}
+
+
+int JBMazeMask::getValidPoint( long i, int* x, int* y ) {
+  long offset;
+  long lo;
+  long hi;
+  long mid;
+
+  m_buildRuns();
+  if( ( i < 0 ) || ( i >= m_runBefore[ m_runCount ] ) ) {
+    return 0;
+  }
+
+  /* the last run with no more than i valid points before it */
+
+  lo = 0;
+  hi = m_runCount - 1;
+  while( lo < hi ) {
+    mid = ( lo + hi + 1 ) / 2;
+    if( m_runBefore[ mid ] <= i ) {
+      lo = mid;
+    } else {
+      hi = mid - 1;
+    }
+  }
+
+  offset = m_runStart[ lo ] + ( i - m_runBefore[ lo ] );
+  *x = (int)( offset % m_width );
+  *y = (int)( offset / m_width );
+  return 1;
+}
+
+
+void JBMazeMask::m_allocate( int width, int height, int valid ) {
+  long words;
+  int  y;
+
+  m_width = ( width < 0 ? 0 : width );
+  m_height = ( height < 0 ? 0 : height );
+  m_stride = ( m_width + 63 ) >> 6;
+
+  m_runsValid = 0;
+  m_runCount = 0;
+  m_runStart = 0;
+  m_runBefore = 0;
+
+  words = (long)m_height * m_stride;
+  m_bits = new uint64_t[ words > 0 ? words : 1 ];
+  memset( m_bits, 0, ( words > 0 ? words : 1 ) * sizeof( uint64_t ) );
+
+  /* a valid mask has every point set, but none of the bits past the end
+   * of a row, so whole words may be counted */
+
+  if( valid ) {
+    for( y = 0; y < m_height; y++ ) {
+      memset( m_bits + (long)y * m_stride, 0xFF, m_stride * sizeof( uint64_t ) );
+      if( m_width & 63 ) {
+        m_bits[ (long)y * m_stride + m_stride - 1 ] = ( (uint64_t)1 << ( m_width & 63 ) ) - 1;
+      }
+    }
+  }
+}
+
+
+uint64_t JBMazeMask::m_span( int word, int x0, int x1 ) {
+  uint64_t span;
+  int lo;
+  int hi;
+
+  lo = x0 - word * 64;
+  hi = x1 - word * 64;
+  if( lo < 0 ) lo = 0;
+  if( hi > 64 ) hi = 64;
+
+  span = ( hi >= 64 ? ~(uint64_t)0 : ( (uint64_t)1 << hi ) - 1 );
+  return span & ~( ( (uint64_t)1 << lo ) - 1 );
+}
+
+
+void JBMazeMask::m_deallocate() {
+  m_discardRuns();
+  delete[] m_bits;
+
+  m_bits = 0;
+  m_width = m_height = m_stride = 0;
+}
+
+
+void JBMazeMask::m_buildRuns() {
+  uint64_t* row;
+  uint64_t  word;
+  uint64_t  bits;
+  long base;
+  long runs;
+  long total;
+  int  inRun;
+  int  pass;
+  int  limit;
+  int  change;
+  int  pos;
+  int  k;
+  int  y;
+
+  if( __atomic_load_n( &m_runsValid, __ATOMIC_ACQUIRE ) ) {
+    return;
+  }
+
+  /* a shared mask may be asked for its index by many threads at once; the
+   * first builds it, and the rest wait for it */
 
-  if( m_mask == 0 ) {
+  pthread_mutex_lock( &s_lock );
+  if( m_runsValid ) {
+    pthread_mutex_unlock( &s_lock );
     return;
   }
 
-  for( i = 0; i < m_width; i++ ) {
-    delete[] m_mask[i];
+  /* the first pass counts the runs, and the second records them.  A run
+   * ends only at an invalid point, so it may go on into the next row. */
+
+  runs = 0;
+  for( pass = 0; pass < 2; pass++ ) {
+    if( pass == 1 ) {
+      m_runStart = new long[ runs + 1 ];
+      m_runBefore = new long[ runs + 1 ];
+    }
+
+    runs = 0;
+    total = 0;
+    inRun = 0;
+
+    for( y = 0; y < m_height; y++ ) {
+      row = m_bits + (long)y * m_stride;
+      for( k = 0; k < m_stride; k++ ) {
+        word = row[ k ];
+        base = (long)y * m_width + k * 64;
+        limit = ( m_width - k * 64 < 64 ? m_width - k * 64 : 64 );
+
+        /* skip from one change (valid to invalid, or back) to the next */
+
+        for( pos = 0; pos < limit; pos = change ) {
+          bits = ( inRun ? ~word : word ) >> pos;
+          change = ( bits == 0 ? 64 : pos + __builtin_ctzll( bits ) );
+          if( change > limit ) {
+            change = limit;
+          }
+
+          if( inRun ) {
+            total += change - pos;
+          }
+          if( change < limit ) {
+            if( !inRun ) {
+              if( pass == 1 ) {
+                m_runStart[ runs ] = base + change;
+                m_runBefore[ runs ] = total;
+              }
+              runs++;
+            }
+            inRun = !inRun;
+          }
+        }
+      }
+    }
+  }
+
+  m_runStart[ runs ] = (long)m_width * m_height;
+  m_runBefore[ runs ] = total;
+  m_runCount = runs;
+  __atomic_store_n( &m_runsValid, 1, __ATOMIC_RELEASE );
+
+  pthread_mutex_unlock( &s_lock );
+}
+
+
+void JBMazeMask::m_discardRuns() {
+  delete[] m_runStart;
+  delete[] m_runBefore;
+
+  m_runStart = 0;
+  m_runBefore = 0;
+  m_runCount = 0;
+  m_runsValid = 0;
+}
+
+
+long JBMazeMask::m_findRun( long offset ) {
+  long lo;
+  long hi;
+  long mid;
+
+  m_buildRuns();
+
+  /* the first run that ends after the offset */
+
+  lo = 0;
+  hi = m_runCount;
+  while( lo < hi ) {
+    mid = ( lo + hi ) / 2;
+    if( m_runStart[ mid ] + ( m_runBefore[ mid + 1 ] - m_runBefore[ mid ] ) <= offset ) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
   }
-  delete m_mask;
 
-  m_mask = 0;
-  m_width = m_height = 0;
+  return lo;
+}
+
+
+int JBMazeMask::m_readText( FILE* file ) {
+  unsigned char* points;
+  int  width;
+  int  height;
+  int  c;
+  int  i;
+  int  j;
+
+  /* read the first line to get the width and height */
+
+  width = height = 0;
+  if( fscanf( file, " %d,%d", &width, &height ) != 2 ) {
+    return 0;
+  }
+  do {
+    c = getc( file );
+  } while( ( c != EOF ) && !isspace( c ) );
+
+  m_deallocate();
+  m_allocate( width, height, 0 );
+
+  /* each row is the next run of characters that are not whitespace, of
+   * any length; the characters past the width of the mask are ignored.
+   * A file that ends early leaves the rest of the mask off. */
+
+  points = new unsigned char[ m_width + 1 ];
+
+  for( j = 0; j < m_height; j++ ) {
+    do {
+      c = getc( file );
+    } while( isspace( c ) );
+    if( c == EOF ) {
+      break;
+    }
+
+    memset( points, 0, m_width + 1 );
+    for( i = 0; ( c != EOF ) && !isspace( c ); i++, c = getc( file ) ) {
+      if( i < m_width ) {
+        points[ i ] = ( c == '1' );
+      }
+    }
+
+    m_setRow( j, points );
+  }
+
+  delete[] points;
+  return 1;
+}
+
+
+int JBMazeMask::m_readPBM( FILE* file, int raw ) {
+  unsigned char* row;
+  long bytes;
+  int  width;
+  int  height;
+  int  c;
+  int  i;
+  int  j;
+
+  width = pbmNumber( file );
+  height = pbmNumber( file );
+  if( ( width < 0 ) || ( height < 0 ) ) {
+    return 0;
+  }
+
+  m_deallocate();
+  m_allocate( width, height, 0 );
+
+  bytes = ( raw ? ( m_width + 7 ) / 8 : m_width );
+  row = new unsigned char[ bytes + 1 ];
+
+  for( j = 0; j < m_height; j++ ) {
+    if( raw ) {
+
+      /* eight points to a byte, black (1) first in the high bit */
+
+      if( (long)fread( row, 1, bytes, file ) != bytes ) {
+        break;
+      }
+      m_setRowBits( j, row, 0 );
+
+    } else {
+
+      /* a '0' or '1' for each point, with whitespace (or none) between */
+
+      for( i = 0; i < m_width; i++ ) {
+        do {
+          c = getc( file );
+          if( c == '#' ) {
+            while( ( c != '\n' ) && ( c != EOF ) ) {
+              c = getc( file );
+            }
+          }
+        } while( isspace( c ) );
+        if( c == EOF ) {
+          break;
+        }
+        row[ i ] = ( c == '1' );
+      }
+      if( i < m_width ) {
+        break;
+      }
+      m_setRow( j, row );
+    }
+  }
+
+  delete[] row;
+  return 1;
+}
+
+
+int JBMazeMask::m_readPNG( FILE* file, int threshold ) {
+  png_structp    png;
+  png_infop      info;
+  png_uint_32    width;
+  png_uint_32    height;
+  unsigned char* volatile row;
+  unsigned char* volatile points;
+  unsigned char* pixel;
+  unsigned char* flags;
+  int  depth;
+  int  colorType;
+  int  interlace;
+  int  palette;
+  int  packed;
+  int  invert;
+  int  channels;
+  int  pass;
+  int  passes;
+  int  rows;
+  int  cols;
+  int  i;
+  int  j;
+
+  png = png_create_read_struct( PNG_LIBPNG_VER_STRING, 0, 0, 0 );
+  if( png == 0 ) {
+    return 0;
+  }
+  info = png_create_info_struct( png );
+  if( info == 0 ) {
+    png_destroy_read_struct( &png, 0, 0 );
+    return 0;
+  }
+
+  row = 0;
+  points = 0;
+
+  /* libpng reports a broken image by jumping back here */
+
+  if( setjmp( png_jmpbuf( png ) ) ) {
+    png_destroy_read_struct( &png, &info, 0 );
+    delete[] row;
+    delete[] points;
+    return 0;
+  }
+
+  png_init_io( png, file );
+  png_set_sig_bytes( png, 8 );
+  png_read_info( png, info );
+  png_get_IHDR( png, info, &width, &height, &depth, &colorType, &interlace, 0, 0 );
+
+  if( ( width > 0x7FFFFFFF ) || ( height > 0x7FFFFFFF ) ) {
+    png_error( png, "image too large for a mask" );
+  }
+
+  /* a one-bit image (gray, where 0 is black, or a palette of two) is
+   * packed just as the mask is, and is copied a byte at a time.  Any
+   * other is reduced to one byte per point -- a palette index, or a gray
+   * level and (if there is one) an alpha -- and tested point by point. */
+
+  palette = ( colorType == PNG_COLOR_TYPE_PALETTE );
+  packed = ( ( depth == 1 ) && ( interlace == PNG_INTERLACE_NONE ) &&
+             ( palette || ( colorType == PNG_COLOR_TYPE_GRAY ) ) );
+  invert = !palette;
+
+  if( !packed ) {
+    if( depth < 8 ) {
+      if( palette ) {
+        png_set_packing( png );
+      } else {
+        png_set_expand_gray_1_2_4_to_8( png );
+      }
+    }
+    png_set_strip_16( png );
+    if( ( colorType & PNG_COLOR_MASK_COLOR ) && !palette ) {
+      png_set_rgb_to_gray_fixed( png, 1, -1, -1 );
+    }
+  }
+
+  png_read_update_info( png, info );
+  channels = png_get_channels( png, info );
+
+  m_deallocate();
+  m_allocate( (int)width, (int)height, 0 );
+
+  row = new unsigned char[ png_get_rowbytes( png, info ) + 8 ];
+  points = new unsigned char[ m_width + 1 ];
+
+  /* an interlaced image comes in seven passes, each a smaller image of
+   * every so many points, which are set one at a time where they belong */
+
+  passes = ( interlace == PNG_INTERLACE_NONE ? 1 : PNG_INTERLACE_ADAM7_PASSES );
+
+  for( pass = 0; pass < passes; pass++ ) {
+    if( passes == 1 ) {
+      rows = m_height;
+      cols = m_width;
+    } else {
+      rows = PNG_PASS_ROWS( m_height, pass );
+      cols = PNG_PASS_COLS( m_width, pass );
+      if( ( rows == 0 ) || ( cols == 0 ) ) {
+        continue;
+      }
+    }
+
+    for( j = 0; j < rows; j++ ) {
+      png_read_row( png, row, 0 );
+
+      if( packed ) {
+        m_setRowBits( j, row, invert );
+        continue;
+      }
+
+      /* (row and points must survive a jump back to setjmp(), but copies
+       * of them that need not be reloaded at every point let the compiler
+       * test many points at once) */
+
+      pixel = row;
+      flags = points;
+      if( palette ) {
+        for( i = 0; i < cols; i++ ) {
+          flags[ i ] = ( pixel[ i ] != 0 );
+        }
+      } else if( channels == 1 ) {
+        for( i = 0; i < cols; i++ ) {
+          flags[ i ] = ( pixel[ i ] < threshold );
+        }
+      } else {
+        for( i = 0; i < cols; i++ ) {
+          flags[ i ] = ( pixel[ 2*i ] < threshold ) & ( pixel[ 2*i+1 ] >= 128 );
+        }
+      }
+
+      if( passes == 1 ) {
+        m_setRow( j, flags );
+      } else {
+        for( i = 0; i < cols; i++ ) {
+          setMaskAt( PNG_COL_FROM_PASS_COL( i, pass ), PNG_ROW_FROM_PASS_ROW( j, pass ),
+                     flags[ i ] );
+        }
+      }
+    }
+  }
+
+  png_read_end( png, 0 );
+  png_destroy_read_struct( &png, &info, 0 );
+
+  delete[] row;
+  delete[] points;
+  return 1;
+}
+
+
+void JBMazeMask::m_setRow( int y, const unsigned char* points ) {
+  uint64_t* row;
+  uint64_t  word;
+  uint64_t  eight;
+  int  count;
+  int  i;
+  int  k;
+
+  m_discardRuns();
+
+  row = m_bits + (long)y * m_stride;
+  for( k = 0; k < m_stride; k++, points += 64 ) {
+    count = m_width - k * 64;
+
+    word = 0;
+    if( count >= 64 ) {
+
+      /* eight points (each 0 or 1) at a time: with the first in the low
+       * byte, the multiply gathers the low bit of every byte into the top
+       * byte, the first point lowest */
+
+      for( i = 0; i < 64; i += 8 ) {
+        eight = (uint64_t)points[ i ] | ( (uint64_t)points[ i+1 ] << 8 ) |
+                ( (uint64_t)points[ i+2 ] << 16 ) | ( (uint64_t)points[ i+3 ] << 24 ) |
+                ( (uint64_t)points[ i+4 ] << 32 ) | ( (uint64_t)points[ i+5 ] << 40 ) |
+                ( (uint64_t)points[ i+6 ] << 48 ) | ( (uint64_t)points[ i+7 ] << 56 );
+        word |= ( ( eight * 0x0102040810204080ULL ) >> 56 ) << i;
+      }
+    } else {
+      for( i = 0; i < count; i++ ) {
+        word |= (uint64_t)( points[ i ] != 0 ) << i;
+      }
+    }
+    row[ k ] = word;
+  }
+}
+
+
+void JBMazeMask::m_setRowBits( int y, const unsigned char* bits, int invert ) {
+  uint64_t* row;
+  uint64_t  word;
+  long bytes;
+  long b;
+  int  k;
+
+  m_discardRuns();
+
+  row = m_bits + (long)y * m_stride;
+  bytes = ( m_width + 7 ) / 8;
+
+  for( k = 0; k < m_stride; k++ ) {
+
+    /* eight bytes make a word, the first in the low byte, and then the
+     * bits of every byte are reversed at once, so the first point of each
+     * is its low bit */
+
+    word = 0;
+    for( b = 0; ( b < 8 ) && ( k * 8 + b < bytes ); b++ ) {
+      word |= (uint64_t)bits[ k * 8 + b ] << ( b * 8 );
+    }
+
+    word = ( ( word >> 4 ) & 0x0F0F0F0F0F0F0F0FULL ) | ( ( word & 0x0F0F0F0F0F0F0F0FULL ) << 4 );
+    word = ( ( word >> 2 ) & 0x3333333333333333ULL ) | ( ( word & 0x3333333333333333ULL ) << 2 );
+    word = ( ( word >> 1 ) & 0x5555555555555555ULL ) | ( ( word & 0x5555555555555555ULL ) << 1 );
+
+    row[ k ] = ( invert ? ~word : word );
+  }
+
+  /* keep the bits past the end of the row clear */
+
+  if( m_width & 63 ) {
+    row[ m_stride - 1 ] &= ( (uint64_t)1 << ( m_width & 63 ) ) - 1;
+  }
 }
@@ -0,0 +1,429 @@
+/* ---------------------------------------------------------------------- *
+ * This file is in the public domain, and may be used, modified, and
+ * distributed without restriction.
+ * ---------------------------------------------------------------------- *
+ * JBMazeMaskGenerator
+ *
+ * Author: Jamis Buck <jamis@jamisbuck.org>
+ * Homepage: http://github.com/jamis/dnd-dungeon
+ * ---------------------------------------------------------------------- */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "jbmazemaskgenerator.h"
+#include "jbrandom.h"
+
+const int JBMazeMaskGenerator::c_NOISE   = 0;
+const int JBMazeMaskGenerator::c_BLOBS   = 1;
+const int JBMazeMaskGenerator::c_ISLAND  = 2;
+const int JBMazeMaskGenerator::c_CAVERNS = 3;
+
+const int JBMazeMaskGenerator::c_MAX_OCTAVES = 8;
+
+
+/* ---------------------------------------------------------------------- *
+ * Returns the key of lattice row j of the octave with the given key, and
+ * the value (0 to 1) of lattice point i of the row with the given key:
+ * each is the coordinate, hashed with the key.  The hash of the points is
+ * done in 32 bits, so that a whole row of them may be done with SIMD.
+ * ---------------------------------------------------------------------- */
+static uint32_t latticeRow( uint64_t key, long j ) {
+  uint64_t h;
+
+  h = key ^ ( (uint64_t)j * 0x9E3779B97F4A7C15ULL );
+  h ^= h >> 33;
+  h *= 0xFF51AFD7ED558CCDULL;
+  h ^= h >> 33;
+  h *= 0xC4CEB9FE1A85EC53ULL;
+  h ^= h >> 33;
+
+  return (uint32_t)h;
+}
+
+
+static float latticeValue( uint32_t row, uint32_t i ) {
+  uint32_t h;
+
+  h = row ^ ( i * 0x9E3779B9U );
+  h ^= h >> 16;
+  h *= 0x7FEB352DU;
+  h ^= h >> 15;
+  h *= 0x846CA68BU;
+  h ^= h >> 16;
+
+  return (float)( h >> 8 ) * ( 1.0f / 16777216.0f );
+}
+
+
+/* ---------------------------------------------------------------------- *
+ * Returns the weight (0 to 1) given the far side of a lattice cell, at
+ * the given fraction of the way across it -- a smoothstep, so that the
+ * noise has no creases at the lattice lines.
+ * ---------------------------------------------------------------------- */
+static float blend( float t ) {
+  return t * t * ( 3.0f - 2.0f * t );
+}
+
+
+JBMazeMaskGenerator::JBMazeMaskGenerator( int preset ) {
+  setPreset( preset );
+}
+
+
+void JBMazeMaskGenerator::setPreset( int preset ) {
+  if( preset == c_NOISE ) {
+    m_features = 8;
+    m_octaves = 4;
+    m_threshold = 0.5f;
+    m_falloff = 0.0f;
+    m_smoothing = 1;
+  } else if( preset == c_ISLAND ) {
+    m_features = 3;
+    m_octaves = 5;
+    m_threshold = 0.25f;
+    m_falloff = 0.8f;
+    m_smoothing = 2;
+  } else if( preset == c_CAVERNS ) {
+
+    /* a lattice cell per point is white noise; the automaton does the
+     * rest */
+
+    m_features = 0x7FFFFFFF;
+    m_octaves = 1;
+    m_threshold = 0.45f;
+    m_falloff = 0.15f;
+    m_smoothing = 5;
+  } else {
+    m_features = 4;
+    m_octaves = 3;
+    m_threshold = 0.35f;
+    m_falloff = 0.4f;
+    m_smoothing = 2;
+  }
+}
+
+
+void JBMazeMaskGenerator::setOctaves( int octaves ) {
+  if( octaves < 1 ) {
+    octaves = 1;
+  } else if( octaves > c_MAX_OCTAVES ) {
+    octaves = c_MAX_OCTAVES;
+  }
+
+  m_octaves = octaves;
+}
+
+
+JBMazeMask* JBMazeMaskGenerator::generate( int width, int height, long seed ) {
+  JBMazeMask*    mask;
+  JBRandom       random;
+  JBRandom       stream;
+  uint64_t       key[ c_MAX_OCTAVES ];
+  long           cell[ c_MAX_OCTAVES ];
+  long           lattice[ c_MAX_OCTAVES ];
+  long           cached[ c_MAX_OCTAVES ];
+  float          amplitude[ c_MAX_OCTAVES ];
+  float*         weight[ c_MAX_OCTAVES ];
+  float*         above[ c_MAX_OCTAVES ];
+  float*         below[ c_MAX_OCTAVES ];
+  float*         column;
+  float*         row;
+  float*         falloff;
+  float*         swap;
+  unsigned char* points;
+  uint32_t       hash;
+  float          total;
+  float          scale;
+  float          dy;
+  float          fy;
+  float          a;
+  float          d;
+  long           side;
+  long           base;
+  long           iy;
+  long           i;
+  long           n;
+  long           k;
+  int            octaves;
+  int            o;
+  int            x;
+  int            y;
+
+  mask = new JBMazeMask( width, height );
+  width = mask->getWidth();
+  height = mask->getHeight();
+  if( ( width == 0 ) || ( height == 0 ) ) {
+    return mask;
+  }
+
+  /* each octave's lattice cells are half the size of the one before;
+   * there is no point going on once they are a single point across */
+
+  side = ( width < height ? width : height );
+  random.seed( seed );
+
+  total = 0;
+  for( octaves = 0; octaves < m_octaves; octaves++ ) {
+    cell[ octaves ] = side / ( (long)m_features << octaves );
+    if( cell[ octaves ] < 1 ) {
+      cell[ octaves ] = 1;
+    }
+    if( ( octaves > 0 ) && ( cell[ octaves - 1 ] == 1 ) ) {
+      break;
+    }
+
+    stream = random.split( octaves );
+    key[ octaves ] = ( (uint64_t)stream.next( 0x7FFFFFFF ) << 32 ) ^ (uint64_t)stream.next( 0x7FFFFFFF );
+    amplitude[ octaves ] = 1.0f / (float)( 1 << octaves );
+    total += amplitude[ octaves ];
+  }
+
+  /* per octave: the weights across a lattice cell, and the lattice rows
+   * above and below the current row of points (hashed only when the
+   * points move on to the next lattice row) */
+
+  for( o = 0; o < octaves; o++ ) {
+    weight[ o ] = new float[ cell[ o ] ];
+    for( k = 0; k < cell[ o ]; k++ ) {
+      weight[ o ][ k ] = blend( (float)k / (float)cell[ o ] );
+    }
+
+    lattice[ o ] = ( width + cell[ o ] - 1 ) / cell[ o ] + 1;
+    above[ o ] = new float[ lattice[ o ] ];
+    below[ o ] = new float[ lattice[ o ] ];
+    cached[ o ] = -2;
+  }
+
+  column = new float[ width / cell[ octaves - 1 ] + 2 ];
+  row = new float[ width ];
+  falloff = new float[ width ];
+  points = new unsigned char[ width ];
+
+  /* the falloff is the square of the distance from the middle, scaled so
+   * that the middle of each edge is 1 */
+
+  for( x = 0; x < width; x++ ) {
+    d = ( ( (float)x + 0.5f ) / (float)width ) * 2.0f - 1.0f;
+    falloff[ x ] = m_falloff * d * d;
+  }
+
+  scale = 1.0f / total;
+
+  for( y = 0; y < height; y++ ) {
+    memset( row, 0, width * sizeof( float ) );
+
+    for( o = 0; o < octaves; o++ ) {
+      iy = y / cell[ o ];
+      fy = weight[ o ][ y % cell[ o ] ];
+
+      if( iy != cached[ o ] ) {
+        if( iy == cached[ o ] + 1 ) {
+          swap = above[ o ];
+          above[ o ] = below[ o ];
+          below[ o ] = swap;
+        } else {
+          hash = latticeRow( key[ o ], iy );
+          for( i = 0; i < lattice[ o ]; i++ ) {
+            above[ o ][ i ] = latticeValue( hash, (uint32_t)i );
+          }
+        }
+        hash = latticeRow( key[ o ], iy + 1 );
+        for( i = 0; i < lattice[ o ]; i++ ) {
+          below[ o ][ i ] = latticeValue( hash, (uint32_t)i );
+        }
+        cached[ o ] = iy;
+      }
+
+      /* blend the lattice rows down to this row, and then each lattice
+       * cell across it: within a cell, only the weights vary */
+
+      n = lattice[ o ];
+      for( i = 0; i < n; i++ ) {
+        column[ i ] = above[ o ][ i ] + ( below[ o ][ i ] - above[ o ][ i ] ) * fy;
+      }
+
+      if( cell[ o ] == 1 ) {
+        for( x = 0; x < width; x++ ) {
+          row[ x ] += amplitude[ o ] * column[ x ];
+        }
+        continue;
+      }
+
+      for( i = 0, base = 0; base < width; i++, base += cell[ o ] ) {
+        a = amplitude[ o ] * column[ i ];
+        d = amplitude[ o ] * ( column[ i + 1 ] - column[ i ] );
+        n = ( base + cell[ o ] <= width ? cell[ o ] : width - base );
+        for( k = 0; k < n; k++ ) {
+          row[ base + k ] += a + d * weight[ o ][ k ];
+        }
+      }
+    }
+
+    d = ( ( (float)y + 0.5f ) / (float)height ) * 2.0f - 1.0f;
+    dy = m_falloff * d * d + m_threshold;
+
+    for( x = 0; x < width; x++ ) {
+      points[ x ] = ( row[ x ] * scale - falloff[ x ] > dy );
+    }
+
+    mask->m_setRow( y, points );
+  }
+
+  for( o = 0; o < octaves; o++ ) {
+    delete[] weight[ o ];
+    delete[] above[ o ];
+    delete[] below[ o ];
+  }
+  delete[] column;
+  delete[] row;
+  delete[] falloff;
+  delete[] points;
+
+  for( i = 0; i < m_smoothing; i++ ) {
+    m_smooth( mask );
+  }
+
+  if( mask->countValid() == 0 ) {
+    mask->setMaskAt( width / 2, height / 2, 1 );
+  }
+
+  return mask;
+}
+
+
+int JBMazeMaskGenerator::findPreset( const char* name ) {
+  if( strcmp( name, "noise" ) == 0 ) {
+    return c_NOISE;
+  } else if( strcmp( name, "blobs" ) == 0 ) {
+    return c_BLOBS;
+  } else if( strcmp( name, "island" ) == 0 ) {
+    return c_ISLAND;
+  } else if( strcmp( name, "caverns" ) == 0 ) {
+    return c_CAVERNS;
+  }
+
+  return -1;
+}
+
+
+JBMazeMask* JBMazeMaskGenerator::create( const char* spec, int width, int height, long seed ) {
+  JBMazeMaskGenerator generator;
+  const char* comma;
+  char name[ 32 ];
+  int  length;
+  int  preset;
+
+  comma = strchr( spec, ',' );
+  length = ( comma != 0 ? (int)( comma - spec ) : (int)strlen( spec ) );
+  if( length >= (int)sizeof( name ) ) {
+    return 0;
+  }
+
+  memcpy( name, spec, length );
+  name[ length ] = 0;
+
+  preset = findPreset( name );
+  if( preset < 0 ) {
+    return 0;
+  }
+
+  if( comma != 0 ) {
+    seed = atol( comma + 1 );
+  }
+
+  generator.setPreset( preset );
+  return generator.generate( width, height, seed );
+}
+
+
+void JBMazeMaskGenerator::m_smooth( JBMazeMask* mask ) {
+  uint64_t* above;
+  uint64_t* here;
+  uint64_t* below;
+  uint64_t* zero;
+  uint64_t* rows[ 3 ];
+  uint64_t* bits;
+  uint64_t  l[ 3 ];
+  uint64_t  r[ 3 ];
+  uint64_t  s[ 3 ];
+  uint64_t  c[ 3 ];
+  uint64_t  ones;
+  uint64_t  onesCarry;
+  uint64_t  twos;
+  uint64_t  twosCarry;
+  uint64_t  b1;
+  uint64_t  b2;
+  uint64_t  b3;
+  int stride;
+  int height;
+  int y;
+  int k;
+  int j;
+
+  stride = mask->m_stride;
+  height = mask->m_height;
+  if( stride == 0 ) {
+    return;
+  }
+
+  /* the rows above and at the current one are copied before it is
+   * overwritten; the one below is still as it was.  Outside the mask
+   * counts as invalid. */
+
+  above = new uint64_t[ stride ];
+  here = new uint64_t[ stride ];
+  zero = new uint64_t[ stride ];
+  memset( above, 0, stride * sizeof( uint64_t ) );
+  memset( zero, 0, stride * sizeof( uint64_t ) );
+  memcpy( here, mask->m_bits, stride * sizeof( uint64_t ) );
+
+  for( y = 0; y < height; y++ ) {
+    below = ( y + 1 < height ? mask->m_bits + (long)( y + 1 ) * stride : zero );
+    bits = mask->m_bits + (long)y * stride;
+
+    rows[ 0 ] = above;
+    rows[ 1 ] = here;
+    rows[ 2 ] = below;
+
+    for( k = 0; k < stride; k++ ) {
+
+      /* the sum of each row's three points (left, middle, and right) is
+       * s + 2c, 64 points at a time; the sum of the nine is then added
+       * up, a bit of it at a time, the same way */
+
+      for( j = 0; j < 3; j++ ) {
+        l[ j ] = ( rows[ j ][ k ] << 1 ) | ( k > 0 ? rows[ j ][ k - 1 ] >> 63 : 0 );
+        r[ j ] = ( rows[ j ][ k ] >> 1 ) | ( k + 1 < stride ? rows[ j ][ k + 1 ] << 63 : 0 );
+        s[ j ] = l[ j ] ^ rows[ j ][ k ] ^ r[ j ];
+        c[ j ] = ( l[ j ] & rows[ j ][ k ] ) | ( r[ j ] & ( l[ j ] ^ rows[ j ][ k ] ) );
+      }
+
+      ones = s[ 0 ] ^ s[ 1 ] ^ s[ 2 ];
+      onesCarry = ( s[ 0 ] & s[ 1 ] ) | ( s[ 2 ] & ( s[ 0 ] ^ s[ 1 ] ) );
+      twos = c[ 0 ] ^ c[ 1 ] ^ c[ 2 ];
+      twosCarry = ( c[ 0 ] & c[ 1 ] ) | ( c[ 2 ] & ( c[ 0 ] ^ c[ 1 ] ) );
+
+      /* sum = ones + 2*(onesCarry + twos) + 4*twosCarry, whose bits are
+       * ones, b1, b2, and b3; five or more is b3, or b2 and anything
+       * below it */
+
+      b1 = onesCarry ^ twos;
+      b2 = ( onesCarry & twos ) ^ twosCarry;
+      b3 = onesCarry & twos & twosCarry;
+
+      bits[ k ] = ( b3 | ( b2 & ( b1 | ones ) ) ) & JBMazeMask::m_span( k, 0, mask->m_width );
+    }
+
+    /* move down a row, keeping the current row as it was */
+
+    memcpy( above, here, stride * sizeof( uint64_t ) );
+    memcpy( here, below, stride * sizeof( uint64_t ) );
+  }
+
+  delete[] above;
+  delete[] here;
+  delete[] zero;
+
+  mask->m_discardRuns();
+}
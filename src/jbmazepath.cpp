@@ -0,0 +1,198 @@
+/* ---------------------------------------------------------------------- *
+ * This file is in the public domain, and may be used, modified, and
+ * distributed without restriction.
+ * ---------------------------------------------------------------------- *
+ * JBMazePath
+ *
+ * Author: Jamis Buck <jamis@jamisbuck.org>
+ * Homepage: http://github.com/jamis/dnd-dungeon
+ * ---------------------------------------------------------------------- */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "jbmazepath.h"
+
+const int JBMazePath::c_CODES_PER_WORD = 21;
+const int JBMazePath::c_CHECKPOINT = 21 * 32;
+
+
+JBMazePath::JBMazePath() {
+  m_start = JBMazePt( 0, 0, 0 );
+  m_length = 0;
+  m_words = 0;
+  m_checkpoints = 0;
+  m_checkpointsValid = 0;
+  m_cursor = 0;
+  m_cursorPt = m_start;
+}
+
+
+JBMazePath::~JBMazePath() {
+  m_deallocate();
+}
+
+
+void JBMazePath::clear() {
+  m_deallocate();
+  m_start = JBMazePt( 0, 0, 0 );
+  m_length = 0;
+  m_cursor = 0;
+  m_cursorPt = m_start;
+}
+
+
+void JBMazePath::reset( const JBMazePt& start, long length ) {
+  long words;
+
+  clear();
+  if( length < 1 ) {
+    return;
+  }
+
+  m_start = start;
+  m_length = length;
+  m_cursorPt = start;
+
+  words = ( length - 1 + c_CODES_PER_WORD - 1 ) / c_CODES_PER_WORD;
+  if( words > 0 ) {
+    m_words = (uint64_t*)malloc( words * sizeof( uint64_t ) );
+    memset( m_words, 0, words * sizeof( uint64_t ) );
+  }
+  m_checkpoints = (JBMazePt*)malloc( ( ( length - 1 ) / c_CHECKPOINT + 1 ) * sizeof( JBMazePt ) );
+}
+
+
+void JBMazePath::setDirection( long i, int direction ) {
+  uint64_t* word;
+  int shift;
+  int code;
+
+  if( ( i < 0 ) || ( i >= m_length - 1 ) ) {
+    return;
+  }
+
+  for( code = 0; ( code < 5 ) && !( direction & ( 1 << code ) ); code++ )
+    ;
+
+  word = &m_words[ i / c_CODES_PER_WORD ];
+  shift = 3 * (int)( i % c_CODES_PER_WORD );
+  *word = ( *word & ~( (uint64_t)0x7 << shift ) ) | ( (uint64_t)code << shift );
+
+  /* the points after it have moved */
+
+  m_checkpointsValid = 0;
+  m_cursor = 0;
+  m_cursorPt = m_start;
+}
+
+
+JBMazePt JBMazePath::getStep( long i ) {
+  JBMazePt pt;
+  long from;
+
+  if( ( i < 0 ) || ( i >= m_length ) ) {
+    return m_start;
+  }
+
+  if( !m_checkpointsValid ) {
+    m_buildCheckpoints();
+  }
+
+  /* walk from the checkpoint before i, unless the point last asked for
+   * is between them */
+
+  from = i / c_CHECKPOINT * c_CHECKPOINT;
+  if( ( m_cursor <= i ) && ( m_cursor >= from ) ) {
+    from = m_cursor;
+    pt = m_cursorPt;
+  } else {
+    pt = m_checkpoints[ from / c_CHECKPOINT ];
+  }
+
+  for( ; from < i; from++ ) {
+    m_move( m_code( from ), &pt );
+  }
+
+  m_cursor = i;
+  m_cursorPt = pt;
+  return pt;
+}
+
+
+long JBMazePath::getMemoryUsage() {
+  long bytes;
+
+  bytes = sizeof( JBMazePath );
+  if( m_length > 0 ) {
+    bytes += ( m_length - 1 + c_CODES_PER_WORD - 1 ) / c_CODES_PER_WORD * sizeof( uint64_t );
+    bytes += ( ( m_length - 1 ) / c_CHECKPOINT + 1 ) * sizeof( JBMazePt );
+  }
+
+  return bytes;
+}
+
+
+void JBMazePath::m_move( int code, JBMazePt* pt ) {
+  switch( code ) {
+    case 0: pt->y--; break;   /* c_NORTH */
+    case 1: pt->y++; break;   /* c_SOUTH */
+    case 2: pt->x--; break;   /* c_WEST */
+    case 3: pt->x++; break;   /* c_EAST */
+    case 4: pt->z--; break;   /* c_UP */
+    case 5: pt->z++; break;   /* c_DOWN */
+  }
+}
+
+
+void JBMazePath::m_deallocate() {
+  free( m_words );
+  free( m_checkpoints );
+  m_words = 0;
+  m_checkpoints = 0;
+  m_checkpointsValid = 0;
+}
+
+
+void JBMazePath::m_buildCheckpoints() {
+  JBMazePt pt;
+  long i;
+
+  pt = m_start;
+  for( i = 0; i < m_length; i++ ) {
+    if( i % c_CHECKPOINT == 0 ) {
+      m_checkpoints[ i / c_CHECKPOINT ] = pt;
+    }
+    if( i + 1 < m_length ) {
+      m_move( m_code( i ), &pt );
+    }
+  }
+
+  m_checkpointsValid = 1;
+}
+
+
+JBMazePathIterator::JBMazePathIterator( JBMazePath* path ) {
+  m_path = path;
+  m_index = 0;
+  m_pt = path->m_start;
+  m_word = ( path->m_length > 1 ? path->m_words[ 0 ] : 0 );
+}
+
+
+void JBMazePathIterator::next() {
+  if( m_index >= m_path->m_length ) {
+    return;
+  }
+
+  if( m_index + 1 < m_path->m_length ) {
+    JBMazePath::m_move( (int)( m_word & 0x7 ), &m_pt );
+  }
+  m_index++;
+
+  if( m_index % JBMazePath::c_CODES_PER_WORD != 0 ) {
+    m_word >>= 3;
+  } else if( m_index + 1 < m_path->m_length ) {
+    m_word = m_path->m_words[ m_index / JBMazePath::c_CODES_PER_WORD ];
+  }
+}
@@ -0,0 +1,98 @@
+/* ---------------------------------------------------------------------- *
+ * This file is in the public domain, and may be used, modified, and
+ * distributed without restriction.
+ * ---------------------------------------------------------------------- *
+ * JBMazePlanes
+ *
+ * Author: Jamis Buck <jamis@jamisbuck.org>
+ * Homepage: http://github.com/jamis/dnd-dungeon
+ * ---------------------------------------------------------------------- */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "jbmazeplanes.h"
+
+
+JBMazePlanes::JBMazePlanes( int x, int y, int z ) {
+  m_x = x;
+  m_rows = (long)y * z;
+  m_wordsPerRow = ( x + 63 ) / 64;
+  m_words = (uint64_t*)calloc( c_PLANES * m_rows * m_wordsPerRow, sizeof( uint64_t ) );
+}
+
+
+JBMazePlanes::~JBMazePlanes() {
+  free( m_words );
+}
+
+
+void JBMazePlanes::mirror( const unsigned char* cells ) {
+  const unsigned char* src;
+  uint64_t bits[ c_PLANES ];
+  uint64_t eight;
+  long     stride;
+  long     row;
+  long     at;
+  int      word;
+  int      count;
+  int      k;
+  int      i;
+
+  /* eight cells are read at once, and bit i of each of their bytes is
+   * gathered into the top byte of the product by a multiply (the bit of
+   * byte j lands on bit 56 + j, and no two partial products overlap) */
+
+  stride = m_rows * m_wordsPerRow;
+
+  for( row = 0; row < m_rows; row++ ) {
+    for( word = 0; word < m_wordsPerRow; word++ ) {
+      src = cells + row * m_x + word * 64;
+      count = m_x - word * 64;
+      if( count > 64 ) {
+        count = 64;
+      }
+
+      for( i = 0; i < c_PLANES; i++ ) {
+        bits[ i ] = 0;
+      }
+
+      for( k = 0; k + 8 <= count; k += 8 ) {
+        memcpy( &eight, src + k, sizeof( eight ) );
+        for( i = 0; i < c_PLANES; i++ ) {
+          bits[ i ] |= ( ( ( ( eight >> i ) & 0x0101010101010101ULL ) * 0x0102040810204080ULL ) >> 56 ) << k;
+        }
+      }
+
+      for( ; k < count; k++ ) {
+        for( i = 0; i < c_PLANES; i++ ) {
+          bits[ i ] |= (uint64_t)( ( src[ k ] >> i ) & 1 ) << k;
+        }
+      }
+
+      at = row * m_wordsPerRow + word;
+      for( i = 0; i < c_PLANES; i++ ) {
+        m_words[ i * stride + at ] = bits[ i ];
+      }
+    }
+  }
+}
+
+
+long JBMazePlanes::countDeadends() {
+  uint64_t bits;
+  long     count;
+  long     row;
+  int      word;
+
+  count = 0;
+  for( row = 0; row < m_rows; row++ ) {
+    for( word = 0; word < m_wordsPerRow; word++ ) {
+      for( bits = getDeadends( row, word ); bits != 0; bits &= bits - 1 ) {
+        count++;
+      }
+    }
+  }
+
+  return count;
+}
@@ -0,0 +1,100 @@
+/* ---------------------------------------------------------------------- *
+ * This file is in the public domain, and may be used, modified, and
+ * distributed without restriction.
+ * ---------------------------------------------------------------------- *
+ * JBMazeSnapshot
+ *
+ * Author: Jamis Buck <jamis@jamisbuck.org>
+ * Homepage: http://github.com/jamis/dnd-dungeon
+ * ---------------------------------------------------------------------- */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "jbmazesnapshot.h"
+
+
+JBMazeSnapshot::JBMazeSnapshot( JBMaze* maze ) {
+  m_x = maze->m_x;
+  m_y = maze->m_y;
+  m_z = maze->m_z;
+  m_start = maze->m_start;
+  m_end = maze->m_end;
+  m_seed = maze->m_seed;
+  m_randomness = maze->m_randomness;
+  m_compatibility = maze->m_compatibility;
+  m_generic = maze->m_generic;
+  m_connectorRadius = maze->m_connectorRadius;
+  m_advice = maze->m_advice;
+  m_algorithm = maze->m_algorithm;
+  m_random = maze->m_random;
+  m_mask = maze->m_mask->retain();
+
+  m_size = ( maze->m_maze != 0 ? maze->getMemoryUsage() : 0 );
+  m_cells = 0;
+  m_fd = -1;
+
+  if( m_size > 0 ) {
+    m_fd = JBMazeStorage::share( maze->m_maze, m_size );
+    if( m_fd < 0 ) {
+      m_cells = new unsigned char[ m_size ];
+      memcpy( m_cells, maze->m_maze, m_size );
+    }
+  }
+}
+
+
+JBMazeSnapshot::~JBMazeSnapshot() {
+  if( m_fd >= 0 ) {
+    close( m_fd );
+  }
+  delete[] m_cells;
+  m_mask->release();
+}
+
+
+JBMaze* JBMazeSnapshot::branch() {
+  JBMazeStorage* storage;
+  JBMaze*        maze;
+
+  maze = new JBMaze( m_x, m_y, m_z, m_seed, m_randomness,
+                     m_start.x, m_start.y, m_start.z, m_end.x, m_end.y, m_end.z );
+  if( m_size == 0 ) {
+    return maze;
+  }
+
+  if( m_algorithm > JBMaze::c_HUNTANDKILL ) {
+    maze->setAlgorithm( m_algorithm );
+  }
+
+  maze->m_mask->release();
+  maze->m_mask = m_mask->retain();
+
+  maze->m_compatibility = m_compatibility;
+  maze->m_random = m_random;
+  maze->m_generic = m_generic;
+  maze->m_connectorRadius = m_connectorRadius;
+  maze->m_advice = m_advice;
+
+  /* swap the block the maze was made with for a view of the snapshot's
+   * (or, failing that, a copy of its cells) */
+
+  if( m_fd >= 0 ) {
+    storage = JBMazeStorage::view( m_fd, m_size );
+    if( storage != 0 ) {
+      maze->m_deallocateMaze();
+      maze->m_storage = storage;
+      maze->m_maze = (unsigned char*)storage->getBlock();
+      return maze;
+    }
+  }
+
+  if( m_cells != 0 ) {
+    memcpy( maze->m_maze, m_cells, m_size );
+  } else if( pread( m_fd, maze->m_maze, m_size, 0 ) != m_size ) {
+    memset( maze->m_maze, 0, m_size );
+  }
+
+  return maze;
+}
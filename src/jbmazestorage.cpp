@@ -0,0 +1,214 @@
+/* ---------------------------------------------------------------------- *
+ * This file is in the public domain, and may be used, modified, and
+ * distributed without restriction.
+ * ---------------------------------------------------------------------- *
+ * JBMazeStorage
+ *
+ * Author: Jamis Buck <jamis@jamisbuck.org>
+ * Homepage: http://github.com/jamis/dnd-dungeon
+ * ---------------------------------------------------------------------- */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "jbmazestorage.h"
+
+const int JBMazeStorage::c_NORMAL     = MADV_NORMAL;
+const int JBMazeStorage::c_SEQUENTIAL = MADV_SEQUENTIAL;
+const int JBMazeStorage::c_RANDOM     = MADV_RANDOM;
+const int JBMazeStorage::c_WILLNEED   = MADV_WILLNEED;
+
+const int  JBMazeStorage::c_ALIGNMENT = 64;
+const long JBMazeStorage::c_ANONYMOUS_SIZE = 1L << 20;
+
+
+JBMazeStorage::JBMazeStorage( const char* path, long size, int temporary ) {
+  void* block;
+  int   fd;
+
+  m_block = 0;
+  m_size = 0;
+  m_mapped = 0;
+  m_anonymous = 0;
+  m_private = 0;
+
+  if( size < 1 ) {
+    return;
+  }
+
+  /* a large block is mapped from no file at all, which the kernel zeroes
+   * a page at a time as it is touched.  Clearing it here would touch every
+   * page at once, whether or not it is ever used. */
+
+  if( ( path == 0 ) && ( size >= c_ANONYMOUS_SIZE ) ) {
+    block = mmap( 0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+    if( block != MAP_FAILED ) {
+      m_block = block;
+      m_size = size;
+      m_anonymous = 1;
+    }
+    return;
+  }
+
+  if( path == 0 ) {
+    if( posix_memalign( &block, c_ALIGNMENT, size ) != 0 ) {
+      return;
+    }
+    memset( block, 0, size );
+    m_block = block;
+    m_size = size;
+    return;
+  }
+
+  /* truncating the file first, and then growing it, makes it a sparse
+   * file of zeroes: no page of it is written until a cell in it is */
+
+  fd = open( path, O_RDWR | O_CREAT, 0644 );
+  if( fd < 0 ) {
+    return;
+  }
+
+  if( ( ftruncate( fd, 0 ) == 0 ) && ( ftruncate( fd, size ) == 0 ) ) {
+    block = mmap( 0, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+    if( block != MAP_FAILED ) {
+      m_block = block;
+      m_size = size;
+      m_mapped = 1;
+    }
+  }
+
+  close( fd );
+  if( temporary ) {
+    unlink( path );
+  }
+}
+
+
+JBMazeStorage::JBMazeStorage() {
+  m_block = 0;
+  m_size = 0;
+  m_mapped = 0;
+  m_anonymous = 0;
+  m_private = 0;
+}
+
+
+JBMazeStorage* JBMazeStorage::view( int fd, long size ) {
+  JBMazeStorage* storage;
+  void* block;
+
+  if( ( fd < 0 ) || ( size < 1 ) ) {
+    return 0;
+  }
+
+  block = mmap( 0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0 );
+  if( block == MAP_FAILED ) {
+    return 0;
+  }
+
+  storage = new JBMazeStorage();
+  storage->m_block = block;
+  storage->m_size = size;
+  storage->m_private = 1;
+
+  return storage;
+}
+
+
+JBMazeStorage::~JBMazeStorage() {
+  if( m_mapped || m_anonymous || m_private ) {
+    munmap( m_block, m_size );
+  } else {
+    free( m_block );
+  }
+}
+
+
+int JBMazeStorage::share( const void* data, long size ) {
+  const char* from;
+  ssize_t     written;
+  FILE*       file;
+  int         fd;
+
+  /* a file with no name, in memory.  (A temporary file, removed at once,
+   * will do if memfd_create() fails.) */
+
+  fd = memfd_create( "jbmaze", MFD_CLOEXEC );
+  if( fd < 0 ) {
+    file = tmpfile();
+    if( file == 0 ) {
+      return -1;
+    }
+    fd = dup( fileno( file ) );
+    fclose( file );
+    if( fd < 0 ) {
+      return -1;
+    }
+  }
+
+  from = (const char*)data;
+  while( size > 0 ) {
+    written = write( fd, from, size );
+    if( written <= 0 ) {
+      close( fd );
+      return -1;
+    }
+    from += written;
+    size -= written;
+  }
+
+  return fd;
+}
+
+
+void JBMazeStorage::advise( int advice, long offset, long length ) {
+  if( m_range( &offset, &length ) ) {
+    madvise( (char*)m_block + offset, length, advice );
+  }
+}
+
+
+void JBMazeStorage::release( long offset, long length ) {
+  if( m_range( &offset, &length ) ) {
+    msync( (char*)m_block + offset, length, MS_ASYNC );
+    madvise( (char*)m_block + offset, length, MADV_DONTNEED );
+  }
+}
+
+
+void JBMazeStorage::flush() {
+  if( m_mapped ) {
+    msync( m_block, m_size, MS_SYNC );
+  }
+}
+
+
+int JBMazeStorage::m_range( long* offset, long* length ) {
+  long page;
+  long end;
+
+  if( !m_mapped ) {
+    return 0;
+  }
+
+  /* widen the range to whole pages.  The block itself begins on a page,
+   * so only the offset needs rounding down. */
+
+  page = sysconf( _SC_PAGESIZE );
+  end = ( *length < 0 ? m_size : *offset + *length );
+  if( end > m_size ) {
+    end = m_size;
+  }
+
+  *offset -= *offset % page;
+  if( *offset >= end ) {
+    return 0;
+  }
+
+  *length = end - *offset;
+  return 1;
+}
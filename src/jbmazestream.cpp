@@ -0,0 +1,662 @@
+/* ---------------------------------------------------------------------- *
+ * This file is in the public domain, and may be used, modified, and
+ * distributed without restriction.
+ * ---------------------------------------------------------------------- *
+ * JBMazeStream
+ *
+ * Author: Jamis Buck <jamis@jamisbuck.org>
+ * Homepage: http://github.com/jamis/dnd-dungeon
+ * ---------------------------------------------------------------------- */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "png.h"
+
+#include "jbmazestream.h"
+
+
+#define RED(x) ( ( x ) >> 16 )
+#define GREEN(x) ( ( ( x ) & 0x00FF00 ) >> 8 )
+#define BLUE(x) ( ( x ) & 0x0000FF )
+
+
+JBMazePNGSink::JBMazePNGSink( FILE* file, int pathWidth, int wallWidth, int border,
+                              long wallColor, long bgColor )
+{
+  m_file = file;
+  m_png = 0;
+  m_info = 0;
+  m_pixels = 0;
+  m_imageWidth = 0;
+  m_failed = 0;
+
+  /* walls are wallWidth+1 pixels thick, as in the console tool */
+
+  m_wallWidth = wallWidth + 1;
+  m_gridSize = pathWidth + m_wallWidth;
+  m_border = border;
+  m_wallColor = wallColor;
+  m_bgColor = bgColor;
+}
+
+
+JBMazePNGSink::~JBMazePNGSink() {
+  png_structp png = (png_structp)m_png;
+  png_infop   info = (png_infop)m_info;
+
+  if( png != 0 ) {
+    png_destroy_write_struct( &png, &info );
+  }
+  delete[] m_pixels;
+}
+
+
+int JBMazePNGSink::fits( int width, long height ) {
+  return ( ( m_border * 2L + (long)m_gridSize * width + m_wallWidth <= PNG_UINT_31_MAX ) &&
+           ( height <= ( PNG_UINT_31_MAX - m_border * 2L - m_wallWidth ) / m_gridSize ) );
+}
+
+
+void JBMazePNGSink::begin( int width, long height ) {
+  png_structp png;
+  png_infop   info;
+  long        imageHeight;
+
+  if( !fits( width, height ) ) {
+    fprintf( stderr, "a %d by %ld maze is too large to draw as a PNG (at most %lu pixels a side)\n",
+             width, height, (unsigned long)PNG_UINT_31_MAX );
+    m_failed = 1;
+    return;
+  }
+
+  m_imageWidth = m_border * 2 + m_gridSize * width + m_wallWidth;
+  imageHeight = m_border * 2 + m_gridSize * height + m_wallWidth;
+
+  m_pixels = new unsigned char[ m_imageWidth * 3L ];
+
+  /* libpng reports an error by printing it and jumping back here, after
+   * which the rest of the image is ignored, since there is no useful way
+   * to recover from a half-written stream.  Every method that calls
+   * libpng sets the jump first. */
+
+  png = png_create_write_struct( PNG_LIBPNG_VER_STRING, 0, 0, 0 );
+  info = ( png != 0 ? png_create_info_struct( png ) : 0 );
+  m_png = png;
+  m_info = info;
+
+  if( info == 0 ) {
+    m_failed = 1;
+    return;
+  }
+
+  if( setjmp( png_jmpbuf( png ) ) ) {
+    m_failed = 1;
+    return;
+  }
+
+  /* libpng refuses, by default, to write images more than a million
+   * pixels wide or tall */
+
+  png_init_io( png, m_file );
+  png_set_user_limits( png, PNG_UINT_31_MAX, PNG_UINT_31_MAX );
+  png_set_IHDR( png, info, m_imageWidth, (png_uint_32)imageHeight, 8,
+                PNG_COLOR_TYPE_RGB, PNG_INTERLACE_NONE,
+                PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT );
+  png_write_info( png, info );
+
+  m_fill( 0, m_imageWidth, m_bgColor );
+  m_writeRows( m_border );
+}
+
+
+void JBMazePNGSink::row( long y, const unsigned char* exits, int width ) {
+  int pass;
+  int x;
+  int left;
+
+  if( m_failed || setjmp( png_jmpbuf( (png_structp)m_png ) ) ) {
+    m_failed = 1;
+    return;
+  }
+
+  /* each row of cells is drawn as two kinds of pixel rows: the ones that
+   * cross the northern walls, and the ones that cross the passages. */
+
+  for( pass = 0; pass < 2; pass++ ) {
+    m_fill( 0, m_imageWidth, m_bgColor );
+
+    for( x = 0; x < width; x++ ) {
+      left = m_border + x * m_gridSize;
+
+      if( exits[ x ] == 0 ) {
+        m_fill( left, left + m_gridSize, m_wallColor );
+        continue;
+      }
+
+      /* the corner post */
+      m_fill( left, left + m_wallWidth, m_wallColor );
+
+      if( pass == 0 ) {
+        if( ( exits[ x ] & JBMaze::c_NORTH ) == 0 ) {
+          m_fill( left, left + m_gridSize, m_wallColor );
+        }
+      } else if( ( exits[ x ] & JBMaze::c_WEST ) != 0 ) {
+        m_fill( left, left + m_wallWidth, m_bgColor );
+      }
+    }
+
+    /* the eastern edge of the maze */
+    left = m_border + width * m_gridSize;
+    m_fill( left, left + m_wallWidth, m_wallColor );
+
+    m_writeRows( pass == 0 ? m_wallWidth : m_gridSize - m_wallWidth );
+  }
+}
+
+
+void JBMazePNGSink::end() {
+  int width;
+
+  if( m_failed || setjmp( png_jmpbuf( (png_structp)m_png ) ) ) {
+    m_failed = 1;
+    fflush( m_file );
+    return;
+  }
+
+  width = ( m_imageWidth - m_border * 2 - m_wallWidth ) / m_gridSize;
+
+  /* the southern edge of the maze, and the bottom border */
+
+  m_fill( 0, m_imageWidth, m_bgColor );
+  m_fill( m_border, m_border + width * m_gridSize + m_wallWidth, m_wallColor );
+  m_writeRows( m_wallWidth );
+
+  m_fill( 0, m_imageWidth, m_bgColor );
+  m_writeRows( m_border );
+
+  png_write_end( (png_structp)m_png, (png_infop)m_info );
+
+  if( ( fflush( m_file ) != 0 ) || ferror( m_file ) ) {
+    fprintf( stderr, "the PNG could not be written\n" );
+    m_failed = 1;
+  }
+}
+
+
+void JBMazePNGSink::m_fill( int from, int to, long color ) {
+  int i;
+
+  for( i = from; i < to; i++ ) {
+    m_pixels[ i*3L ] = RED( color );
+    m_pixels[ i*3L+1 ] = GREEN( color );
+    m_pixels[ i*3L+2 ] = BLUE( color );
+  }
+}
+
+
+void JBMazePNGSink::m_writeRows( int count ) {
+  int i;
+
+  for( i = 0; i < count; i++ ) {
+    png_write_row( (png_structp)m_png, m_pixels );
+  }
+}
+
+
+JBMazeStream::JBMazeStream( int width, long height, long seed, int randomness ) {
+  m_width = width;
+  m_height = height;
+  m_seed = seed;
+  m_randomness = randomness;
+  m_mask = 0;
+  m_labels = 0;
+  m_labelRows = 0;
+  m_memoryUsage = 0;
+}
+
+
+JBMazeStream::~JBMazeStream() {
+  if( m_mask != 0 ) {
+    m_mask->release();
+  }
+}
+
+
+void JBMazeStream::setMask( JBMazeMask* mask ) {
+  if( m_mask != 0 ) {
+    m_mask->release();
+  }
+  m_mask = mask;
+  m_width = m_mask->getWidth();
+}
+
+
+int JBMazeStream::m_find( int set ) {
+  while( m_parent[ set ] != set ) {
+    m_parent[ set ] = m_parent[ m_parent[ set ] ];
+    set = m_parent[ set ];
+  }
+  return set;
+}
+
+
+int JBMazeStream::m_newSet() {
+  int set;
+
+  set = m_free[ --m_freeCount ];
+  m_used[ set ] = 1;
+  return set;
+}
+
+
+static int joinedRoot( int* parent, int i ) {
+  while( parent[ i ] != i ) {
+    parent[ i ] = parent[ parent[ i ] ];
+    i = parent[ i ];
+  }
+  return i;
+}
+
+
+int JBMazeStream::m_runsOf( long y, int* runs ) {
+  int row;
+  int count;
+  int x;
+
+  row = (int)( y % m_mask->getHeight() );
+  count = 0;
+  for( x = 0; x < m_width; x++ ) {
+    if( !m_mask->getMaskAt( x, row ) ) {
+      runs[ x ] = -1;
+    } else {
+      if( ( x == 0 ) || ( runs[ x-1 ] < 0 ) ) {
+        count++;
+      }
+      runs[ x ] = count - 1;
+    }
+  }
+
+  return count;
+}
+
+
+void JBMazeStream::m_findRegions() {
+  int*  runs;
+  int*  runsBelow;
+  int*  parent;
+  int*  first;
+  int*  labels;
+  int*  swap;
+  long* starts;
+  long  rowCapacity;
+  long  period;
+  long  below;
+  long  y;
+  long  rows;
+  int   count;
+  int   countBelow;
+  int   i;
+  int   x;
+
+  period = m_mask->getHeight();
+  rows = 0;
+
+  m_labelCount = 0;
+  m_labelCapacity = m_width;
+  m_labels = new int[ m_labelCapacity ];
+  rowCapacity = 64;
+  m_labelRows = new long[ rowCapacity ];
+  m_labelBase = 1;
+
+  runs = new int[ m_width ];
+  runsBelow = new int[ m_width ];
+  parent = new int[ 2 * m_width ];
+  first = new int[ 2 * m_width ];
+
+  below = -1;
+  countBelow = 0;
+
+  /* going up from the bottom, two runs of a row are in the same region
+   * if they are connected to the same region of the row below them.
+   * Once a row is labeled just as the row a mask's height below it was,
+   * every row above it is, too, so the rest need not be stored. */
+
+  for( y = m_height - 1; y >= 1; y-- ) {
+    count = m_runsOf( y, runs );
+
+    if( m_labelCount + count > m_labelCapacity ) {
+      m_labelCapacity = ( m_labelCount + count ) * 2;
+      labels = new int[ m_labelCapacity ];
+      memcpy( labels, m_labels, m_labelCount * sizeof( int ) );
+      delete[] m_labels;
+      m_labels = labels;
+    }
+    if( rows == rowCapacity ) {
+      rowCapacity *= 2;
+      starts = new long[ rowCapacity ];
+      memcpy( starts, m_labelRows, rows * sizeof( long ) );
+      delete[] m_labelRows;
+      m_labelRows = starts;
+    }
+
+    m_labelRows[ rows++ ] = m_labelCount;
+    labels = m_labels + m_labelCount;
+
+    for( i = 0; i < count + countBelow; i++ ) {
+      parent[ i ] = i;
+      first[ i ] = -1;
+    }
+
+    if( below >= 0 ) {
+      for( x = 0; x < m_width; x++ ) {
+        if( ( runs[ x ] >= 0 ) && ( runsBelow[ x ] >= 0 ) ) {
+          parent[ joinedRoot( parent, runs[ x ] ) ] =
+            joinedRoot( parent, count + m_labels[ below + runsBelow[ x ] ] );
+        }
+      }
+    }
+
+    for( i = 0; i < count; i++ ) {
+      x = joinedRoot( parent, i );
+      if( first[ x ] < 0 ) {
+        first[ x ] = i;
+      }
+      labels[ i ] = first[ x ];
+    }
+
+    m_labelCount += count;
+
+    if( ( y + period <= m_height - 1 ) &&
+        ( memcmp( labels, m_labels + m_labelRows[ m_height - 1 - y - period ],
+                  count * sizeof( int ) ) == 0 ) )
+    {
+      m_labelBase = y;
+      break;
+    }
+
+    swap = runsBelow;
+    runsBelow = runs;
+    runs = swap;
+    below = m_labelRows[ rows - 1 ];
+    countBelow = count;
+  }
+
+  delete[] runs;
+  delete[] runsBelow;
+  delete[] parent;
+  delete[] first;
+
+  m_memoryUsage += m_labelCapacity * sizeof( int ) + rows * sizeof( long );
+}
+
+
+void JBMazeStream::m_freeRegions() {
+  delete[] m_labels;
+  delete[] m_labelRows;
+  m_labels = 0;
+  m_labelRows = 0;
+}
+
+
+const int* JBMazeStream::m_regionsOf( long y ) {
+  long period;
+
+  if( y < m_labelBase ) {
+    period = m_mask->getHeight();
+    y = m_labelBase + ( period - ( m_labelBase - y ) % period ) % period;
+  }
+
+  return m_labels + m_labelRows[ m_height - 1 - y ];
+}
+
+
+void JBMazeStream::generate( JBMazeRowSink* sink ) {
+  unsigned char* valid;
+  unsigned char* validBelow;
+  unsigned char* swap;
+  const int*     labels;
+  int*           regions;
+  long           y;
+  int            x;
+  int            a;
+  int            b;
+  int            run;
+  int            last;
+  int            joined;
+  int            chance;
+
+  if( ( m_width < 1 ) || ( m_height < 1 ) ) {
+    return;
+  }
+
+  m_random.seed( m_seed );
+
+  m_exits = new unsigned char[ m_width ];
+  m_sets = new int[ m_width ];
+  m_parent = new int[ m_width ];
+  m_free = new int[ m_width ];
+  m_candidates = new int[ m_width ];
+  m_down = new unsigned char[ m_width ];
+  m_used = new unsigned char[ m_width ];
+  m_joined = new int[ 2 * m_width ];
+  valid = new unsigned char[ m_width ];
+  validBelow = new unsigned char[ m_width ];
+  regions = new int[ m_width ];
+
+  m_memoryUsage = m_width * (long)( 7 * sizeof( int ) + 5 );
+  if( m_mask != 0 ) {
+    m_findRegions();
+  }
+
+  memset( m_exits, 0, m_width );
+  for( x = 0; x < m_width; x++ ) {
+    m_sets[ x ] = -1;
+    validBelow[ x ] = ( m_mask == 0 ? 1 : m_mask->getMaskAt( x, 0 ) );
+  }
+
+  sink->begin( m_width, m_height );
+
+  for( y = 0; y < m_height; y++ ) {
+    last = ( y + 1 == m_height );
+
+    swap = valid;
+    valid = validBelow;
+    validBelow = swap;
+
+    for( x = 0; x < m_width; x++ ) {
+      validBelow[ x ] = ( ( m_mask == 0 ) || last ? 1 :
+                          m_mask->getMaskAt( x, (int)( ( y + 1 ) % m_mask->getHeight() ) ) );
+    }
+
+    /* the region (of the rows from the next one down) that each cell of
+     * the next row belongs to, numbered from m_width */
+
+    if( ( m_mask != 0 ) && !last ) {
+      labels = m_regionsOf( y + 1 );
+      for( x = 0, run = -1; x < m_width; x++ ) {
+        if( validBelow[ x ] ) {
+          if( ( x == 0 ) || !validBelow[ x-1 ] ) {
+            run++;
+          }
+          regions[ x ] = m_width + labels[ run ];
+        }
+      }
+    }
+
+    /* release the ids of sets that did not make it down to this row, and
+     * give every cell that is not in a set a set of its own */
+
+    for( a = 0; a < m_width; a++ ) {
+      m_used[ a ] = 0;
+      m_parent[ a ] = a;
+    }
+    for( x = 0; x < m_width; x++ ) {
+      if( m_sets[ x ] >= 0 ) {
+        m_used[ m_sets[ x ] ] = 1;
+      }
+    }
+    for( m_freeCount = 0, a = m_width - 1; a >= 0; a-- ) {
+      if( !m_used[ a ] ) {
+        m_free[ m_freeCount++ ] = a;
+      }
+    }
+    for( x = 0; x < m_width; x++ ) {
+      if( valid[ x ] && ( m_sets[ x ] < 0 ) ) {
+        m_sets[ x ] = m_newSet();
+      }
+    }
+
+    /* join adjacent cells in different sets.  A run that has just been
+     * joined is more likely to continue the lower the randomness is. */
+
+    joined = 0;
+    for( x = 0; x + 1 < m_width; x++ ) {
+      if( !valid[ x ] || !valid[ x+1 ] ) {
+        joined = 0;
+        continue;
+      }
+
+      a = m_find( m_sets[ x ] );
+      b = m_find( m_sets[ x+1 ] );
+
+      chance = 50;
+      if( joined ) {
+        chance += ( 100 - m_randomness ) / 2;
+      }
+
+      if( ( a != b ) && ( last || ( m_random.next( 100 ) < chance ) ) ) {
+        m_parent[ b ] = a;
+        m_exits[ x ] |= JBMaze::c_EAST;
+        m_exits[ x+1 ] |= JBMaze::c_WEST;
+        joined = 1;
+      } else {
+        joined = 0;
+      }
+    }
+
+    for( x = 0; x < m_width; x++ ) {
+      if( m_sets[ x ] >= 0 ) {
+        m_sets[ x ] = m_find( m_sets[ x ] );
+      }
+    }
+
+    /* every set must continue down at least once (if it can), or part
+     * of the maze would be cut off.  First, let each cell go down at
+     * random, and then choose one cell (uniformly) from each set that has
+     * not gone down yet. */
+
+    if( !last ) {
+      for( a = 0; a < m_width; a++ ) {
+        m_candidates[ a ] = 0;
+        m_down[ a ] = 0;
+      }
+
+      for( x = 0; x < m_width; x++ ) {
+        if( ( m_sets[ x ] >= 0 ) && validBelow[ x ] ) {
+          m_candidates[ m_sets[ x ] ]++;
+          if( m_random.next( 2 ) == 0 ) {
+            m_exits[ x ] |= JBMaze::c_SOUTH;
+            m_down[ m_sets[ x ] ] = 1;
+          }
+        }
+      }
+
+      for( x = 0; x < m_width; x++ ) {
+        a = m_sets[ x ];
+        if( ( a < 0 ) || m_down[ a ] || !validBelow[ x ] ) {
+          continue;
+        }
+        if( m_random.next( m_candidates[ a ] ) == 0 ) {
+          m_down[ a ] = 1;
+          m_exits[ x ] |= JBMaze::c_SOUTH;
+        } else {
+          m_candidates[ a ]--;
+        }
+      }
+    }
+
+    /* with a mask, that is not enough: a set may have no way down, and
+     * two sets that go down may never meet again.  Two sets will meet
+     * below if they go down into the same region, so join the sets and
+     * regions as they are now, and then look at every pair of adjacent
+     * cells, and every cell that could go down, in turn: if the two are
+     * not joined already, join them (as Kruskal's algorithm would).
+     * Afterward, every set and region that touch in this row are joined,
+     * and each region below is entered at least once. */
+
+    if( ( m_mask != 0 ) && !last ) {
+      for( a = 0; a < 2 * m_width; a++ ) {
+        m_joined[ a ] = a;
+      }
+      for( x = 0; x < m_width; x++ ) {
+        if( ( m_exits[ x ] & JBMaze::c_SOUTH ) != 0 ) {
+          m_joined[ joinedRoot( m_joined, m_sets[ x ] ) ] = joinedRoot( m_joined, regions[ x ] );
+        }
+      }
+
+      for( x = 0; x < m_width; x++ ) {
+        if( m_sets[ x ] < 0 ) {
+          continue;
+        }
+
+        if( validBelow[ x ] ) {
+          a = joinedRoot( m_joined, m_sets[ x ] );
+          b = joinedRoot( m_joined, regions[ x ] );
+          if( a != b ) {
+            m_joined[ a ] = b;
+            m_exits[ x ] |= JBMaze::c_SOUTH;
+          }
+        }
+
+        if( ( x + 1 < m_width ) && ( m_sets[ x+1 ] >= 0 ) ) {
+          a = joinedRoot( m_joined, m_sets[ x ] );
+          b = joinedRoot( m_joined, m_sets[ x+1 ] );
+          if( a != b ) {
+            m_joined[ b ] = a;
+            m_parent[ m_find( m_sets[ x+1 ] ) ] = m_find( m_sets[ x ] );
+            m_exits[ x ] |= JBMaze::c_EAST;
+            m_exits[ x+1 ] |= JBMaze::c_WEST;
+          }
+        }
+      }
+
+      for( x = 0; x < m_width; x++ ) {
+        if( m_sets[ x ] >= 0 ) {
+          m_sets[ x ] = m_find( m_sets[ x ] );
+        }
+      }
+    }
+
+    sink->row( y, m_exits, m_width );
+
+    /* carry the sets down to the next row */
+
+    for( x = 0; x < m_width; x++ ) {
+      if( ( m_exits[ x ] & JBMaze::c_SOUTH ) != 0 ) {
+        m_exits[ x ] = JBMaze::c_NORTH;
+      } else {
+        m_exits[ x ] = 0;
+        m_sets[ x ] = -1;
+      }
+    }
+  }
+
+  sink->end();
+
+  delete[] m_exits;
+  delete[] m_sets;
+  delete[] m_parent;
+  delete[] m_free;
+  delete[] m_candidates;
+  delete[] m_down;
+  delete[] m_used;
+  delete[] m_joined;
+  delete[] valid;
+  delete[] validBelow;
+  delete[] regions;
+
+  if( m_mask != 0 ) {
+    m_freeRegions();
+  }
+}
@@ -0,0 +1,171 @@
+/* ---------------------------------------------------------------------- *
+ * This file is in the public domain, and may be used, modified, and
+ * distributed without restriction.
+ * ---------------------------------------------------------------------- *
+ * JBRandom
+ *
+ * Author: Jamis Buck <jamis@jamisbuck.org>
+ * Homepage: http://github.com/jamis/dnd-dungeon
+ * ---------------------------------------------------------------------- */
+
+#include <stdlib.h>
+
+#include "jbrandom.h"
+
+
+const int JBRandom::c_XOSHIRO = 0;
+const int JBRandom::c_LEGACY  = 1;
+
+
+/* the number of bits set in each six-bit value, and the position of each
+ * of them, from the lowest up */
+
+const unsigned char JBRandom::c_BITS[ 64 ] = {
+  0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+  1, 2, 2, 3, 2, 3, 3, 4, 2, 3, 3, 4, 3, 4, 4, 5,
+  1, 2, 2, 3, 2, 3, 3, 4, 2, 3, 3, 4, 3, 4, 4, 5,
+  2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6
+};
+
+const unsigned char JBRandom::c_POSITION[ 64 ][ 6 ] = {
+  { 0, 0, 0, 0, 0, 0 },
+  { 0, 0, 0, 0, 0, 0 },
+  { 1, 0, 0, 0, 0, 0 },
+  { 0, 1, 0, 0, 0, 0 },
+  { 2, 0, 0, 0, 0, 0 },
+  { 0, 2, 0, 0, 0, 0 },
+  { 1, 2, 0, 0, 0, 0 },
+  { 0, 1, 2, 0, 0, 0 },
+  { 3, 0, 0, 0, 0, 0 },
+  { 0, 3, 0, 0, 0, 0 },
+  { 1, 3, 0, 0, 0, 0 },
+  { 0, 1, 3, 0, 0, 0 },
+  { 2, 3, 0, 0, 0, 0 },
+  { 0, 2, 3, 0, 0, 0 },
+  { 1, 2, 3, 0, 0, 0 },
+  { 0, 1, 2, 3, 0, 0 },
+  { 4, 0, 0, 0, 0, 0 },
+  { 0, 4, 0, 0, 0, 0 },
+  { 1, 4, 0, 0, 0, 0 },
+  { 0, 1, 4, 0, 0, 0 },
+  { 2, 4, 0, 0, 0, 0 },
+  { 0, 2, 4, 0, 0, 0 },
+  { 1, 2, 4, 0, 0, 0 },
+  { 0, 1, 2, 4, 0, 0 },
+  { 3, 4, 0, 0, 0, 0 },
+  { 0, 3, 4, 0, 0, 0 },
+  { 1, 3, 4, 0, 0, 0 },
+  { 0, 1, 3, 4, 0, 0 },
+  { 2, 3, 4, 0, 0, 0 },
+  { 0, 2, 3, 4, 0, 0 },
+  { 1, 2, 3, 4, 0, 0 },
+  { 0, 1, 2, 3, 4, 0 },
+  { 5, 0, 0, 0, 0, 0 },
+  { 0, 5, 0, 0, 0, 0 },
+  { 1, 5, 0, 0, 0, 0 },
+  { 0, 1, 5, 0, 0, 0 },
+  { 2, 5, 0, 0, 0, 0 },
+  { 0, 2, 5, 0, 0, 0 },
+  { 1, 2, 5, 0, 0, 0 },
+  { 0, 1, 2, 5, 0, 0 },
+  { 3, 5, 0, 0, 0, 0 },
+  { 0, 3, 5, 0, 0, 0 },
+  { 1, 3, 5, 0, 0, 0 },
+  { 0, 1, 3, 5, 0, 0 },
+  { 2, 3, 5, 0, 0, 0 },
+  { 0, 2, 3, 5, 0, 0 },
+  { 1, 2, 3, 5, 0, 0 },
+  { 0, 1, 2, 3, 5, 0 },
+  { 4, 5, 0, 0, 0, 0 },
+  { 0, 4, 5, 0, 0, 0 },
+  { 1, 4, 5, 0, 0, 0 },
+  { 0, 1, 4, 5, 0, 0 },
+  { 2, 4, 5, 0, 0, 0 },
+  { 0, 2, 4, 5, 0, 0 },
+  { 1, 2, 4, 5, 0, 0 },
+  { 0, 1, 2, 4, 5, 0 },
+  { 3, 4, 5, 0, 0, 0 },
+  { 0, 3, 4, 5, 0, 0 },
+  { 1, 3, 4, 5, 0, 0 },
+  { 0, 1, 3, 4, 5, 0 },
+  { 2, 3, 4, 5, 0, 0 },
+  { 0, 2, 3, 4, 5, 0 },
+  { 1, 2, 3, 4, 5, 0 },
+  { 0, 1, 2, 3, 4, 5 }
+};
+
+
+void JBRandom::seed( long seed, int source ) {
+  m_seed = seed;
+  m_source = source;
+
+  if( m_source == c_LEGACY ) {
+    if( seed > 0 ) {
+      srand( seed );
+    }
+    return;
+  }
+
+  m_seedState( (uint64_t)seed );
+}
+
+
+JBRandom JBRandom::split( int stream ) {
+  JBRandom random;
+  uint64_t x;
+
+  /* a legacy sub-stream is the same global sequence, and must not be
+   * reseeded */
+
+  random.m_source = m_source;
+  random.m_seed = m_seed;
+
+  if( m_source == c_LEGACY ) {
+    return random;
+  }
+
+  x = (uint64_t)m_seed ^ ( (uint64_t)( stream + 1 ) * 0x9E3779B97F4A7C15ULL );
+  m_splitmix( &x );
+  random.m_seed = (long)m_splitmix( &x );
+  random.m_seedState( (uint64_t)random.m_seed );
+
+  return random;
+}
+
+
+uint64_t JBRandom::m_splitmix( uint64_t* x ) {
+  uint64_t z;
+
+  z = ( *x += 0x9E3779B97F4A7C15ULL );
+  z = ( z ^ ( z >> 30 ) ) * 0xBF58476D1CE4E5B9ULL;
+  z = ( z ^ ( z >> 27 ) ) * 0x94D049BB133111EBULL;
+  return z ^ ( z >> 31 );
+}
+
+
+long JBRandom::m_nextWide( long n ) {
+  unsigned __int128 m;
+  uint64_t          t;
+
+  m = (unsigned __int128)m_next() * (uint64_t)n;
+  if( (uint64_t)m < (uint64_t)n ) {
+    t = -(uint64_t)n % (uint64_t)n;
+    while( (uint64_t)m < t ) {
+      m = (unsigned __int128)m_next() * (uint64_t)n;
+    }
+  }
+
+  return (long)( m >> 64 );
+}
+
+
+void JBRandom::m_seedState( uint64_t seed ) {
+  int i;
+
+  /* splitmix64 never gives four zeros in a row, which is the one state
+   * xoshiro256** cannot leave */
+
+  for( i = 0; i < 4; i++ ) {
+    m_state[ i ] = m_splitmix( &seed );
+  }
+}
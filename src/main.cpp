@@ -6,6 +6,9 @@
 #include <ctype.h>
 
 #include "jbmaze.h"
+#include "jbmazegenerator.h"
+#include "jbmazemaskgenerator.h"
+#include "jbmazestream.h"
 #include "gd.h"
 
 
@@ -34,7 +37,13 @@ typedef struct {
   long endClr;
   int  showSolution;
   int  showMarkers;
+  int  compatible;
+  int  algorithm;
+  int  stream;
+  int  metrics;
   char maskFile[256];
+  char maskPreset[256];
+  JBMazeMask* mask;       /* made from maskPreset, if given */
 } PARMOPTS;
 
 
@@ -345,6 +354,8 @@ int readParameters( char* file, PARMOPTS* opts ) {
       opts->endz = atoi( value );
     } else if( strcmp( parm, "mask" ) == 0 ) {
       strcpy( opts->maskFile, value );
+    } else if( strcmp( parm, "maskpreset" ) == 0 ) {
+      strcpy( opts->maskPreset, value );
     } else if( strcmp( parm, "seed" ) == 0 ) {
       opts->seed = atol( value );
     } else if( strcmp( parm, "border" ) == 0 ) {
@@ -369,6 +380,14 @@ int readParameters( char* file, PARMOPTS* opts ) {
       opts->showSolution = ( atoi( value ) != 0 );
     } else if( strcmp( parm, "markers" ) == 0 ) {
       opts->showMarkers = ( atoi( value ) != 0 );
+    } else if( strcmp( parm, "algorithm" ) == 0 ) {
+      opts->algorithm = JBMazeGenerator::findAlgorithm( value );
+    } else if( strcmp( parm, "stream" ) == 0 ) {
+      opts->stream = ( atoi( value ) != 0 );
+    } else if( strcmp( parm, "metrics" ) == 0 ) {
+      opts->metrics = ( atoi( value ) != 0 );
+    } else if( strcmp( parm, "compatible" ) == 0 ) {
+      opts->compatible = ( atoi( value ) != 0 );
     } else if( strcmp( parm, "include" ) == 0 ) {
       readParameters( value, opts );
     }
@@ -395,7 +414,10 @@ void printHelp(void) {
     "  -X n     : set maze ending x coordinate to n\n"
     "  -Y n     : set maze ending y coordinate to n\n"
     "  -Z n     : set maze ending z coordinate to n\n"
-    "  -m file  : use file to define the maze mask\n"
+    "  -m file  : use file (text, PBM, or PNG) to define the maze mask\n"
+    "  -k name  : make the maze mask from the named preset: noise, blobs,\n"
+    "             island, or caverns (\"name,n\" makes it from seed n, rather\n"
+    "             than the maze's seed; ignored if -m is given)\n"
     "  -S n     : use n as the random seed for the maze\n"
     "  -b n     : set the outer margin to n pixels\n"
     "  -W n     : set the wall width to n pixels\n"
@@ -409,6 +431,16 @@ void printHelp(void) {
     "  -L n     : set n to non-zero to show maze solution\n"
     "  -M n     : set n to non-zero to show start/end positions\n"
     "  -f file  : read configuration options from file\n"
+    "  -c n     : set n to non-zero to reproduce mazes made by older versions\n"
+    "  -a name  : generate with the named algorithm: huntandkill (default),\n"
+    "             backtracker, growingtree, kruskal, wilson, tiled, layered,\n"
+    "             or stream (a row at a time, like -G, but into the whole\n"
+    "             maze, so that it may still be solved and sparsified)\n"
+    "  -G n     : set n to non-zero to generate the maze a row at a time,\n"
+    "             writing the image as it goes (two dimensions only; the\n"
+    "             size, seed, randomness, mask, and wall options apply)\n"
+    "  -I n     : set n to non-zero to print the shape of the maze (deadends,\n"
+    "             junctions, straightness, and so on) to stderr\n"
   );
 
   exit(-1);
@@ -457,6 +489,7 @@ int parseArgs(int argc, char* argv[], PARMOPTS* opts) {
       case 'Y': opts->endy = atoi(argv[++i]); break;
       case 'Z': opts->endz = atoi(argv[++i]); break;
       case 'm': strcpy( opts->maskFile, argv[++i] ); break;
+      case 'k': strcpy( opts->maskPreset, argv[++i] ); break;
       case 'S': opts->seed = atol(argv[++i]); break;
       case 'b': opts->ofs = atoi(argv[++i]); break;
       case 'W': opts->wallWid = atoi(argv[++i]); break;
@@ -470,12 +503,32 @@ int parseArgs(int argc, char* argv[], PARMOPTS* opts) {
       case 'L': opts->showSolution = atoi(argv[++i]); break;
       case 'M': opts->showMarkers = atoi(argv[++i]); break;
       case 'f': readParameters( argv[++i], opts ); break;
+      case 'c': opts->compatible = atoi(argv[++i]); break;
+      case 'a': opts->algorithm = JBMazeGenerator::findAlgorithm(argv[++i]); break;
+      case 'G': opts->stream = atoi(argv[++i]); break;
+      case 'I': opts->metrics = atoi(argv[++i]); break;
       default:
         fprintf(stderr, "unsupported argument: %s\n\n", argv[i]);
         printHelp();
     }
   }
 
+  if(opts->algorithm < 0) {
+    fprintf(stderr, "unknown algorithm\n\n");
+    printHelp();
+  }
+
+  /* a mask file takes the place of a preset, so the preset is only made
+   * when there is no file */
+
+  if( ( opts->maskPreset[0] != 0 ) && ( opts->maskFile[0] == 0 ) ) {
+    opts->mask = JBMazeMaskGenerator::create( opts->maskPreset, opts->width, opts->height, opts->seed );
+    if( opts->mask == 0 ) {
+      fprintf(stderr, "unknown mask preset\n\n");
+      printHelp();
+    }
+  }
+
   if(opts->endx < 0) opts->endx = opts->width-1;
   if(opts->endy < 0) opts->endy = opts->height-1;
   if(opts->endz < 0) opts->endz = opts->depth-1;
@@ -483,6 +536,57 @@ int parseArgs(int argc, char* argv[], PARMOPTS* opts) {
   return 1;
 }
 
+int streamMaze( PARMOPTS* opts ) {
+  JBMazeStream* stream;
+  JBMazePNGSink* sink;
+  int failed;
+
+  /* the maze is never held in memory, so it cannot be solved, sparsified,
+   * or have its deadends cleared */
+
+  stream = new JBMazeStream( opts->width, opts->height, opts->seed, opts->randomness );
+
+  if( opts->maskFile[0] != 0 ) {
+    stream->setMask( JBMazeMask::load( opts->maskFile ) );
+  } else if( opts->mask != 0 ) {
+    stream->setMask( opts->mask );
+  }
+
+  sink = new JBMazePNGSink( stdout, opts->pathWid, opts->wallWid, opts->ofs,
+                            opts->wallClr, opts->bgColor );
+
+  /* a PNG may be at most 2^31-1 pixels tall, so a maze too tall to draw
+   * is refused before any of it is generated */
+
+  if( sink->fits( stream->getWidth(), stream->getHeight() ) ) {
+    stream->generate( sink );
+    failed = sink->hasFailed();
+  } else {
+    fprintf( stderr, "the maze is too large to draw as a PNG\n" );
+    failed = 1;
+  }
+
+  delete sink;
+  delete stream;
+
+  return failed;
+}
+
+void printMetrics( JBMaze* maze ) {
+  JBMazeMetrics metrics;
+
+  maze->measure( &metrics );
+
+  fprintf( stderr, "cells: %ld in the mask, %ld with passages (%.1f%% coverage)\n",
+           metrics.cells, metrics.passages, metrics.coverage * 100 );
+  fprintf( stderr, "deadends: %ld\n", metrics.deadends );
+  fprintf( stderr, "junctions: %ld\n", metrics.junctions );
+  fprintf( stderr, "corridors: %ld, %ld straight (river factor %.3f)\n",
+           metrics.corridors, metrics.straight, metrics.river );
+  fprintf( stderr, "longest straight passage: %ld cells\n", metrics.longest );
+  fprintf( stderr, "solution: %ld cells\n", metrics.solutionLength );
+}
+
 int main( int argc, char* argv[] ) {
   JBMaze* maze;
   gdImagePtr image;
@@ -495,24 +599,37 @@ int main( int argc, char* argv[] ) {
 
   fprintf( stderr, "current seed: %ld\n", opts.seed );
 
+  if( opts.stream ) {
+    return streamMaze( &opts );
+  }
+
   /* construct the maze */   
   
   maze = new JBMaze( opts.width, opts.height, opts.depth, opts.seed, opts.randomness,
                      opts.startx, opts.starty, opts.startz, opts.endx, opts.endy, opts.endz );
 
+  if( opts.compatible ) {
+    maze->setCompatibility( JBMaze::c_COMPAT_ALL );
+  }
+  maze->setAlgorithm( opts.algorithm );
+
   /* load the mask */
 
   if( opts.maskFile[0] != 0 ) {
-    maze->setMask( new JBMazeMask( opts.maskFile ) );
+    maze->setMask( JBMazeMask::load( opts.maskFile ) );
+  } else if( opts.mask != 0 ) {
+    maze->setMask( opts.mask );
   }
 
   /* generate it */
 
   maze->generate();
 
-  /* solve it */
-  
-  maze->solve( &path, &len );
+  /* older versions had to solve it before sparsifying it */
+
+  if( opts.compatible ) {
+    maze->solve( &path, &len );
+  }
 
   /* sparsify it */
 
@@ -522,6 +639,16 @@ int main( int argc, char* argv[] ) {
 
   maze->clearDeadends( opts.deadends );
 
+  /* solve it */
+
+  if( !opts.compatible ) {
+    maze->solve( &path, &len );
+  }
+
+  if( opts.metrics ) {
+    printMetrics( maze );
+  }
+
   /* draw it */
 
   drawAsStructure( &image, maze, path, len, &opts );
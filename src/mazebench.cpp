@@ -0,0 +1,1679 @@
+/* ---------------------------------------------------------------------- *
+ * This file is in the public domain, and may be used, modified, and
+ * distributed without restriction.
+ * ---------------------------------------------------------------------- *
+ * Maze Benchmark Front-end
+ *
+ * Author: Jamis Buck <jamis@jamisbuck.org>
+ * Homepage: http://github.com/jamis/dnd-dungeon
+ *
+ * A small command-line tool that times the phases of JBMaze (generation,
+ * solving, sparsification, and deadend removal) and reports the memory
+ * used by the maze.  It depends only on JBMaze and JBMazeMask, so it can
+ * be built without any of the graphics or CGI libraries.
+ * ---------------------------------------------------------------------- */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/resource.h>
+
+#include "jbmaze.h"
+#include "jbmazebatch.h"
+#include "jbmazegenerator.h"
+#include "jbmazemaskgenerator.h"
+#include "jbmazepath.h"
+#include "jbmazeplanes.h"
+#include "jbmazesnapshot.h"
+#include "jbmazestream.h"
+
+
+typedef struct {
+  int  width;
+  int  height;
+  int  depth;
+  int  randomness;
+  int  sparseness;
+  int  deadends;
+  int  iterations;
+  int  compatibility;
+  int  algorithm;
+  int  queries;
+  int  verify;
+  int  threads;
+  int  tileSize;
+  long seed;
+  const char* storage;
+  int  lanes;
+  long budget;
+  int  branches;
+  const char* maskFile;
+  const char* maskPreset;
+  int  regions;
+} BENCHOPTS;
+
+
+double now( void ) {
+  struct timespec ts;
+
+  clock_gettime( CLOCK_MONOTONIC, &ts );
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+/* ---------------------------------------------------------------------- *
+ * The original representation of a JBMaze was an int*** with a separate
+ * allocation for every (x,y) column.  These helpers rebuild that layout
+ * from a maze, so that the cost of walking it can be compared against the
+ * packed representation.
+ * ---------------------------------------------------------------------- */
+
+long legacyMemoryUsage( JBMaze* maze ) {
+  long x = maze->getX();
+  long y = maze->getY();
+  long z = maze->getZ();
+  long blocks;
+
+  /* every malloc'd block carries (at least) a 16 byte header in glibc */
+
+  blocks = 1 + x + x * y;
+  return x * sizeof( int** ) + x * y * sizeof( int* ) + x * y * z * sizeof( int ) + blocks * 16;
+}
+
+
+int*** legacyCopy( JBMaze* maze ) {
+  int*** grid;
+  int    i;
+  int    j;
+  int    k;
+
+  grid = (int***)malloc( maze->getX() * sizeof( int** ) );
+  for( i = 0; i < maze->getX(); i++ ) {
+    grid[ i ] = (int**)malloc( maze->getY() * sizeof( int* ) );
+    for( j = 0; j < maze->getY(); j++ ) {
+      grid[ i ][ j ] = (int*)malloc( maze->getZ() * sizeof( int ) );
+      for( k = 0; k < maze->getZ(); k++ ) {
+        grid[ i ][ j ][ k ] = maze->getExitsAt( i, j, k );
+      }
+    }
+  }
+
+  return grid;
+}
+
+
+void legacyFree( JBMaze* maze, int*** grid ) {
+  int i;
+  int j;
+
+  for( i = 0; i < maze->getX(); i++ ) {
+    for( j = 0; j < maze->getY(); j++ ) {
+      free( grid[ i ][ j ] );
+    }
+    free( grid[ i ] );
+  }
+  free( grid );
+}
+
+
+/* ---------------------------------------------------------------------- *
+ * Counts the deadends in the maze the way sparsify() and clearDeadends()
+ * find them, once through each representation.
+ * ---------------------------------------------------------------------- */
+
+int isDeadend( int dir ) {
+  switch( dir ) {
+    case 0x01: case 0x02: case 0x04: case 0x08: case 0x10: case 0x20:
+      return 1;
+  }
+  return 0;
+}
+
+
+long scanLegacy( JBMaze* maze, int*** grid ) {
+  long count = 0;
+  int  x;
+  int  y;
+  int  z;
+
+  for( y = 0; y < maze->getY(); y++ ) {
+    for( x = 0; x < maze->getX(); x++ ) {
+      for( z = 0; z < maze->getZ(); z++ ) {
+        count += isDeadend( grid[ x ][ y ][ z ] );
+      }
+    }
+  }
+
+  return count;
+}
+
+
+long scanPacked( JBMaze* maze ) {
+  long count = 0;
+  int  x;
+  int  y;
+  int  z;
+
+  for( z = 0; z < maze->getZ(); z++ ) {
+    for( y = 0; y < maze->getY(); y++ ) {
+      for( x = 0; x < maze->getX(); x++ ) {
+        count += isDeadend( maze->getExitsAt( x, y, z ) );
+      }
+    }
+  }
+
+  return count;
+}
+
+
+/* ---------------------------------------------------------------------- *
+ * The original sparsify(), which made a full pass over the maze for each
+ * unit of the amount, run against a legacy copy of the maze.  Neighbors of
+ * an erased cell are marked so they are not erased in the same pass.  The
+ * beginning point is spared on the level sparsify() spares it on: the end
+ * point's with c_COMPAT_SOLVE, its own otherwise.
+ * ---------------------------------------------------------------------- */
+
+void sparsifyLegacy( JBMaze* maze, int*** grid, int amount ) {
+  const JBMazePt& s = maze->getStart();
+  const JBMazePt& e = maze->getEnd();
+  int sz = ( ( maze->getCompatibility() & JBMaze::c_COMPAT_SOLVE ) != 0 ) ? e.z : s.z;
+  int i;
+  int x;
+  int y;
+  int z;
+  int dir;
+
+  for( i = 0; i < amount; i++ ) {
+    for( x = 0; x < maze->getX(); x++ ) {
+      for( y = 0; y < maze->getY(); y++ ) {
+        for( z = 0; z < maze->getZ(); z++ ) {
+          if( ( x == s.x ) && ( y == s.y ) && ( z == sz ) ) continue;
+          if( ( x == e.x ) && ( y == e.y ) && ( z == e.z ) ) continue;
+
+          dir = grid[ x ][ y ][ z ];
+          if( !isDeadend( dir ) ) continue;
+
+          grid[ x ][ y ][ z ] = 0;
+          switch( dir ) {
+            case 0x01: grid[ x ][ y-1 ][ z ] = ( grid[ x ][ y-1 ][ z ] & ~0x02 ) | 0x40; break;
+            case 0x02: grid[ x ][ y+1 ][ z ] = ( grid[ x ][ y+1 ][ z ] & ~0x01 ) | 0x40; break;
+            case 0x04: grid[ x-1 ][ y ][ z ] = ( grid[ x-1 ][ y ][ z ] & ~0x08 ) | 0x40; break;
+            case 0x08: grid[ x+1 ][ y ][ z ] = ( grid[ x+1 ][ y ][ z ] & ~0x04 ) | 0x40; break;
+            case 0x10: grid[ x ][ y ][ z-1 ] = ( grid[ x ][ y ][ z-1 ] & ~0x20 ) | 0x40; break;
+            case 0x20: grid[ x ][ y ][ z+1 ] = ( grid[ x ][ y ][ z+1 ] & ~0x10 ) | 0x40; break;
+          }
+        }
+      }
+    }
+
+    for( x = 0; x < maze->getX(); x++ ) {
+      for( y = 0; y < maze->getY(); y++ ) {
+        for( z = 0; z < maze->getZ(); z++ ) {
+          grid[ x ][ y ][ z ] &= ~0x40;
+        }
+      }
+    }
+  }
+}
+
+
+/* ---------------------------------------------------------------------- *
+ * Generates a maze like verifySparsify()'s, sparsifies it and clears its
+ * deadends (in the order JBDungeon does), and returns the length of its
+ * solution, which is 0 if the beginning point was sparsified away.
+ * ---------------------------------------------------------------------- */
+
+long sparseSolution( BENCHOPTS* opts, int depth, int n ) {
+  JBMaze*    maze;
+  JBMazePath path;
+
+  maze = new JBMaze( opts->width, opts->height, depth, opts->seed + n, opts->randomness,
+                     n % opts->width, n % opts->height, 0 );
+  maze->setCompatibility( opts->compatibility );
+  maze->setAlgorithm( opts->algorithm );
+  maze->generate();
+  maze->sparsify( opts->sparseness );
+  maze->clearDeadends( opts->deadends );
+  maze->solve( &path );
+  delete maze;
+
+  return path.getLength();
+}
+
+
+/* ---------------------------------------------------------------------- *
+ * Sparsifies a number of mazes with both sparsify() and sparsifyLegacy(),
+ * and reports any cell on which they disagree.  Every other maze has its
+ * deadends cleared first, so that loops are covered too.  Unless
+ * c_COMPAT_SOLVE is set, each maze (and a copy of it three levels deep, if
+ * it has fewer) must also still have a solution once it is sparsified.
+ * Returns the number of mazes that failed.
+ * ---------------------------------------------------------------------- */
+
+int verifySparsify( BENCHOPTS* opts ) {
+  JBMaze* maze;
+  int***  grid;
+  double  start;
+  double  legacyTime = 0;
+  double  packedTime = 0;
+  int     failures = 0;
+  int     diffs;
+  int     unsolved;
+  int     depths[ 2 ];
+  int     i;
+  int     n;
+  int     x;
+  int     y;
+  int     z;
+
+  for( n = 0; n < opts->verify; n++ ) {
+    maze = new JBMaze( opts->width, opts->height, opts->depth, opts->seed + n, opts->randomness,
+                       n % opts->width, n % opts->height, 0 );
+    maze->setCompatibility( opts->compatibility );
+    maze->setAlgorithm( opts->algorithm );
+    maze->generate();
+
+    if( n % 2 == 1 ) {
+      maze->clearDeadends( opts->deadends );
+    }
+
+    grid = legacyCopy( maze );
+
+    start = now();
+    sparsifyLegacy( maze, grid, opts->sparseness );
+    legacyTime += now() - start;
+
+    start = now();
+    maze->sparsify( opts->sparseness );
+    packedTime += now() - start;
+
+    diffs = 0;
+    for( x = 0; x < maze->getX(); x++ ) {
+      for( y = 0; y < maze->getY(); y++ ) {
+        for( z = 0; z < maze->getZ(); z++ ) {
+          if( grid[ x ][ y ][ z ] != maze->getExitsAt( x, y, z ) ) {
+            if( diffs++ == 0 ) {
+              printf( "verify: seed %ld differs at (%d,%d,%d): %d, expected %d\n",
+                      opts->seed + n, x, y, z, maze->getExitsAt( x, y, z ), grid[ x ][ y ][ z ] );
+            }
+          }
+        }
+      }
+    }
+
+    legacyFree( maze, grid );
+    delete maze;
+
+    unsolved = 0;
+    if( ( opts->compatibility & JBMaze::c_COMPAT_SOLVE ) == 0 ) {
+      depths[ 0 ] = opts->depth;
+      depths[ 1 ] = ( opts->depth < 3 ) ? 3 : 0;
+      for( i = 0; ( i < 2 ) && ( depths[ i ] > 0 ); i++ ) {
+        if( sparseSolution( opts, depths[ i ], n ) == 0 ) {
+          printf( "verify: seed %ld has no solution %d levels deep once sparsified\n",
+                  opts->seed + n, depths[ i ] );
+          unsolved++;
+        }
+      }
+    }
+
+    failures += ( diffs > 0 ) || ( unsolved > 0 );
+  }
+
+  printf( "verify: sparsify %d mazes, %d failed; passes %.4fs, single pass %.4fs\n",
+          opts->verify, failures, legacyTime / opts->verify, packedTime / opts->verify );
+
+  return failures;
+}
+
+
+void benchLayout( BENCHOPTS* opts ) {
+  JBMaze* maze;
+  JBMazePlanes* planes;
+  int***  grid;
+  double  start;
+  double  legacyTime;
+  double  packedTime;
+  double  planesTime;
+  long    legacyCount;
+  long    packedCount;
+  long    planesCount;
+  int     i;
+
+  maze = new JBMaze( opts->width, opts->height, opts->depth, opts->seed, opts->randomness );
+  maze->generate();
+
+  grid = legacyCopy( maze );
+
+  legacyCount = packedCount = planesCount = 0;
+
+  start = now();
+  for( i = 0; i < opts->iterations; i++ ) {
+    legacyCount += scanLegacy( maze, grid );
+  }
+  legacyTime = ( now() - start ) / opts->iterations;
+
+  start = now();
+  for( i = 0; i < opts->iterations; i++ ) {
+    packedCount += scanPacked( maze );
+  }
+  packedTime = ( now() - start ) / opts->iterations;
+
+  /* the planes are mirrored from the packed cells every time, as JBMaze
+   * does before each scan */
+
+  planes = new JBMazePlanes( opts->width, opts->height, opts->depth );
+
+  start = now();
+  for( i = 0; i < opts->iterations; i++ ) {
+    planes->mirror( maze->getCells() );
+    planesCount += planes->countDeadends();
+  }
+  planesTime = ( now() - start ) / opts->iterations;
+
+  printf( "layout: int***  %10ld bytes, deadend scan %.4fs (%ld)\n",
+          legacyMemoryUsage( maze ), legacyTime, legacyCount / opts->iterations );
+  printf( "layout: packed  %10ld bytes, deadend scan %.4fs (%ld)\n",
+          maze->getMemoryUsage(), packedTime, packedCount / opts->iterations );
+  printf( "layout: planes  %10ld bytes, deadend scan %.4fs (%ld)\n",
+          planes->getMemoryUsage(), planesTime, planesCount / opts->iterations );
+
+  delete planes;
+  legacyFree( maze, grid );
+  delete maze;
+}
+
+
+void printLevels( JBLayeredGenerator* generator, int levels ) {
+  int z;
+
+  for( z = 0; z < levels; z++ ) {
+    printf( "level: %3d  %.4fs, %ld stairways down\n", z,
+            generator->getLevelTime( z ), generator->getLevelLinks( z ) );
+  }
+}
+
+
+void benchPhases( BENCHOPTS* opts ) {
+  JBMaze*   maze;
+  JBMazePt* path;
+  int       len;
+  double    start;
+  double    generate = 0;
+  double    solve = 0;
+  double    sparsify = 0;
+  double    deadends = 0;
+  double    measure = 0;
+  JBMazeDeadendStats stats;
+  JBMazeMetrics metrics;
+  int       i;
+
+  memset( &stats, 0, sizeof( stats ) );
+
+  for( i = 0; i < opts->iterations; i++ ) {
+    maze = new JBMaze( opts->width, opts->height, opts->depth, opts->seed + i, opts->randomness );
+    maze->setCompatibility( opts->compatibility );
+    maze->setAlgorithm( opts->algorithm );
+
+    start = now();
+    maze->generate();
+    generate += now() - start;
+
+    if( ( i == 0 ) && ( maze->getAlgorithm() == JBMaze::c_LAYERED ) ) {
+      printLevels( (JBLayeredGenerator*)maze->getGenerator(), maze->getZ() );
+    }
+
+    start = now();
+    maze->solve( &path, &len );
+    solve += now() - start;
+    free( path );
+
+    start = now();
+    maze->sparsify( opts->sparseness );
+    sparsify += now() - start;
+
+    start = now();
+    maze->clearDeadends( opts->deadends );
+    deadends += now() - start;
+
+    start = now();
+    maze->measure( &metrics, 0 );
+    measure += now() - start;
+
+    stats.deadends += maze->getDeadendStats().deadends;
+    stats.cleared += maze->getDeadendStats().cleared;
+    stats.failed += maze->getDeadendStats().failed;
+    stats.carved += maze->getDeadendStats().carved;
+    stats.probes += maze->getDeadendStats().probes;
+    if( maze->getDeadendStats().longest > stats.longest ) {
+      stats.longest = maze->getDeadendStats().longest;
+    }
+
+    delete maze;
+  }
+
+  printf( "phase: generate      %.4fs\n", generate / opts->iterations );
+  printf( "phase: solve         %.4fs\n", solve / opts->iterations );
+  printf( "phase: sparsify      %.4fs\n", sparsify / opts->iterations );
+  printf( "phase: clearDeadends %.4fs\n", deadends / opts->iterations );
+  printf( "phase: measure       %.4fs (%ld deadends, %ld junctions, river %.3f, longest %ld)\n",
+          measure / opts->iterations, metrics.deadends, metrics.junctions,
+          metrics.river, metrics.longest );
+
+  if( stats.cleared + stats.failed > 0 ) {
+    printf( "deadends: %ld found, %ld cleared, %ld failed; connectors average %.2f cells "
+            "(longest %ld), %.2f probes each\n",
+            stats.deadends / opts->iterations, stats.cleared / opts->iterations,
+            stats.failed / opts->iterations,
+            (double)stats.carved / ( stats.cleared + stats.failed ), stats.longest,
+            (double)stats.probes / ( stats.cleared + stats.failed ) );
+  }
+}
+
+
+void benchAlgorithms( BENCHOPTS* opts ) {
+  static const char* names[] = { "huntandkill", "backtracker", "growingtree", "kruskal", "wilson", "tiled", "layered", "stream", 0 };
+
+  JBMaze* maze;
+  double  start;
+  double  elapsed;
+  long    memory;
+  int     a;
+  int     i;
+
+  for( a = 0; names[ a ] != 0; a++ ) {
+    elapsed = 0;
+    memory = 0;
+
+    for( i = 0; i < opts->iterations; i++ ) {
+      maze = new JBMaze( opts->width, opts->height, opts->depth, opts->seed + i, opts->randomness );
+      maze->setCompatibility( opts->compatibility );
+      maze->setAlgorithm( JBMazeGenerator::findAlgorithm( names[ a ] ) );
+
+      start = now();
+      maze->generate();
+      elapsed += now() - start;
+
+      /* the hunt-and-kill frontier holds a cell index and a position for
+       * every cell of the maze */
+
+      if( maze->getGenerator() != 0 ) {
+        memory = maze->getGenerator()->getPeakMemory();
+      } else if( ( opts->compatibility & JBMaze::c_COMPAT_RESTART ) == 0 ) {
+        memory = maze->getCellCount() * 2 * sizeof( long );
+      }
+      memory += maze->getMemoryUsage();
+
+      delete maze;
+    }
+
+    printf( "algorithm: %-12s %12.0f cells/sec, peak %10ld bytes\n", names[ a ],
+            (double)opts->width * opts->height * opts->depth * opts->iterations / elapsed,
+            memory );
+  }
+}
+
+
+/* ---------------------------------------------------------------------- *
+ * Times generate() and clearDeadends() with the two-dimensional kernels
+ * and then with the generic ones (see JBMaze::setGeneric()).
+ * ---------------------------------------------------------------------- */
+
+void benchKernels( BENCHOPTS* opts ) {
+  static const char* names[] = { "planar", "generic" };
+
+  JBMaze* maze;
+  double  start;
+  double  generate[ 2 ];
+  double  deadends[ 2 ];
+  int     k;
+  int     i;
+
+  for( k = 0; k < 2; k++ ) {
+    generate[ k ] = deadends[ k ] = 0;
+
+    for( i = 0; i < opts->iterations; i++ ) {
+      maze = new JBMaze( opts->width, opts->height, opts->depth, opts->seed + i, opts->randomness );
+      maze->setCompatibility( opts->compatibility );
+      maze->setGeneric( k );
+
+      start = now();
+      maze->generate();
+      generate[ k ] += now() - start;
+
+      maze->sparsify( opts->sparseness );
+
+      start = now();
+      maze->clearDeadends( opts->deadends );
+      deadends[ k ] += now() - start;
+
+      delete maze;
+    }
+
+    printf( "kernels: %-8s generate %.4fs, clearDeadends %.4fs\n", names[ k ],
+            generate[ k ] / opts->iterations, deadends[ k ] / opts->iterations );
+  }
+
+  printf( "kernels: speedup  generate %.2f, clearDeadends %.2f\n",
+          generate[ 1 ] / generate[ 0 ], deadends[ 1 ] / deadends[ 0 ] );
+}
+
+
+int benchSolvers( BENCHOPTS* opts ) {
+  static const char* names[] = { "bfs", "bidirectional" };
+  static const int   methods[] = { JBMaze::c_SOLVE_BFS, JBMaze::c_SOLVE_BIDIRECTIONAL };
+
+  JBMaze*   maze;
+  JBMazePt* from;
+  JBMazePt* to;
+  JBMazePt* path;
+  int       len;
+  JBMazePath packed;
+  long      bytes;
+  long      differed = 0;
+  long      expanded;
+  long      steps;
+  double    start;
+  double    elapsed;
+  int       m;
+  int       i;
+  int       j;
+
+  maze = new JBMaze( opts->width, opts->height, opts->depth, opts->seed, opts->randomness );
+  maze->setCompatibility( opts->compatibility );
+  maze->setAlgorithm( opts->algorithm );
+  maze->generate();
+  maze->sparsify( opts->sparseness );
+  maze->clearDeadends( opts->deadends );
+
+  /* every method answers the same random queries */
+
+  from = new JBMazePt[ opts->queries ];
+  to = new JBMazePt[ opts->queries ];
+  for( i = 0; i < opts->queries; i++ ) {
+    from[ i ] = JBMazePt( rand() % opts->width, rand() % opts->height, rand() % opts->depth );
+    to[ i ] = JBMazePt( rand() % opts->width, rand() % opts->height, rand() % opts->depth );
+  }
+
+  /* the first query allocates the scratch space */
+  maze->solve( from[ 0 ], to[ 0 ], &path, &len );
+  free( path );
+
+  for( m = 0; m < 2; m++ ) {
+    expanded = steps = 0;
+
+    start = now();
+    for( i = 0; i < opts->queries; i++ ) {
+      maze->solve( from[ i ], to[ i ], &path, &len, methods[ m ] );
+      expanded += maze->getNodesExpanded();
+      steps += len;
+      free( path );
+    }
+    elapsed = now() - start;
+
+    printf( "solver: %-14s %10.6fs/query, %12.1f expanded/query, %10.1f steps/query\n",
+            names[ m ], elapsed / opts->queries, (double)expanded / opts->queries,
+            (double)steps / opts->queries );
+
+    /* the same queries, packed, and then checked point by point, both in
+     * order (with an iterator) and out of order */
+
+    bytes = steps = 0;
+
+    start = now();
+    for( i = 0; i < opts->queries; i++ ) {
+      maze->solve( from[ i ], to[ i ], &packed, methods[ m ] );
+      bytes += packed.getMemoryUsage();
+      steps += packed.getLength();
+    }
+    elapsed = now() - start;
+
+    for( i = 0; i < opts->queries; i++ ) {
+      maze->solve( from[ i ], to[ i ], &path, &len, methods[ m ] );
+      maze->solve( from[ i ], to[ i ], &packed, methods[ m ] );
+
+      if( packed.getLength() != len ) {
+        differed++;
+      } else {
+        JBMazePathIterator it( &packed );
+
+        for( j = 0; !it.isDone(); it.next(), j++ ) {
+          if( !( path[ j ] == it.getPoint() ) ) {
+            break;
+          }
+        }
+        if( j == len ) {
+          for( j = len - 1; j >= 0; j -= 7 ) {
+            if( !( path[ j ] == packed.getStep( j ) ) ) {
+              break;
+            }
+          }
+        }
+        if( j >= 0 ) {
+          differed++;
+        }
+      }
+      free( path );
+    }
+
+    printf( "solver: %-14s %10.6fs/query packed, %.3f bytes/step (%d unpacked)\n",
+            names[ m ], elapsed / opts->queries,
+            ( steps > 0 ? (double)bytes / steps : 0.0 ), (int)sizeof( JBMazePt ) );
+  }
+
+  if( differed > 0 ) {
+    printf( "solver: %ld packed paths differ from their points\n", differed );
+  }
+
+  delete[] from;
+  delete[] to;
+  delete maze;
+
+  return differed;
+}
+
+
+/* ---------------------------------------------------------------------- *
+ * Times the tiled (or, if it was chosen, the layered) generator on 1, 2,
+ * 4, ... up to opts->threads threads, and returns the number of thread
+ * counts that gave a different maze than one thread did.
+ * ---------------------------------------------------------------------- */
+
+int benchThreads( BENCHOPTS* opts ) {
+  JBMaze*        maze;
+  unsigned char* first;
+  double         start;
+  double         elapsed;
+  double         single = 0;
+  long           cells;
+  long           cell;
+  int            exits;
+  int            threads;
+  int            same;
+  int            differed = 0;
+  int            i;
+
+  cells = (long)opts->width * opts->height * opts->depth;
+  first = new unsigned char[ cells ];
+
+  for( threads = 1; ; threads *= 2 ) {
+    if( threads > opts->threads ) {
+      threads = opts->threads;
+    }
+
+    elapsed = 0;
+    same = 1;
+
+    for( i = 0; i < opts->iterations; i++ ) {
+      maze = new JBMaze( opts->width, opts->height, opts->depth, opts->seed, opts->randomness );
+      maze->setCompatibility( opts->compatibility );
+      if( opts->algorithm == JBMaze::c_LAYERED ) {
+        maze->setGenerator( new JBLayeredGenerator( 1, threads ) );
+      } else {
+        maze->setGenerator( new JBTiledGenerator( opts->tileSize, threads ) );
+      }
+
+      start = now();
+      maze->generate();
+      elapsed += now() - start;
+
+      for( cell = 0; cell < cells; cell++ ) {
+        exits = maze->getExitsAt( (int)( cell % opts->width ), (int)( cell / opts->width % opts->height ),
+                                  (int)( cell / ( (long)opts->width * opts->height ) ) );
+        if( threads == 1 ) {
+          first[ cell ] = exits;
+        } else if( first[ cell ] != exits ) {
+          same = 0;
+        }
+      }
+
+      delete maze;
+    }
+
+    elapsed /= opts->iterations;
+    if( threads == 1 ) {
+      single = elapsed;
+    }
+    differed += !same;
+
+    printf( "threads: %3d, %12.0f cells/sec, speedup %5.2f%s\n", threads,
+            cells / elapsed, single / elapsed, ( same ? "" : ", DIFFERENT maze" ) );
+
+    if( threads == opts->threads ) {
+      break;
+    }
+  }
+
+  delete[] first;
+  return differed;
+}
+
+
+/* ---------------------------------------------------------------------- *
+ * Runs each phase once (and solve() opts->queries times) on a maze mapped
+ * from the given file (see JBMaze::setStorage()), and reports the time
+ * each took and the most memory the process held at once.  Run under a memory limit smaller than
+ * the maze (for example, with systemd-run -p MemoryMax=...) to show that
+ * the maze need not fit in memory.  Returns the number of cells whose
+ * exits do not agree with their neighbors'.
+ * ---------------------------------------------------------------------- */
+
+long benchMapped( BENCHOPTS* opts ) {
+  static const int dirs[] = { JBMaze::c_NORTH, JBMaze::c_SOUTH, JBMaze::c_WEST,
+                              JBMaze::c_EAST, JBMaze::c_UP, JBMaze::c_DOWN };
+  static const int back[] = { JBMaze::c_SOUTH, JBMaze::c_NORTH, JBMaze::c_EAST,
+                              JBMaze::c_WEST, JBMaze::c_DOWN, JBMaze::c_UP };
+  static const int dx[] = { 0, 0, -1, 1, 0, 0 };
+  static const int dy[] = { -1, 1, 0, 0, 0, 0 };
+  static const int dz[] = { 0, 0, 0, 0, -1, 1 };
+
+  struct rusage usage;
+  JBMaze*   maze;
+  JBMazePt* path;
+  int       len;
+  double    start;
+  long      broken;
+  int       exits;
+  int       x;
+  int       y;
+  int       z;
+  int       d;
+  int       i;
+
+  maze = new JBMaze( opts->width, opts->height, opts->depth, opts->seed, opts->randomness );
+  maze->setCompatibility( opts->compatibility );
+  maze->setAlgorithm( opts->algorithm );
+  maze->setStorage( opts->storage );
+
+  if( maze->getCells() == 0 ) {
+    fprintf( stderr, "could not map %ld bytes from %s\n", maze->getMemoryUsage(), opts->storage );
+    delete maze;
+    return 1;
+  }
+
+  start = now();
+  maze->generate();
+  printf( "mapped: generate      %.4fs\n", now() - start );
+
+  /* solving reads the maze (and its scratch space) in no particular
+   * order, so under a tight limit it spends most of its time paging */
+
+  for( i = 0; i < opts->queries; i++ ) {
+    start = now();
+    maze->solve( &path, &len );
+    printf( "mapped: solve         %.4fs (%d steps)\n", now() - start, len );
+    free( path );
+  }
+
+  /* both of these keep a list of the maze's deadends in memory */
+
+  start = now();
+  maze->sparsify( opts->sparseness );
+  printf( "mapped: sparsify      %.4fs\n", now() - start );
+
+  if( opts->deadends > 0 ) {
+    start = now();
+    maze->clearDeadends( opts->deadends );
+    printf( "mapped: clearDeadends %.4fs\n", now() - start );
+  }
+
+  /* every exit must lead to a cell with an exit back */
+
+  maze->setAdvice( JBMazeStorage::c_SEQUENTIAL );
+
+  broken = 0;
+  for( z = 0; z < maze->getZ(); z++ ) {
+    for( y = 0; y < maze->getY(); y++ ) {
+      for( x = 0; x < maze->getX(); x++ ) {
+        exits = maze->getExitsAt( x, y, z );
+        for( d = 0; d < 6; d++ ) {
+          if( ( ( exits & dirs[ d ] ) != 0 ) &&
+              ( ( maze->getExitsAt( x + dx[ d ], y + dy[ d ], z + dz[ d ] ) & back[ d ] ) == 0 ) )
+          {
+            broken++;
+            break;
+          }
+        }
+      }
+    }
+  }
+
+  getrusage( RUSAGE_SELF, &usage );
+  printf( "mapped: %ld bytes of cells, peak resident %ld bytes, %ld broken cells\n",
+          maze->getMemoryUsage(), usage.ru_maxrss * 1024L, broken );
+
+  delete maze;
+  return broken;
+}
+
+
+/* ---------------------------------------------------------------------- *
+ * Generates small mazes for about a second, first a JBMaze (with the
+ * backtracker) at a time, and then opts->lanes at a time with a
+ * JBMazeBatch, and reports how many each way made per second.  Returns
+ * the number of batched mazes that were not perfect.
+ * ---------------------------------------------------------------------- */
+
+long benchBatch( BENCHOPTS* opts ) {
+  JBMaze*      maze;
+  JBMazeBatch* batch;
+  double       start;
+  double       elapsed;
+  long         count;
+  long         broken;
+  long         exits;
+  long         cell;
+  int          lane;
+  int          x;
+  int          y;
+
+  start = now();
+  for( count = 0; ( elapsed = now() - start ) < 1.0; count++ ) {
+    maze = new JBMaze( opts->width, opts->height, 1, opts->seed + count, opts->randomness );
+    maze->setAlgorithm( JBMaze::c_BACKTRACKER );
+    maze->generate();
+    delete maze;
+  }
+
+  printf( "batch: JBMaze        %12.0f mazes/sec\n", count / elapsed );
+
+  batch = new JBMazeBatch( opts->width, opts->height, opts->lanes, opts->randomness );
+  broken = 0;
+
+  start = now();
+  for( count = 0; ( elapsed = now() - start ) < 1.0; count += batch->getLanes() ) {
+    batch->generate( opts->seed + count );
+
+    /* a perfect maze has one passage fewer than it has cells, and every
+     * passage is an exit from each of the two cells it joins */
+
+    if( count == 0 ) {
+      for( lane = 0; lane < batch->getLanes(); lane++ ) {
+        exits = 0;
+        for( y = 0; y < batch->getY(); y++ ) {
+          for( x = 0; x < batch->getX(); x++ ) {
+            for( cell = batch->getExitsAt( lane, x, y ); cell != 0; cell &= cell - 1 ) {
+              exits++;
+            }
+          }
+        }
+        broken += ( exits != 2 * ( batch->getCellCount() - 1 ) );
+      }
+    }
+  }
+
+  printf( "batch: %2d lanes      %12.0f mazes/sec, %ld broken\n",
+          batch->getLanes(), count / elapsed, broken );
+
+  delete batch;
+  return broken;
+}
+
+
+/* ---------------------------------------------------------------------- *
+ * Runs the current job of the maze to the end, opts->budget units at a
+ * time (see JBMaze::step()), and reports how many steps it took and how
+ * long the longest of them was.
+ * ---------------------------------------------------------------------- */
+
+void stepJob( BENCHOPTS* opts, JBMaze* maze, const char* name ) {
+  double start;
+  double elapsed;
+  double longest;
+  double total;
+  long   steps;
+  long   units;
+  long   all;
+
+  all = maze->getTotal();
+  steps = 0;
+  units = 0;
+  longest = 0;
+  total = 0;
+
+  while( maze->getJob() != JBMaze::c_JOB_NONE ) {
+    start = now();
+    units += maze->step( opts->budget );
+    elapsed = now() - start;
+
+    steps++;
+    total += elapsed;
+    if( elapsed > longest ) {
+      longest = elapsed;
+    }
+  }
+
+  printf( "step: %-13s %8ld units of %8ld in %7ld steps, longest %8.3f ms, total %8.3f ms\n",
+          name, units, all, steps, longest * 1000, total * 1000 );
+}
+
+
+/* ---------------------------------------------------------------------- *
+ * Generates, sparsifies, and clears the deadends of a maze, opts->budget
+ * units at a time, and compares the result with the same maze made by
+ * generate(), sparsify(), and clearDeadends() themselves.  Returns the
+ * number of cells that differ.
+ * ---------------------------------------------------------------------- */
+
+long benchStepper( BENCHOPTS* opts ) {
+  JBMaze* whole;
+  JBMaze* stepped;
+  const unsigned char* a;
+  const unsigned char* b;
+  long    cell;
+  long    differ;
+
+  whole = new JBMaze( opts->width, opts->height, opts->depth, opts->seed, opts->randomness );
+  whole->setCompatibility( opts->compatibility );
+  whole->setAlgorithm( opts->algorithm );
+  whole->generate();
+  whole->sparsify( opts->sparseness );
+  whole->clearDeadends( opts->deadends );
+
+  stepped = new JBMaze( opts->width, opts->height, opts->depth, opts->seed, opts->randomness );
+  stepped->setCompatibility( opts->compatibility );
+  stepped->setAlgorithm( opts->algorithm );
+
+  stepped->beginGenerate();
+  stepJob( opts, stepped, "generate" );
+  stepped->beginSparsify( opts->sparseness );
+  stepJob( opts, stepped, "sparsify" );
+  stepped->beginClearDeadends( opts->deadends );
+  stepJob( opts, stepped, "clearDeadends" );
+
+  a = whole->getCells();
+  b = stepped->getCells();
+  differ = 0;
+  for( cell = 0; cell < whole->getCellCount(); cell++ ) {
+    differ += ( a[ cell ] != b[ cell ] );
+  }
+
+  printf( "step: %ld cells differ from the maze made all at once\n", differ );
+
+  delete whole;
+  delete stepped;
+
+  return differ;
+}
+
+
+/* ---------------------------------------------------------------------- *
+ * Returns the bytes of the mapping that begins at the given address that
+ * are anonymous memory, as /proc/self/smaps reports them, or -1 if it
+ * does not say.  In a copy-on-write view of a file, those are the pages
+ * that have been written to (and so copied).
+ * ---------------------------------------------------------------------- */
+
+long anonymousBytes( const void* block ) {
+  FILE* smaps;
+  char  line[ 256 ];
+  unsigned long start;
+  unsigned long end;
+  long  kb;
+  int   found;
+
+  smaps = fopen( "/proc/self/smaps", "r" );
+  if( smaps == 0 ) {
+    return -1;
+  }
+
+  /* each mapping is a line of its range, and then a line for each of its
+   * counts */
+
+  found = 0;
+  kb = -1;
+  while( fgets( line, sizeof( line ), smaps ) != 0 ) {
+    if( sscanf( line, "%lx-%lx ", &start, &end ) == 2 ) {
+      if( found ) {
+        break;
+      }
+      found = ( start == (unsigned long)block );
+    } else if( found && ( sscanf( line, "Anonymous: %ld kB", &kb ) == 1 ) ) {
+      break;
+    }
+  }
+
+  fclose( smaps );
+  return ( kb < 0 ? -1 : kb * 1024 );
+}
+
+
+/* ---------------------------------------------------------------------- *
+ * Returns the bytes of anonymous memory this process holds (leaving out
+ * the pages of files it maps, such as those a snapshot shares).
+ * ---------------------------------------------------------------------- */
+
+long anonymousResident( void ) {
+  FILE* status;
+  char  line[ 256 ];
+  long  kb;
+
+  status = fopen( "/proc/self/status", "r" );
+  if( status == 0 ) {
+    return 0;
+  }
+
+  kb = 0;
+  while( fgets( line, sizeof( line ), status ) != 0 ) {
+    if( sscanf( line, "RssAnon: %ld kB", &kb ) == 1 ) {
+      break;
+    }
+  }
+  fclose( status );
+
+  return kb * 1024;
+}
+
+
+/* ---------------------------------------------------------------------- *
+ * Generates a maze once, takes a snapshot of it, and branches
+ * opts->branches variants from the snapshot (every other one sparsified,
+ * and each with a larger percentage of its deadends cleared).  Reports
+ * the time and memory each branch took, and compares each with the same
+ * variant made by generating the maze all over again.  Returns the number
+ * of branches that differ.
+ * ---------------------------------------------------------------------- */
+
+int benchSnapshot( BENCHOPTS* opts ) {
+  JBMazeSnapshot* snapshot;
+  JBMaze**        branches;
+  JBMaze*         maze;
+  double          start;
+  double          branched;
+  double          regenerated;
+  long            before;
+  long            grew;
+  long            dirty;
+  int             sparseness;
+  int             deadends;
+  int             same;
+  int             differed = 0;
+  int             i;
+
+  maze = new JBMaze( opts->width, opts->height, opts->depth, opts->seed, opts->randomness );
+  maze->setCompatibility( opts->compatibility );
+  maze->setAlgorithm( opts->algorithm );
+  maze->generate();
+
+  start = now();
+  snapshot = new JBMazeSnapshot( maze );
+  printf( "snapshot: %ld bytes in %.3f ms%s\n", snapshot->getSize(), ( now() - start ) * 1000,
+          ( snapshot->isShared() ? "" : " (NOT shared)" ) );
+  delete maze;
+
+  branches = new JBMaze*[ opts->branches ];
+
+  for( i = 0; i < opts->branches; i++ ) {
+    sparseness = ( i % 2 ? opts->sparseness : 0 );
+    deadends = ( opts->branches > 1 ? i * 100 / ( opts->branches - 1 ) : opts->deadends );
+
+    before = anonymousResident();
+    start = now();
+    branches[ i ] = snapshot->branch();
+    branches[ i ]->sparsify( sparseness );
+    branches[ i ]->clearDeadends( deadends );
+    branched = now() - start;
+    grew = anonymousResident() - before;
+    dirty = anonymousBytes( branches[ i ]->getCells() );
+
+    start = now();
+    maze = new JBMaze( opts->width, opts->height, opts->depth, opts->seed, opts->randomness );
+    maze->setCompatibility( opts->compatibility );
+    maze->setAlgorithm( opts->algorithm );
+    maze->generate();
+    maze->sparsify( sparseness );
+    maze->clearDeadends( deadends );
+    regenerated = now() - start;
+
+    same = ( memcmp( maze->getCells(), branches[ i ]->getCells(), maze->getMemoryUsage() ) == 0 );
+    differed += !same;
+
+    printf( "branch %2d: sparsify %3d, deadends %3d%%: %8.3f ms (%8.3f ms regenerating), "
+            "%ld bytes of cells written, process grew %ld bytes%s\n",
+            i, sparseness, deadends, branched * 1000, regenerated * 1000, dirty, grew,
+            ( same ? "" : ", DIFFERENT maze" ) );
+
+    delete maze;
+  }
+
+  for( i = 0; i < opts->branches; i++ ) {
+    delete branches[ i ];
+  }
+  delete[] branches;
+  delete snapshot;
+
+  return differed;
+}
+
+
+/* ---------------------------------------------------------------------- *
+ * Numbers the valid cells of a width by height by depth maze (with the
+ * mask of the same width and height, laid out a level at a time) by the
+ * piece each belongs to, and returns the number of pieces.  Without
+ * exits, a piece is a region of the mask (the valid cells that touch each
+ * other, on any level); with them, it is the cells that are joined by
+ * passages.
+ * ---------------------------------------------------------------------- */
+
+long labelPieces( JBMazeMask* mask, const unsigned char* exits, int width, int height, int depth, long* piece ) {
+  static const int dirs[] = { JBMaze::c_NORTH, JBMaze::c_SOUTH, JBMaze::c_WEST, JBMaze::c_EAST, JBMaze::c_UP, JBMaze::c_DOWN };
+  static const int dx[] = { 0, 0, -1, 1, 0, 0 };
+  static const int dy[] = { -1, 1, 0, 0, 0, 0 };
+  static const int dz[] = { 0, 0, 0, 0, -1, 1 };
+
+  long* stack;
+  long  area;
+  long  cells;
+  long  top;
+  long  count;
+  long  cell;
+  long  next;
+  long  i;
+  int   d;
+  int   x;
+  int   y;
+  int   z;
+
+  area = (long)width * height;
+  cells = area * depth;
+  stack = new long[ cells ];
+  count = 0;
+
+  for( i = 0; i < cells; i++ ) {
+    piece[ i ] = -1;
+  }
+
+  for( i = 0; i < cells; i++ ) {
+    if( ( piece[ i ] >= 0 ) || !mask->getMaskAt( (int)( i % area % width ), (int)( i % area / width ) ) ) {
+      continue;
+    }
+
+    piece[ i ] = count;
+    stack[ 0 ] = i;
+    top = 1;
+
+    while( top > 0 ) {
+      cell = stack[ --top ];
+      for( d = 0; d < 6; d++ ) {
+        x = (int)( cell % area % width ) + dx[ d ];
+        y = (int)( cell % area / width ) + dy[ d ];
+        z = (int)( cell / area ) + dz[ d ];
+        if( ( x < 0 ) || ( x >= width ) || ( y < 0 ) || ( y >= height ) || ( z < 0 ) || ( z >= depth ) ||
+            !mask->getMaskAt( x, y ) ) {
+          continue;
+        }
+        if( ( exits != 0 ) && ( ( exits[ cell ] & dirs[ d ] ) == 0 ) ) {
+          continue;
+        }
+        next = z * area + (long)y * width + x;
+        if( piece[ next ] < 0 ) {
+          piece[ next ] = count;
+          stack[ top++ ] = next;
+        }
+      }
+    }
+
+    count++;
+  }
+
+  delete[] stack;
+  return count;
+}
+
+
+void collectRow( long y, const unsigned char* exits, int width, void* userData ) {
+  memcpy( (unsigned char*)userData + y * width, exits, width );
+}
+
+
+/* ---------------------------------------------------------------------- *
+ * Generates mazes, of the width and height given, within masks made from
+ * each preset (or the one named by opts->maskPreset) and within a comb (a
+ * full row, then a row open only at its left end, and so on), on
+ * opts->regions seeds: single-level ones with JBMazeStream, and ones of
+ * one and of three levels with each algorithm.  Reports how many of the
+ * mazes do not join up every region of their mask (and each level to the
+ * next within it), and returns the number that do not.
+ * ---------------------------------------------------------------------- */
+
+int benchRegions( BENCHOPTS* opts ) {
+  static const char* names[] = { "huntandkill", "backtracker", "growingtree", "kruskal", "wilson", "tiled", "layered", "stream", 0 };
+  static const char* masks[] = { "comb", "noise", "blobs", "island", "caverns", 0 };
+
+  JBMazeStream*  stream;
+  JBMazeMask*    mask;
+  JBMaze*        maze;
+  unsigned char* exits;
+  long*          piece;
+  long           area;
+  long           regions;
+  long           pieces;
+  int            split;
+  int            failed;
+  int            tried;
+  int            depth;
+  int            a;
+  int            m;
+  int            i;
+  int            x;
+  int            y;
+  int            z;
+
+  area = (long)opts->width * opts->height;
+  exits = new unsigned char[ area * 3 ];
+  piece = new long[ area * 3 ];
+  failed = 0;
+
+  for( a = -1; ( a < 0 ) || ( names[ a ] != 0 ); a++ ) {
+    split = 0;
+    tried = 0;
+
+    for( i = 0; i < opts->regions; i++ ) {
+      for( m = 0; masks[ m ] != 0; m++ ) {
+        if( ( opts->maskPreset != 0 ) && ( strcmp( opts->maskPreset, masks[ m ] ) != 0 ) ) {
+          continue;
+        }
+
+        if( m == 0 ) {
+          mask = new JBMazeMask( opts->width, opts->height );
+          for( y = 0; y < opts->height; y++ ) {
+            for( x = 0; x < ( y % 2 ? 1 : opts->width ); x++ ) {
+              mask->setMaskAt( x, y, 1 );
+            }
+          }
+        } else {
+          mask = JBMazeMaskGenerator::create( masks[ m ], opts->width, opts->height, opts->seed + i );
+        }
+
+        regions = labelPieces( mask, 0, opts->width, opts->height, 1, piece );
+
+        for( depth = 1; depth <= ( a < 0 ? 1 : 3 ); depth += 2 ) {
+          if( a < 0 ) {
+            stream = new JBMazeStream( opts->width, opts->height, opts->seed + i, opts->randomness );
+            stream->setMask( mask->retain() );
+            JBMazeCallbackSink sink( collectRow, exits );
+            stream->generate( &sink );
+            delete stream;
+          } else {
+            maze = new JBMaze( opts->width, opts->height, depth, opts->seed + i, opts->randomness );
+            maze->setCompatibility( opts->compatibility );
+            maze->setMask( mask->retain() );
+            maze->setAlgorithm( JBMazeGenerator::findAlgorithm( names[ a ] ) );
+            maze->generate();
+            for( z = 0; z < depth; z++ ) {
+              for( y = 0; y < opts->height; y++ ) {
+                for( x = 0; x < opts->width; x++ ) {
+                  exits[ z * area + (long)y * opts->width + x ] = maze->getExitsAt( x, y, z );
+                }
+              }
+            }
+            delete maze;
+          }
+
+          pieces = labelPieces( mask, exits, opts->width, opts->height, depth, piece );
+          split += ( pieces != regions );
+          tried++;
+        }
+
+        mask->release();
+      }
+    }
+
+    printf( "regions: %-12s %d of %d mazes split a region of the mask\n",
+            ( a < 0 ? "JBMazeStream" : names[ a ] ), split, tried );
+    failed += split;
+  }
+
+  delete[] exits;
+  delete[] piece;
+
+  return failed;
+}
+
+
+/* ---------------------------------------------------------------------- *
+ * Times loading the mask at opts->maskFile (text, PBM, or PNG), and
+ * reports what was loaded.  Returns non-zero if nothing was, if a valid
+ * point drawn from it was not, or if loading it twice through
+ * JBMazeMask::load() did not share it.
+ * ---------------------------------------------------------------------- */
+int benchMask( BENCHOPTS* opts ) {
+  JBMazeMask* mask;
+  JBMazeMask* first;
+  JBMazeMask* second;
+  JBRandom    random;
+  double      start;
+  double      elapsed;
+  double      indexed;
+  long        runs;
+  long        valid;
+  long        missed;
+  long        i;
+  int         loaded;
+  int         shared;
+  int         x;
+  int         y;
+
+  start = now();
+  mask = new JBMazeMask( opts->maskFile );
+  elapsed = now() - start;
+
+  /* index the runs of valid points (which counting them would otherwise
+   * do first) */
+
+  start = now();
+  runs = mask->getRunCount();
+  indexed = now() - start;
+
+  printf( "mask: %dx%d, %ld valid, %ld bytes, loaded in %.4fs\n",
+          mask->getWidth(), mask->getHeight(), mask->countValid(),
+          mask->getMemoryUsage(), elapsed );
+
+  loaded = ( ( mask->getWidth() > 0 ) && ( mask->getHeight() > 0 ) );
+
+  /* draw a million valid points from the runs (each of which must, of
+   * course, be valid) */
+
+  valid = mask->countValid();
+  missed = 0;
+  random.seed( opts->seed );
+  start = now();
+  for( i = 0; ( i < 1000000 ) && ( valid > 0 ); i++ ) {
+    if( !mask->getValidPoint( random.next( valid ), &x, &y ) || !mask->getMaskAt( x, y ) ) {
+      missed++;
+    }
+  }
+
+  printf( "runs: %ld, indexed in %.4fs; 1000000 valid points drawn in %.4fs, %ld missed\n",
+          runs, indexed, now() - start, missed );
+
+  mask->release();
+
+  /* loaded through the registry, the file is read once, and loading it
+   * again shares the mask that was read */
+
+  start = now();
+  first = JBMazeMask::load( opts->maskFile );
+  elapsed = now() - start;
+
+  start = now();
+  second = JBMazeMask::load( opts->maskFile );
+  indexed = now() - start;
+
+  shared = ( !loaded || ( first == second ) );
+  printf( "load: %.4fs, and again in %.6fs (%s)\n",
+          elapsed, indexed, ( first == second ? "shared" : "not shared" ) );
+
+  first->release();
+  second->release();
+  JBMazeMask::unloadAll();
+
+  return ( !loaded || ( missed > 0 ) || !shared );
+}
+
+
+/* ---------------------------------------------------------------------- *
+ * Times making a mask of the maze's width and height from the preset
+ * named by opts->maskPreset (or from each preset, for "all"), and reports
+ * how much of it is valid.  Returns the number of presets that were
+ * unknown, or that gave a different mask the second time from the same
+ * seed.
+ * ---------------------------------------------------------------------- */
+int benchMaskPreset( BENCHOPTS* opts ) {
+  static const char* names[] = { "noise", "blobs", "island", "caverns", 0 };
+  JBMazeMaskGenerator* generator;
+  JBMazeMask* mask;
+  JBMazeMask* again;
+  double      start;
+  double      elapsed;
+  int         failed;
+  int         preset;
+  int         same;
+  int         i;
+  int         n;
+  int         x;
+  int         y;
+
+  failed = 0;
+  for( i = 0; names[ i ] != 0; i++ ) {
+    if( ( strcmp( opts->maskPreset, "all" ) != 0 ) && ( strcmp( opts->maskPreset, names[ i ] ) != 0 ) ) {
+      continue;
+    }
+
+    preset = JBMazeMaskGenerator::findPreset( names[ i ] );
+    generator = new JBMazeMaskGenerator( preset );
+
+    elapsed = 0;
+    mask = 0;
+    for( n = 0; n < opts->iterations; n++ ) {
+      if( mask != 0 ) {
+        mask->release();
+      }
+      start = now();
+      mask = generator->generate( opts->width, opts->height, opts->seed );
+      elapsed += now() - start;
+    }
+
+    again = generator->generate( opts->width, opts->height, opts->seed );
+    same = ( again->countValid() == mask->countValid() );
+    for( y = 0; same && ( y < mask->getHeight() ); y++ ) {
+      for( x = 0; x < mask->getWidth(); x++ ) {
+        if( mask->getMaskAt( x, y ) != again->getMaskAt( x, y ) ) {
+          same = 0;
+          break;
+        }
+      }
+    }
+
+    printf( "mask: %-8s %dx%d in %.4fs, %.1f%% valid in %ld runs%s\n",
+            names[ i ], mask->getWidth(), mask->getHeight(), elapsed / opts->iterations,
+            100.0 * mask->countValid() / ( (double)mask->getWidth() * mask->getHeight() ),
+            mask->getRunCount(), ( same ? "" : " (DIFFERS from the same seed)" ) );
+
+    failed += !same;
+    again->release();
+    mask->release();
+    delete generator;
+  }
+
+  if( ( strcmp( opts->maskPreset, "all" ) != 0 ) && ( JBMazeMaskGenerator::findPreset( opts->maskPreset ) < 0 ) ) {
+    printf( "mask: no preset named %s\n", opts->maskPreset );
+    failed++;
+  }
+
+  return failed;
+}
+
+
+void printHelp( void ) {
+  fprintf( stderr,
+    "usage: mazebench <opts>\n"
+    "\n"
+    "options:\n"
+    "  -H       : this help\n"
+    "  -w n     : set maze width to n (default 1024)\n"
+    "  -h n     : set maze height to n (default 1024)\n"
+    "  -d n     : set maze depth to n (default 1)\n"
+    "  -r n     : set maze randomness percentage to n (default 50)\n"
+    "  -s n     : set maze sparseness to n (default 10)\n"
+    "  -e n     : set maze deadend percentage to n (default 50)\n"
+    "  -n n     : average each measurement over n runs (default 3)\n"
+    "  -S n     : use n as the random seed for the maze\n"
+    "  -c n     : set the JBMaze compatibility flags to n\n"
+    "  -a name  : generate with the named algorithm (default huntandkill)\n"
+    "  -A       : compare every generation algorithm, then exit\n"
+    "  -K       : compare the two-dimensional kernels with the generic ones\n"
+    "             (on a single-level maze), then exit\n"
+    "  -Q n     : compare every solving method on n random queries, then exit\n"
+    "             (non-zero if a packed path differs from its points)\n"
+    "  -V n     : check sparsify() against the original algorithm on n seeds,\n"
+    "             then exit (non-zero if any maze differs)\n"
+    "  -T n     : time the tiled generator (or the layered one, with -a layered)\n"
+    "             on 1, 2, 4, ... n threads, then exit (non-zero if any thread\n"
+    "             count gives a different maze)\n"
+    "  -t n     : set the tile size of the tiled generator to n (default 64)\n"
+    "  -B n     : generate small mazes (set -w and -h) n at a time, for about\n"
+    "             a second, and compare with one JBMaze at a time, then exit\n"
+    "  -P n     : generate, sparsify, and clear deadends n units of work at a\n"
+    "             time, and report the longest step, then exit (non-zero if\n"
+    "             the maze differs from the one made all at once)\n"
+    "  -C n     : branch n variants from a snapshot of one maze, and report the\n"
+    "             memory each takes, then exit (non-zero if any differs from\n"
+    "             the same variant generated from scratch)\n"
+    "  -M path  : time loading the mask (text, PBM, or PNG) at path, and\n"
+    "             drawing valid points from it, then exit (non-zero if it\n"
+    "             could not be loaded, a point drawn was not valid, or\n"
+    "             loading it again did not share it)\n"
+    "  -k name  : time making a mask (-w by -h) from the named preset (noise,\n"
+    "             blobs, island, caverns, or all), then exit (non-zero if the\n"
+    "             same seed gives a different mask)\n"
+    "  -R n     : generate mazes (-w by -h) within masks from each preset (or\n"
+    "             the one -k names, or comb) on n seeds, with each algorithm,\n"
+    "             then exit (non-zero if any splits a region of its mask)\n"
+    "  -F path  : run each phase once on a maze mapped from the file at path\n"
+    "             (use -a stream to keep memory bounded), solving it only if\n"
+    "             -Q is given, then exit (non-zero if the maze is broken)\n"
+  );
+
+  exit( -1 );
+}
+
+
+int parseArgs( int argc, char* argv[], BENCHOPTS* opts, int* compare, int* kernels ) {
+  int i;
+
+  opts->width = 1024;
+  opts->height = 1024;
+  opts->depth = 1;
+  opts->randomness = 50;
+  opts->sparseness = 10;
+  opts->deadends = 50;
+  opts->iterations = 3;
+  opts->seed = 1;
+  opts->tileSize = 64;
+
+  for( i = 1; i < argc; i++ ) {
+    if( strcmp( argv[i], "-H" ) == 0 ) printHelp();
+    if( strcmp( argv[i], "-A" ) == 0 ) {
+      *compare = 1;
+      continue;
+    }
+    if( strcmp( argv[i], "-K" ) == 0 ) {
+      *kernels = 1;
+      continue;
+    }
+
+    if( ( argv[i][0] != '-' ) || ( i+1 >= argc ) ) {
+      fprintf( stderr, "bad argument: %s\n\n", argv[i] );
+      printHelp();
+    }
+
+    switch( argv[i][1] ) {
+      case 'w': opts->width = atoi( argv[++i] ); break;
+      case 'h': opts->height = atoi( argv[++i] ); break;
+      case 'd': opts->depth = atoi( argv[++i] ); break;
+      case 'r': opts->randomness = atoi( argv[++i] ); break;
+      case 's': opts->sparseness = atoi( argv[++i] ); break;
+      case 'e': opts->deadends = atoi( argv[++i] ); break;
+      case 'n': opts->iterations = atoi( argv[++i] ); break;
+      case 'S': opts->seed = atol( argv[++i] ); break;
+      case 'c': opts->compatibility = atoi( argv[++i] ); break;
+      case 'Q': opts->queries = atoi( argv[++i] ); break;
+      case 'V': opts->verify = atoi( argv[++i] ); break;
+      case 'T': opts->threads = atoi( argv[++i] ); break;
+      case 't': opts->tileSize = atoi( argv[++i] ); break;
+      case 'F': opts->storage = argv[++i]; break;
+      case 'M': opts->maskFile = argv[++i]; break;
+      case 'k': opts->maskPreset = argv[++i]; break;
+      case 'B': opts->lanes = atoi( argv[++i] ); break;
+      case 'P': opts->budget = atol( argv[++i] ); break;
+      case 'C': opts->branches = atoi( argv[++i] ); break;
+      case 'R': opts->regions = atoi( argv[++i] ); break;
+      case 'a':
+        opts->algorithm = JBMazeGenerator::findAlgorithm( argv[++i] );
+        if( opts->algorithm < 0 ) {
+          fprintf( stderr, "unknown algorithm: %s\n\n", argv[i] );
+          printHelp();
+        }
+        break;
+      default:
+        fprintf( stderr, "unsupported argument: %s\n\n", argv[i] );
+        printHelp();
+    }
+  }
+
+  if( opts->iterations < 1 ) opts->iterations = 1;
+
+  return 1;
+}
+
+
+int main( int argc, char* argv[] ) {
+  BENCHOPTS opts;
+  int       compare = 0;
+  int       kernels = 0;
+
+  memset( &opts, 0, sizeof( opts ) );
+  parseArgs( argc, argv, &opts, &compare, &kernels );
+
+  printf( "maze: %dx%dx%d, seed %ld, randomness %d, sparseness %d, deadends %d, compatibility %d\n",
+          opts.width, opts.height, opts.depth, opts.seed,
+          opts.randomness, opts.sparseness, opts.deadends, opts.compatibility );
+
+  if( compare ) {
+    benchAlgorithms( &opts );
+    return 0;
+  }
+
+  if( kernels ) {
+    benchKernels( &opts );
+    return 0;
+  }
+
+  if( opts.verify > 0 ) {
+    return ( verifySparsify( &opts ) > 0 );
+  }
+
+  if( opts.lanes > 0 ) {
+    return ( benchBatch( &opts ) > 0 );
+  }
+
+  if( opts.budget > 0 ) {
+    return ( benchStepper( &opts ) > 0 );
+  }
+
+  if( opts.branches > 0 ) {
+    return ( benchSnapshot( &opts ) > 0 );
+  }
+
+  if( opts.regions > 0 ) {
+    return ( benchRegions( &opts ) > 0 );
+  }
+
+  if( opts.maskFile != 0 ) {
+    return benchMask( &opts );
+  }
+
+  if( opts.maskPreset != 0 ) {
+    return ( benchMaskPreset( &opts ) > 0 );
+  }
+
+  if( opts.storage != 0 ) {
+    return ( benchMapped( &opts ) > 0 );
+  }
+
+  if( opts.threads > 0 ) {
+    return ( benchThreads( &opts ) > 0 );
+  }
+
+  if( opts.queries > 0 ) {
+    return ( benchSolvers( &opts ) > 0 );
+  }
+
+  benchLayout( &opts );
+  benchPhases( &opts );
+
+  return 0;
+}